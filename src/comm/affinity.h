@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+
+// 线程的CPU绑定和命名
+// 各个阶段的线程绑定到固定的核上, 避免被调度器来回迁移打乱缓存; 线程名用来在 top -H / perf 中区分阶段.
+namespace affinity{
+
+// 把线程绑定到一个CPU上, cpu < 0 时不绑定; CPU不存在等失败的情况返回false, 线程照常运行
+inline bool pin(std::thread& t, int cpu){
+    if (cpu < 0) {
+        return true;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(t.native_handle(), sizeof(set), &set) == 0;
+}
+
+// 线程名最多15个字符, 超出的部分截掉
+inline void name(std::thread& t, const std::string& n){
+    pthread_setname_np(t.native_handle(), n.substr(0, 15).c_str());
+}
+
+// 一个阶段中第 i 个线程的CPU, 轮流使用 cpus 中的核; cpus 为空时返回 -1, 不绑定
+inline int pick(const std::vector<int>& cpus, size_t i){
+    return cpus.empty() ? -1 : cpus[i % cpus.size()];
+}
+
+} // namespace affinity
@@ -2,61 +2,127 @@
 
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <log.h>
 #include <lfree.h>
+#include <pool.h>
+#include <wheel.h>
 #include <enet/enet.h>
 #include <memory>
+#include <span>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace enet{
 
+// 一个收到或者要发送的消息
+// 数据放在内存池的 Payload 中, ENetData 本身和广播的会话列表也从内存池分配(make_data), 收发都不调用 malloc.
+// 发送时 enet 的包直接引用 Payload, 不拷贝, 也不需要持有 ENetData.
 struct ENetData{
-    ENetData(){};
+    ENetData(){}
+    ENetData(uint32_t sid,const uint8_t* buf,size_t len,uint32_t cid)
+        :session_id(sid),channel_id(cid)
+    {
+        if (len) {
+            attach(pool::Payload::copy(buf, len), 0, len);
+        }
+    }
     ENetData(uint32_t sid,const std::string& pack,uint32_t cid)
-        :session_id(0),data(pack.data(),pack.data() + pack.size()),channel_id(cid)
+        :ENetData(sid,reinterpret_cast<const uint8_t*>(pack.data()),pack.size(),cid)
     {}
     ENetData(const std::string& pack,uint32_t cid)
-        :session_id(0),data(pack.data(),pack.data() + pack.size()),channel_id(cid)
+        :ENetData(0,pack,cid)
     {}
     ENetData(uint32_t sid,const std::vector<uint8_t>& pack,uint32_t cid)
-        :session_id(0),data(pack.data(),pack.data() + pack.size()),channel_id(cid)
+        :ENetData(sid,pack.data(),pack.size(),cid)
     {}
     ENetData(const std::vector<uint8_t>& pack,uint32_t cid)
-        :session_id(0),data(pack.data(),pack.data() + pack.size()),channel_id(cid)
-    {}
-    ENetData(uint32_t sid, std::vector<uint8_t>&& pack,uint32_t cid)
-        :session_id(0),data(std::move(pack)),channel_id(cid)
-    {}
-    ENetData(std::vector<uint8_t>&& pack,uint32_t cid)
-        :session_id(0),data(std::move(pack)),channel_id(cid)
+        :ENetData(0,pack,cid)
     {}
     ENetData(uint32_t sid,ENetPacket* pack,uint32_t cid)
-        :session_id(sid),data(pack->data,pack->data + pack->dataLength),channel_id(cid)
+        :ENetData(sid,pack->data,pack->dataLength,cid)
     {}
-    static std::shared_ptr<ENetData> make_data(uint32_t sid,const std::string& pack,uint32_t cid){
-        return std::make_shared<ENetData>(sid,pack,cid);
+    // 参数和构造函数相同, 对象和控制块一起从内存池分配
+    template<class... Args>
+    static std::shared_ptr<ENetData> make_data(Args&&... args){
+        return std::allocate_shared<ENetData>(pool::Allocator<ENetData>(), std::forward<Args>(args)...);
+    }
+    ENetData(const ENetData&) = delete;
+    ENetData& operator=(const ENetData&) = delete;
+    ~ENetData(){
+        if (payload) {
+            payload->release();
+        }
+        setTargets({});
     }
-    static std::shared_ptr<ENetData> make_data(const std::string& pack,uint32_t cid){
-        return std::make_shared<ENetData>(pack,cid);
+
+    // 接管 Payload 的一个引用, 有效数据是 [data() + offset, data() + offset + len)
+    // 比如 FlatBufferBuilder::ReleaseRaw 释放出来的缓冲区, 发送时直接使用, 不再拷贝
+    void attach(pool::Payload* p, size_t offset, size_t len){
+        if (payload) {
+            payload->release();
+        }
+        payload = p;
+        data_offset = offset;
+        data_size = len;
     }
-    static std::shared_ptr<ENetData> make_data(uint32_t sid,const std::vector<uint8_t>& pack,uint32_t cid){
-        return std::make_shared<ENetData>(sid,pack,cid);
+    const uint8_t* bytes() const {
+        return payload ? payload->data() + data_offset : nullptr;
     }
-    static std::shared_ptr<ENetData> make_data(const std::vector<uint8_t>& pack,uint32_t cid){
-        return std::make_shared<ENetData>(pack,cid);
+    size_t length() const {
+        return data_size;
     }
-    static std::shared_ptr<ENetData> make_data(uint32_t sid, std::vector<uint8_t>&& pack,uint32_t cid){
-        return std::make_shared<ENetData>(sid,std::move(pack),cid);
+    pool::Payload* buffer() const {
+        return payload;
     }
-    static std::shared_ptr<ENetData> make_data(std::vector<uint8_t>&& pack,uint32_t cid){
-        return std::make_shared<ENetData>(std::move(pack),cid);
+
+    // 非空时同一个包发给这些会话, 忽略 session_id
+    // 会话列表复制到内存池的块中, 块的大小按会话数分级, 稳定之后不调用 malloc
+    void setTargets(std::span<const uint32_t> sids){
+        if (sids.size() != target_n) {
+            pool::BufferPool::instance().deallocate(target_ids, target_n * sizeof(uint32_t));
+            target_ids = nullptr;
+            target_n = sids.size();
+            if (target_n) {
+                target_ids = static_cast<uint32_t*>(pool::BufferPool::instance().allocate(target_n * sizeof(uint32_t)));
+            }
+        }
+        std::copy(sids.begin(), sids.end(), target_ids);
+    }
+    std::span<const uint32_t> targets() const {
+        return { target_ids, target_n };
     }
-    uint32_t session_id;
-    uint32_t channel_id;
-    std::vector<uint8_t> data;
+
+    uint32_t session_id = 0;
+    uint32_t channel_id = 0;
+
+private:
+    pool::Payload* payload = nullptr;
+    size_t data_offset = 0;
+    size_t data_size = 0;
+    uint32_t* target_ids = nullptr;
+    size_t target_n = 0;
 };
 
+inline void packetFreeCallback(ENetPacket* packet){
+    static_cast<pool::Payload*>(packet->userData)->release();
+}
+
+// 引用 Payload 发送, 包释放时归还引用
+inline ENetPacket* createPacket(const ENetData& data, enet_uint32 flags){
+    pool::Payload* p = data.buffer();
+    if (p == nullptr) {
+        return enet_packet_create(nullptr, 0, flags);
+    }
+    ENetPacket* packet = enet_packet_create(data.bytes(), data.length(), flags | ENET_PACKET_FLAG_NO_ALLOCATE);
+    p->retain();
+    packet->userData = p;
+    packet->freeCallback = packetFreeCallback;
+    return packet;
+}
+
 
 class Init{
     friend class ENetServer;
@@ -65,8 +131,10 @@ class Init{
     static void getInit(){
         static Init init;
     }
+    // enet 内部的包, 命令和分片也从内存池分配
     Init(){
-        if (0 != enet_initialize()){
+        ENetCallbacks callbacks = { &pool::allocate, &pool::deallocate, &Init::noMemory };
+        if (0 != enet_initialize_with_callbacks(ENET_VERSION, &callbacks)){
             errorlog << "failed to initialize enet";
             exit(1);
         }
@@ -74,6 +142,18 @@ class Init{
     ~Init(){
         enet_deinitialize();
     }
+    static void noMemory(){
+        errorlog << "enet out of memory";
+        abort();
+    }
+};
+
+// 一个会话的链路状态, 取自 enet 的 ENetPeer
+struct LinkStats{
+    uint32_t session_id = 0;
+    uint32_t rtt = 0;          // 平滑后的往返时间, 毫秒
+    uint32_t loss = 0;         // 丢包率, ENET_PEER_PACKET_LOSS_SCALE(65536) 表示 100%
+    uint32_t in_transit = 0;   // 已发出还没确认的可靠数据字节数
 };
 
 class ENetServer{
@@ -100,8 +180,12 @@ public:
                 break;
             }
             case ENET_EVENT_TYPE_RECEIVE:{
-                std::shared_ptr<ENetData> data = std::make_shared<ENetData>(ids[event.peer],event.packet,event.channelID);
-                receives.put(data);
+                touch(ids[event.peer]);
+                // 停止接收之后收到的包直接丢弃
+                if (receiving.load(std::memory_order_acquire)) {
+                    std::shared_ptr<ENetData> data = ENetData::make_data(ids[event.peer],event.packet,event.channelID);
+                    receives.put(data);
+                }
                 enet_packet_destroy(event.packet);
                 break;
             }
@@ -118,12 +202,26 @@ public:
             // 处理发送任务
             onSend();
             onDisConnect();
+            sampleLinks();
+            checkIdle();
+            // 接收队列只有网络线程写入, 在这里关闭, 关闭之后不会再有新的数据
+            if (!receiving.load(std::memory_order_acquire)) {
+                receives.quit();
+            }
         }
+        receives.quit();
+        // 退出之前把已经提交的发送任务发出去
+        onSend();
+        enet_host_flush(server);
     }
 
     void quit(){
         running.store(false,std::memory_order_release);
     }
+    // 不再接收新的包, read 在队列读完之后返回false; 发送不受影响, 用于按顺序关闭
+    void closeReceive(){
+        receiving.store(false,std::memory_order_release);
+    }
 
     bool read(std::shared_ptr<ENetData>* data){
         return receives.get(*data);
@@ -132,6 +230,11 @@ public:
     void send(const std::shared_ptr<ENetData>& data){
         sends.put(data);
     }
+    // 同一份数据发给多个会话, 只创建一个 ENetPacket, 由 enet 按引用计数释放
+    void broadcast(const std::shared_ptr<ENetData>& data, std::span<const uint32_t> sids){
+        data->setTargets(sids);
+        sends.put(data);
+    }
 
     void disconnect(size_t sid){
         disconnectTask.put(sid);
@@ -139,6 +242,21 @@ public:
     void setDisconnCallback(const std::function<void(uint32_t)>& back){
         disconn_callback = back;
     }
+    // 新连接分配了会话之后调用, 在网络线程中执行
+    void setConnCallback(const std::function<void(uint32_t)>& back){
+        conn_callback = back;
+    }
+    // 会话超过 ms 毫秒没有发来任何包时断开, 并调用断开连接的回调; 0 表示不检查, 在 start 之前设置
+    void setIdleTimeout(uint32_t ms){
+        idle_ms = ms;
+    }
+    // 因为空闲被断开的会话数
+    uint64_t idleKicks() const { return idle_kicks.load(std::memory_order_relaxed); }
+    // 每隔 interval_ms 毫秒对每个连接的链路状态采样一次, 在网络线程中执行
+    void setLinkCallback(uint32_t interval_ms, const std::function<void(const LinkStats&)>& back){
+        link_interval = std::chrono::milliseconds(interval_ms);
+        link_callback = back;
+    }
 
     ~ENetServer(){
         if (server){
@@ -166,6 +284,11 @@ private:
         uint32_t session = getSession();
         peers[session] = event->peer;
         ids[event->peer] = session;
+        if (idle_ms) {
+            last_seen[session] = idle_timers.elapsed();
+            idle_timers.after(idle_ms, session);
+        }
+        if (conn_callback) conn_callback(session);
     }
     void onDisConnect(ENetEvent* event){
         auto id = ids.find(event->peer);
@@ -179,6 +302,7 @@ private:
         }
         // 调用关闭连接的回调函数
         if (disconn_callback) disconn_callback(id->second);
+        last_seen.erase(id->second);
         peers.erase(pe);
         ids.erase(id);
     }
@@ -194,6 +318,7 @@ private:
                 continue ;
             }
             enet_peer_disconnect(pe->second, 1); // 断开连接
+            last_seen.erase(static_cast<uint32_t>(sid));
             auto id = ids.find(pe->second);
             if (id == ids.end()) {
                 peers.erase(pe);
@@ -211,36 +336,111 @@ private:
             if (ret == false) {
                 return ;
             }
-            ENetPacket * packet = enet_packet_create(task->data.data(), task->data.size(), ENET_PACKET_FLAG_RELIABLE | ENET_PACKET_FLAG_NO_ALLOCATE);
-            // 如果使用了no allocate 的话,要保证这个task不能释放,需要再packetfreecallback中释放
-            packet->userData = new std::shared_ptr<ENetData>(task);
-            packet->freeCallback = packetFreeCallback;
-            
-            auto it = peers.find(task->session_id);
-            if (it != peers.end()){
-                enet_peer_send(it->second, task->channel_id, packet);
+            // 包引用 task 的 Payload, task 在这之后就可以释放
+            ENetPacket * packet = createPacket(*task, ENET_PACKET_FLAG_RELIABLE);
+
+            if (task->targets().empty()) {
+                sendTo(task->session_id, task->channel_id, packet);
             }else {
-                // 这里也会调用自定义的释放函数去释放,
+                for (uint32_t sid : task->targets()) {
+                    sendTo(sid, task->channel_id, packet);
+                }
+            }
+            // 没有任何会话引用这个包, 这里也会调用 freeCallback 归还 Payload
+            if (packet->referenceCount == 0) {
                 enet_packet_destroy(packet);
             }
         }
     }
 
-static void packetFreeCallback(ENetPacket* packet){
-    auto data = static_cast<std::shared_ptr<ENetData>*>(packet->userData);
-    delete data;
-}
+    // 空闲超时: 每个会话只有一个定时器, 收到包时只更新时间, 定时器到期时再检查,
+    // 期间有过活动就按最后一次活动的时间重新定时, 不需要每个包都取消和重建定时器
+    void touch(uint32_t sid){
+        if (idle_ms == 0) {
+            return;
+        }
+        auto it = last_seen.find(sid);
+        if (it != last_seen.end()) {
+            it->second = idle_timers.elapsed();
+        }
+    }
+    void checkIdle(){
+        if (idle_ms == 0 || idle_timers.poll(idle_expired) == 0) {
+            return;
+        }
+        const uint64_t now = idle_timers.elapsed();
+        for (uint32_t sid : idle_expired) {
+            auto it = last_seen.find(sid);
+            if (it == last_seen.end()) {
+                // 已经断开
+                continue;
+            }
+            if (now - it->second < idle_ms) {
+                idle_timers.after(it->second + idle_ms - now, sid);
+                continue;
+            }
+            infolog << "session " << sid << " idle for " << now - it->second << " ms, disconnecting";
+            last_seen.erase(it);
+            auto pe = peers.find(sid);
+            if (pe != peers.end()) {
+                if (disconn_callback) disconn_callback(sid);
+                enet_peer_disconnect(pe->second, 0);
+                ids.erase(pe->second);
+                peers.erase(pe);
+                idle_kicks.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        idle_expired.clear();
+    }
+
+    void sampleLinks(){
+        if (!link_callback) {
+            return;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if (now - last_sample < link_interval) {
+            return;
+        }
+        last_sample = now;
+        for (const auto& kv : peers) {
+            const ENetPeer* peer = kv.second;
+            LinkStats s;
+            s.session_id = kv.first;
+            s.rtt = peer->roundTripTime;
+            s.loss = peer->packetLoss;
+            s.in_transit = peer->reliableDataInTransit;
+            link_callback(s);
+        }
+    }
+
+    void sendTo(uint32_t sid, uint32_t cid, ENetPacket* packet){
+        auto it = peers.find(sid);
+        if (it != peers.end()){
+            enet_peer_send(it->second, cid, packet);
+        }
+    }
 
 private:
     ENetHost* server = nullptr;
     size_t sessionid = 0 ;
     std::atomic<bool> running { true };
+    std::atomic<bool> receiving { true };
     std::unordered_map<uint32_t, ENetPeer*> peers;
     std::unordered_map<ENetPeer*,uint32_t> ids;
     lfree::ring_queue<std::shared_ptr<ENetData>> receives{lfree::queue_size::K2};
     lfree::ring_queue<std::shared_ptr<ENetData>> sends{lfree::queue_size::K2};
     lfree::ring_queue<size_t> disconnectTask{lfree::queue_size::K003};
     std::function<void(uint32_t)> disconn_callback;
+    std::function<void(uint32_t)> conn_callback;
+    std::function<void(const LinkStats&)> link_callback;
+    std::chrono::milliseconds link_interval{ 0 };
+    std::chrono::steady_clock::time_point last_sample;
+    // 空闲超时, 只在网络线程中访问
+    uint32_t idle_ms = 0;
+    timer::ClockWheel<uint32_t> idle_timers;
+    std::unordered_map<uint32_t, uint64_t> last_seen;
+    std::vector<uint32_t> idle_expired;
+    std::atomic<uint64_t> idle_kicks{ 0 };
 }; // class ENetServer
 enum Status{
     NotStarted,
@@ -317,7 +517,7 @@ private:
                     break;
                 }
                 case ENET_EVENT_TYPE_RECEIVE:{
-                    std::shared_ptr<ENetData> data = std::make_shared<ENetData>(0,event.packet,event.channelID);
+                    std::shared_ptr<ENetData> data = ENetData::make_data(0,event.packet,event.channelID);
                     receives.put(data);
                     enet_packet_destroy(event.packet);
                     break;
@@ -373,9 +573,7 @@ private:
             if (ret == false){
                 return ;
             }
-            ENetPacket* packet = enet_packet_create(task->data.data(), task->data.size(), ENET_PACKET_FLAG_RELIABLE | ENET_PACKET_FLAG_NO_ALLOCATE);
-            packet->userData = new std::shared_ptr<ENetData>(task);
-            packet->freeCallback = packetFreeCallback;
+            ENetPacket* packet = createPacket(*task, ENET_PACKET_FLAG_RELIABLE);
             if (server_peer){
                 enet_peer_send(server_peer, task->channel_id, packet);
             }
@@ -384,11 +582,6 @@ private:
             }
         }
     }
-    static void packetFreeCallback(ENetPacket* packet){
-        auto data = static_cast<std::shared_ptr<ENetData>*>(packet->userData);
-        delete data;
-    }
-    
 private:
     ENetHost* client = nullptr;
     ENetPeer* server_peer = nullptr;
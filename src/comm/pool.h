@@ -0,0 +1,253 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include "lfree.h"
+
+// 网络层的内存池
+// 内存块按2的幂分级, 每个线程每一级有一个小缓存, 缓存空了从全局的无锁空闲链表批量取, 满了批量还回去,
+// 全局链表也满了才交还系统. 收发一个包用到的 ENetData, 负载缓冲区和 enet 内部的包结构都从这里分配,
+// 稳定之后网络线程不再调用 malloc.
+namespace pool{
+
+struct PoolStats{
+    uint64_t upstream = 0;   // 向系统申请内存的次数
+    uint64_t returned = 0;   // 交还系统的次数
+};
+
+class BufferPool{
+public:
+    static const size_t MIN_SHIFT = 5;   // 32B
+    static const size_t MAX_SHIFT = 20;  // 1M, 更大的直接走new/delete
+    static const size_t CLASSES = MAX_SHIFT - MIN_SHIFT + 1;
+    static const size_t CACHE = 64;      // 每个线程每一级最多缓存的块数
+    static const size_t BATCH = CACHE / 2;
+
+    // 不析构: 其他静态对象析构时还可能归还内存, 进程退出时缓存的块交给系统回收
+    static BufferPool& instance(){
+        static BufferPool* pool = new BufferPool();
+        return *pool;
+    }
+
+    void* allocate(size_t size){
+        const size_t cls = sizeClass(size);
+        if (cls == CLASSES) {
+            upstream.fetch_add(1, std::memory_order_relaxed);
+            return ::operator new(size);
+        }
+        Cache& c = local();
+        if (c.alive) {
+            if (c.count[cls] == 0) {
+                refill(c, cls);
+            }
+            if (c.count[cls] > 0) {
+                return c.blocks[cls][--c.count[cls]];
+            }
+        }else {
+            void* p = nullptr;
+            if (free_list[cls]->try_get(p)) {
+                return p;
+            }
+        }
+        upstream.fetch_add(1, std::memory_order_relaxed);
+        return ::operator new(classSize(cls));
+    }
+
+    // size 和申请时相同(同一级即可)
+    void deallocate(void* p, size_t size){
+        if (p == nullptr) {
+            return;
+        }
+        const size_t cls = sizeClass(size);
+        if (cls == CLASSES) {
+            returned.fetch_add(1, std::memory_order_relaxed);
+            ::operator delete(p);
+            return;
+        }
+        Cache& c = local();
+        if (!c.alive) {
+            push(cls, p);
+            return;
+        }
+        if (c.count[cls] == CACHE) {
+            spill(c, cls, BATCH);
+        }
+        c.blocks[cls][c.count[cls]++] = p;
+    }
+
+    PoolStats stats() const {
+        PoolStats s;
+        s.upstream = upstream.load(std::memory_order_relaxed);
+        s.returned = returned.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    static size_t sizeClass(size_t size){
+        size_t cls = 0;
+        while (cls < CLASSES && classSize(cls) < size) {
+            ++cls;
+        }
+        return cls;
+    }
+    static size_t classSize(size_t cls){
+        return size_t(1) << (MIN_SHIFT + cls);
+    }
+
+private:
+    BufferPool(){
+        for (size_t i = 0; i < CLASSES; ++i) {
+            free_list[i] = std::make_unique<lfree::ring_queue<void*>>(lfree::queue_size::K4);
+        }
+    }
+
+    // 线程缓存只有定长数组, 析构是平凡的; 线程退出时由 Flush 把缓存还给全局链表,
+    // 之后这个线程上的申请和归还直接访问全局链表
+    struct Cache{
+        void* blocks[CLASSES][CACHE];
+        uint32_t count[CLASSES];
+        bool alive;
+    };
+    struct Flush{
+        ~Flush(){
+            BufferPool& pool = BufferPool::instance();
+            Cache& c = pool.local();
+            for (size_t cls = 0; cls < CLASSES; ++cls) {
+                pool.spill(c, cls, c.count[cls]);
+            }
+            c.alive = false;
+        }
+    };
+
+    Cache& local(){
+        static thread_local Cache cache{ {}, {}, true };
+        static thread_local Flush flush;
+        (void)flush;
+        return cache;
+    }
+
+    void refill(Cache& c, size_t cls){
+        void* p = nullptr;
+        while (c.count[cls] < BATCH && free_list[cls]->try_get(p)) {
+            c.blocks[cls][c.count[cls]++] = p;
+        }
+    }
+    // 把缓存顶部的 n 块还给全局链表
+    void spill(Cache& c, size_t cls, size_t n){
+        for (size_t i = 0; i < n && c.count[cls] > 0; ++i) {
+            push(cls, c.blocks[cls][--c.count[cls]]);
+        }
+    }
+    void push(size_t cls, void* p){
+        if (!free_list[cls]->try_put(p)) {
+            returned.fetch_add(1, std::memory_order_relaxed);
+            ::operator delete(p);
+        }
+    }
+
+private:
+    std::unique_ptr<lfree::ring_queue<void*>> free_list[CLASSES];
+    std::atomic<uint64_t> upstream{ 0 };
+    std::atomic<uint64_t> returned{ 0 };
+}; // class BufferPool
+
+// 不带尺寸的申请和归还, 尺寸记在块头部, 给 enet 的 malloc/free 回调使用
+static const size_t HEADER = alignof(std::max_align_t);
+
+inline void* allocate(size_t size){
+    uint8_t* p = static_cast<uint8_t*>(BufferPool::instance().allocate(size + HEADER));
+    *reinterpret_cast<size_t*>(p) = size + HEADER;
+    return p + HEADER;
+}
+
+inline void deallocate(void* p){
+    if (p == nullptr) {
+        return;
+    }
+    uint8_t* b = static_cast<uint8_t*>(p) - HEADER;
+    BufferPool::instance().deallocate(b, *reinterpret_cast<size_t*>(b));
+}
+
+// 给 std::allocate_shared 等标准库容器使用
+template<class T>
+struct Allocator{
+    using value_type = T;
+
+    Allocator() = default;
+    template<class U>
+    Allocator(const Allocator<U>&) {}
+
+    T* allocate(size_t n){
+        return static_cast<T*>(BufferPool::instance().allocate(n * sizeof(T)));
+    }
+    void deallocate(T* p, size_t n){
+        BufferPool::instance().deallocate(p, n * sizeof(T));
+    }
+
+    template<class U>
+    bool operator==(const Allocator<U>&) const { return true; }
+    template<class U>
+    bool operator!=(const Allocator<U>&) const { return false; }
+};
+
+// 带侵入式引用计数的负载缓冲区, 头部之后就是数据
+// 最后一个引用释放时回到内存池; 网络线程发送时给 enet 的包加一个引用, 包的 freeCallback 中释放
+class Payload{
+public:
+    // 引用计数为1
+    static Payload* create(size_t capacity){
+        void* p = BufferPool::instance().allocate(sizeof(Payload) + capacity);
+        return new (p) Payload(capacity);
+    }
+    static Payload* copy(const uint8_t* buf, size_t len){
+        Payload* p = create(len);
+        if (len) {
+            std::memcpy(p->data(), buf, len);
+        }
+        return p;
+    }
+    // 块大小按2的幂分级, 头部也占块的空间; 返回和 capacity 落在同一级的最大容量,
+    // 按它申请可以用满整块, 比如 16K 的容量要落在 16K 的块里就只能是 16K 减去头部
+    static size_t fit(size_t capacity){
+        const size_t cls = BufferPool::sizeClass(sizeof(Payload) + capacity);
+        return cls == BufferPool::CLASSES ? capacity : BufferPool::classSize(cls) - sizeof(Payload);
+    }
+    // data() 返回的指针所在的缓冲区
+    static Payload* of(uint8_t* bytes){
+        return reinterpret_cast<Payload*>(bytes - sizeof(Payload));
+    }
+
+    uint8_t* data() { return reinterpret_cast<uint8_t*>(this + 1); }
+    const uint8_t* data() const { return reinterpret_cast<const uint8_t*>(this + 1); }
+    size_t capacity() const { return cap; }
+    uint32_t refs() const { return ref_count.load(std::memory_order_acquire); }
+
+    void retain(){
+        ref_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    void release(){
+        if (ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            const size_t size = sizeof(Payload) + cap;
+            this->~Payload();
+            BufferPool::instance().deallocate(this, size);
+        }
+    }
+
+private:
+    explicit Payload(size_t capacity)
+        :cap(capacity)
+    {}
+    Payload(const Payload&) = delete;
+    Payload& operator=(const Payload&) = delete;
+
+private:
+    alignas(HEADER) std::atomic<uint32_t> ref_count{ 1 };
+    size_t cap;
+}; // class Payload
+
+static_assert(sizeof(Payload) == HEADER, "payload data must start right after the header");
+
+} // namespace pool
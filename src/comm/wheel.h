@@ -0,0 +1,221 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// 层级时间轮
+// 技能冷却, buff, 复活, 空闲连接的超时等大量定时器, 每个tick扫描所有实体或者用堆都不划算.
+// 时间轮有 Levels 层, 每层 2^Bits 个槽, 第 L 层一个槽覆盖 2^(Bits*L) 个时间单位. 定时器按到期时间和当前时间
+// 相同的最高位前缀放到对应的层, 槽号取到期时间在这一层的那几位; 时间走到一个槽覆盖的区间开头时, 把槽里的定时器
+// 重新放到更低的层(级联), 第0层的槽到期时整槽取出. 插入和取消都是 O(1), 推进的开销和到期的定时器数成正比.
+// 超出最高层范围的定时器放在溢出链表中, 时间绕过一整圈时重新插入.
+//
+// 定时器节点放在数组中, 用下标组成双向链表, 释放的节点复用, 稳定之后不再分配内存.
+// TimerId 的高32位是节点的代数, 节点复用之后旧的 TimerId 失效, 取消一个已经到期的定时器是安全的.
+namespace timer{
+
+using TimerId = uint64_t;
+const TimerId InvalidTimer = 0;
+
+template<class T, unsigned Bits = 6, unsigned Levels = 4>
+class Wheel{
+public:
+    explicit Wheel(uint64_t now = 0)
+        :current(now)
+    {
+        heads.fill(Nil);
+    }
+
+    // 在时间 when 到期, when 不晚于当前时间时在下一次推进时到期
+    TimerId schedule(uint64_t when, T value){
+        uint32_t i = allocate();
+        Node& n = nodes[i];
+        n.when = std::max(when, current + 1);
+        n.value = std::move(value);
+        insert(i);
+        ++count;
+        return TimerId(n.gen) << 32 | i;
+    }
+    TimerId after(uint64_t delay, T value){
+        return schedule(current + delay, std::move(value));
+    }
+
+    // 定时器已经到期, 已经取消或者 id 无效时返回false
+    bool cancel(TimerId id){
+        const uint32_t i = static_cast<uint32_t>(id);
+        if (i >= nodes.size() || nodes[i].gen != static_cast<uint32_t>(id >> 32) || nodes[i].list == Free) {
+            return false;
+        }
+        unlink(i);
+        release(i);
+        --count;
+        return true;
+    }
+
+    // 推进到 now, 到期的定时器的值按到期时间的顺序追加到 out, 返回到期的个数
+    template<class Out>
+    size_t advance(uint64_t now, Out& out){
+        size_t fired = 0;
+        while (current < now) {
+            if (count == 0) {
+                // 没有定时器时直接跳过去
+                current = now;
+                break;
+            }
+            const uint64_t t = ++current;
+            if ((t & (Span - 1)) == 0) {
+                cascade(Overflow);
+            }
+            for (unsigned l = Levels - 1; l >= 1; --l) {
+                if ((t & ((uint64_t(1) << (Bits * l)) - 1)) == 0) {
+                    cascade(l * Slots + ((t >> (Bits * l)) & Mask));
+                }
+            }
+            uint32_t& head = heads[t & Mask];
+            while (head != Nil) {
+                const uint32_t i = head;
+                unlink(i);
+                out.push_back(std::move(nodes[i].value));
+                release(i);
+                --count;
+                ++fired;
+            }
+        }
+        return fired;
+    }
+
+    uint64_t now() const { return current; }
+    size_t size() const { return count; }
+
+    // 按节点的顺序访问所有还没到期的定时器, f(when, value), 顺序和到期时间无关
+    template<class F>
+    void forEach(F&& f) const {
+        for (const Node& n : nodes) {
+            if (n.list != Free) {
+                f(n.when, n.value);
+            }
+        }
+    }
+
+private:
+    static constexpr uint32_t Nil = 0xFFFFFFFFu;
+    static constexpr uint32_t Slots = 1u << Bits;
+    static constexpr uint32_t Mask = Slots - 1;
+    static constexpr uint32_t Overflow = Levels * Slots;   // 溢出链表在 heads 中的位置
+    static constexpr uint32_t Free = Overflow + 1;         // 空闲节点的 list
+    static constexpr uint64_t Span = uint64_t(1) << (Bits * Levels);
+
+    struct Node{
+        uint64_t when = 0;
+        uint32_t prev = Nil;
+        uint32_t next = Nil;
+        uint32_t list = Free;   // 所在的链表
+        uint32_t gen = 1;
+        T value{};
+    };
+
+    uint32_t allocate(){
+        if (free_head != Nil) {
+            uint32_t i = free_head;
+            free_head = nodes[i].next;
+            return i;
+        }
+        nodes.emplace_back();
+        return static_cast<uint32_t>(nodes.size() - 1);
+    }
+    void release(uint32_t i){
+        Node& n = nodes[i];
+        n.value = T{};
+        n.list = Free;
+        // 代数跳过0, TimerId 不会等于 InvalidTimer
+        n.gen = n.gen + 1 ? n.gen + 1 : 1;
+        n.next = free_head;
+        free_head = i;
+    }
+
+    // 找到和当前时间相同前缀的最高一层
+    void insert(uint32_t i){
+        Node& n = nodes[i];
+        uint32_t list = Overflow;
+        for (unsigned l = 0; l < Levels; ++l) {
+            const unsigned shift = Bits * (l + 1);
+            if ((n.when >> shift) == (current >> shift)) {
+                list = l * Slots + ((n.when >> (Bits * l)) & Mask);
+                break;
+            }
+        }
+        n.list = list;
+        n.prev = Nil;
+        n.next = heads[list];
+        if (n.next != Nil) {
+            nodes[n.next].prev = i;
+        }
+        heads[list] = i;
+    }
+    void unlink(uint32_t i){
+        Node& n = nodes[i];
+        if (n.prev != Nil) {
+            nodes[n.prev].next = n.next;
+        }else {
+            heads[n.list] = n.next;
+        }
+        if (n.next != Nil) {
+            nodes[n.next].prev = n.prev;
+        }
+    }
+    // 整个链表取下来重新插入, 这时它们和当前时间有了更长的公共前缀, 会落到更低的层
+    void cascade(uint32_t list){
+        uint32_t i = heads[list];
+        heads[list] = Nil;
+        while (i != Nil) {
+            const uint32_t next = nodes[i].next;
+            insert(i);
+            i = next;
+        }
+    }
+
+private:
+    uint64_t current;
+    size_t count = 0;
+    std::vector<Node> nodes;
+    uint32_t free_head = Nil;
+    std::array<uint32_t, Levels * Slots + 1> heads;
+}; // class Wheel
+
+// 毫秒精度的挂钟时间轮, 给网络层的超时使用, 时间从构造时开始计算
+template<class T>
+class ClockWheel{
+public:
+    ClockWheel()
+        :start(std::chrono::steady_clock::now())
+    {}
+
+    TimerId after(uint64_t ms, T value){
+        return wheel.schedule(elapsed() + ms, std::move(value));
+    }
+    bool cancel(TimerId id){
+        return wheel.cancel(id);
+    }
+    // 取出到现在为止到期的定时器
+    template<class Out>
+    size_t poll(Out& out){
+        return wheel.advance(elapsed(), out);
+    }
+    // 构造以来的毫秒数
+    uint64_t elapsed() const {
+        using namespace std::chrono;
+        return static_cast<uint64_t>(duration_cast<milliseconds>(steady_clock::now() - start).count());
+    }
+    size_t size() const { return wheel.size(); }
+
+private:
+    std::chrono::steady_clock::time_point start;
+    Wheel<T> wheel;
+}; // class ClockWheel
+
+} // namespace timer
@@ -1,7 +1,13 @@
 #pragma once 
 
+#include <functional>
+#include <unordered_map>
 #include "log.h"
 #include "enet.h"
+#include "decode.h"
+#include "input.h"
+#include "limiter.h"
+#include "rooms.h"
 
 namespace conn{
 
@@ -11,13 +17,75 @@ public:
         :server(s)
     {}
 
+    // 注册房间的输入队列, 需要在start之前完成
+    void bind(uint32_t room_id, world::InputQueue* queue){
+        rooms[room_id] = queue;
+    }
+    // 按会话路由到房间管理器中的房间, 设置之后 bind 注册的房间表不再使用
+    // 会话只能给自己所在的房间发指令, room_id 不一致的指令丢弃
+    void bind(world::RoomManager* manager){
+        room_manager = manager;
+    }
+    // 在解码之前按会话限流, 多个 Connect 可以共用一个限流器
+    void setLimiter(RateLimiter* l){
+        limiter = l;
+    }
+    // 客户端回传的快照确认, 交给对应会话的增量编码器
+    void setAckCallback(const std::function<void(uint32_t, uint32_t)>& back){
+        ack_callback = back;
+    }
+
+    // 解码线程, 接收队列关闭并且读完之后返回
+    // 多个解码线程时每个线程一个 Connect; 快照的编码和广播在 server::Broadcaster 中
     void start(){
         // 从server中读取出数据包,反序列化之后,封装,交给world
-        // 接收world的数据,封装成广播任务,进行广播
+        std::shared_ptr<enet::ENetData> data;
+        while (server.read(&data)) {
+            // 先按一条指令检查, 刷包的会话不用校验就丢弃
+            const uint32_t now = nowMs();
+            if (limiter && !limiter->allow(data->session_id, now)) {
+                ++limited;
+                continue;
+            }
+            const io::Frame* frame = decoder.verify(data->bytes(), data->length());
+            if (frame == nullptr) {
+                continue;
+            }
+            // 再扣掉其余的指令, 一个包里塞满指令和发很多包的代价相同
+            const uint32_t n = Decoder::commandCount(frame);
+            if (limiter && n > 1 && !limiter->allow(data->session_id, now, n - 1)) {
+                ++limited;
+                continue;
+            }
+            Decoded info;
+            // 持有房间直到解码完成, 房间可能同时被删除
+            std::shared_ptr<world::Room> owner = room_manager ? room_manager->route(data->session_id) : nullptr;
+            // 会话的玩家就是它的 session_id, 指令里的 player_id 只能是 0 或者它自己
+            decoder.decode(frame, data->session_id, [&](uint32_t room) -> world::InputQueue* {
+                if (room_manager) {
+                    return owner && owner->id() == room ? &owner->input() : nullptr;
+                }
+                auto it = rooms.find(room);
+                return it == rooms.end() ? nullptr : it->second;
+            }, &info);
+            if (info.ack && ack_callback) {
+                ack_callback(data->session_id, info.ack);
+            }
+        }
     }
 
+    const Decoder& stats() const { return decoder; }
+    // 限流丢弃的包数, 按指令扣令牌
+    uint64_t limitedPackets() const { return limited; }
+
 private:
     enet::ENetServer& server;
+    Decoder decoder;
+    std::unordered_map<uint32_t, world::InputQueue*> rooms;
+    world::RoomManager* room_manager = nullptr;
+    RateLimiter* limiter = nullptr;
+    uint64_t limited = 0;
+    std::function<void(uint32_t, uint32_t)> ack_callback;
 };
 
-}// unpack
\ No newline at end of file
+}// unpack
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <flatbuffers/flatbuffers.h>
+#include "io_fb.h"
+#include "pack.h"
+#include "input.h"
+
+namespace conn{
+
+// 一个包解码出来的概要
+struct Decoded{
+    uint32_t tick = 0;
+    uint32_t ack = 0;
+    uint32_t commands = 0;
+};
+
+// 入站数据包的解码
+// 先做廉价的长度检查, 再用收紧了深度和表数量限制的 Verifier 校验, 不合法的包直接丢弃;
+// 合法包中的指令按 room_id 分散写入各个房间的 InputQueue.
+// 指令的玩家由会话决定: player_id 为 0 或者等于会话绑定的玩家时按绑定的玩家写入, 否则拒绝,
+// 一个会话不能操控同一个房间里的其他玩家, 也不能用编造的 player_id 绕过按玩家的合并.
+class Decoder{
+public:
+    // Frame -> commands -> Command, 三层
+    static const uint32_t MAX_DEPTH = 3;
+    static const uint32_t MAX_COMMANDS = 256;
+    // Frame 本身加上每条指令一张表
+    static const uint32_t MAX_TABLES = MAX_COMMANDS + 1;
+    static const size_t MIN_SIZE = 8;
+    static const size_t MAX_SIZE = 16 * 1024;
+
+    // 校验一个包, 通过返回Frame, 否则返回nullptr并计数
+    const io::Frame* verify(const uint8_t* buf, size_t len){
+        if (len < MIN_SIZE || len > MAX_SIZE) {
+            ++dropped;
+            return nullptr;
+        }
+        flatbuffers::Verifier verifier(buf, len, MAX_DEPTH, MAX_TABLES);
+        if (!verifier.VerifyBuffer<io::Frame>(nullptr)) {
+            ++dropped;
+            return nullptr;
+        }
+        const io::Frame* frame = flatbuffers::GetRoot<io::Frame>(buf);
+        // 客户端只允许上行指令
+        if (frame->type() != io::DataType_Commands || frame->entities() != nullptr) {
+            ++dropped;
+            return nullptr;
+        }
+        return frame;
+    }
+
+    // 解码一个包, player 是发送方会话绑定的玩家,
+    // route(room_id) 返回房间的输入队列, 没有对应房间时返回nullptr, 这条指令被丢弃
+    // 同一个包的指令通常属于同一个房间, 相邻的同房间指令合并成一次加锁写入
+    template<class Route>
+    bool decode(const uint8_t* buf, size_t len, uint32_t player, Route&& route, Decoded* out = nullptr){
+        const io::Frame* frame = verify(buf, len);
+        if (frame == nullptr) {
+            return false;
+        }
+        decode(frame, player, route, out);
+        return true;
+    }
+
+    // 指令数, frame 已经通过 verify
+    static uint32_t commandCount(const io::Frame* frame){
+        return frame->commands() ? frame->commands()->size() : 0;
+    }
+
+    // 解码一个已经通过 verify 的包
+    template<class Route>
+    void decode(const io::Frame* frame, uint32_t player, Route&& route, Decoded* out = nullptr){
+        Decoded info;
+        info.tick = frame->tick();
+        info.ack = frame->ack();
+        auto cmds = frame->commands();
+        uint32_t n = cmds ? cmds->size() : 0;
+        uint32_t i = 0;
+        while (i < n) {
+            uint32_t room = cmds->Get(i)->room_id();
+            uint32_t j = i + 1;
+            while (j < n && cmds->Get(j)->room_id() == room) {
+                ++j;
+            }
+            world::InputQueue* queue = route(room);
+            if (queue) {
+                queue->produce([&](world::InputBuffer& in){
+                    for (uint32_t k = i; k < j; ++k) {
+                        const io::Command* c = cmds->Get(k);
+                        if (c->player_id() != 0 && c->player_id() != player) {
+                            ++rejected;
+                            continue;
+                        }
+                        merged += in.push(player, c->move_x(), c->move_y(),
+                            flat::packButtons(c->attack(), c->skill1(), c->skill2()), info.tick, info.ack);
+                        ++info.commands;
+                    }
+                });
+            }else {
+                unrouted += j - i;
+            }
+            i = j;
+        }
+        decoded += info.commands;
+        if (out) {
+            *out = info;
+        }
+    }
+
+    uint64_t droppedPackets() const { return dropped; }
+    uint64_t decodedCommands() const { return decoded; }
+    uint64_t unroutedCommands() const { return unrouted; }
+    // player_id 不属于发送方会话的指令
+    uint64_t rejectedCommands() const { return rejected; }
+    // 和同一个玩家在同一个tick内已有的指令合并掉的条数
+    uint64_t mergedCommands() const { return merged; }
+
+private:
+    uint64_t dropped = 0;
+    uint64_t decoded = 0;
+    uint64_t unrouted = 0;
+    uint64_t rejected = 0;
+    uint64_t merged = 0;
+};
+
+} // namespace conn
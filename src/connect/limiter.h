@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// 按会话的令牌桶限流
+// 令牌按指令计算: 一个包最多带 256 条指令, 只按包计数时不超过包速率也能刷进大量指令.
+// 在完整解码之前先按一条指令检查, 超出速率的包直接丢弃, 不做校验也不进入房间; 校验通过之后再扣掉其余的指令.
+// 多个解码线程共用一个限流器: 每个桶是一个64位原子变量, 高32位是上次补充的时间(毫秒), 低32位是令牌数(1/1024个),
+// 检查和扣减在一次CAS中完成, 不加锁.
+// 桶按 session_id 取模寻址, 同时在线的会话超过桶数时会有会话共用一个桶, 桶数应该大于连接上限.
+namespace conn{
+
+struct LimiterConfig{
+    uint32_t rate = 60;        // 每个会话每秒允许的指令数, 0 表示不限流
+    uint32_t burst = 30;       // 桶的容量, 允许的突发指令数, 指令数超过它的包总是被丢弃
+    size_t buckets = 4096;     // 取2的幂
+};
+
+// 限流使用的毫秒时间, 32位回绕
+inline uint32_t nowMs(){
+    using namespace std::chrono;
+    return static_cast<uint32_t>(duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+class RateLimiter{
+public:
+    explicit RateLimiter(const LimiterConfig& cfg = LimiterConfig())
+        :cfg(cfg)
+    {
+        size_t n = 1;
+        while (n < cfg.buckets) {
+            n <<= 1;
+        }
+        mask = n - 1;
+        table = std::make_unique<std::atomic<uint64_t>[]>(n);
+        for (size_t i = 0; i < n; ++i) {
+            table[i].store(pack(0, cfg.burst * ONE), std::memory_order_relaxed);
+        }
+    }
+
+    // 会话在 now_ms 时刻的 cost 条指令是否放行, 放行时扣掉 cost 个令牌, 不放行时不扣
+    bool allow(uint32_t session_id, uint32_t now_ms, uint32_t cost = 1){
+        if (cfg.rate == 0) {
+            return true;
+        }
+        std::atomic<uint64_t>& slot = table[session_id & mask];
+        uint64_t s = slot.load(std::memory_order_relaxed);
+        while (true) {
+            // 时间按32位回绕, 相减得到经过的毫秒数
+            const uint32_t elapsed = now_ms - timeOf(s);
+            const uint64_t cap = uint64_t(cfg.burst) * ONE;
+            const uint64_t tokens = std::min<uint64_t>(cap, tokensOf(s) + uint64_t(elapsed) * cfg.rate * ONE / 1000);
+            const uint64_t need = uint64_t(cost) * ONE;
+            const bool ok = tokens >= need;
+            const uint64_t next = pack(now_ms, static_cast<uint32_t>(ok ? tokens - need : tokens));
+            if (slot.compare_exchange_weak(s, next, std::memory_order_relaxed)) {
+                return ok;
+            }
+        }
+    }
+
+    // 新连接的会话从满桶开始, 不继承之前使用这个桶的会话的状态
+    void reset(uint32_t session_id, uint32_t now_ms){
+        table[session_id & mask].store(pack(now_ms, cfg.burst * ONE), std::memory_order_relaxed);
+    }
+
+    const LimiterConfig& config() const { return cfg; }
+
+private:
+    static const uint32_t ONE = 1024;
+    static uint64_t pack(uint32_t ms, uint32_t tokens) { return uint64_t(ms) << 32 | tokens; }
+    static uint32_t timeOf(uint64_t s) { return static_cast<uint32_t>(s >> 32); }
+    static uint32_t tokensOf(uint64_t s) { return static_cast<uint32_t>(s); }
+
+private:
+    LimiterConfig cfg;
+    size_t mask = 0;
+    std::unique_ptr<std::atomic<uint64_t>[]> table;
+}; // class RateLimiter
+
+} // namespace conn
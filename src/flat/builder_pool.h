@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <flatbuffers/flatbuffers.h>
+#include "enet.h"
+#include "pool.h"
+
+// FlatBufferBuilder 的复用
+// 每个线程一个builder, 每次使用前Clear; 底层缓冲区是内存池中的 Payload,
+// 编码完成后用 ReleaseRaw 把缓冲区直接交给 ENetData 发送, 发送完成后缓冲区回到内存池.
+// 稳定之后编码一帧不会再向系统申请内存.
+namespace flat{
+
+// builder 的缓冲区从 Payload 分配, ReleaseRaw 之后可以直接作为 ENetData 的负载
+class BufferPool : public flatbuffers::Allocator{
+public:
+    static BufferPool& instance(){
+        static BufferPool pool;
+        return pool;
+    }
+
+    uint8_t* allocate(size_t size) override {
+        return pool::Payload::create(size)->data();
+    }
+
+    void deallocate(uint8_t* p, size_t) override {
+        pool::Payload::of(p)->release();
+    }
+};
+
+// 当前线程的builder, 返回前已经Clear
+// initial_size 只在线程第一次使用时生效, 应该不小于常见帧的大小, 避免编码时扩容;
+// 缓冲区带着 Payload 的头部, 按所在的那一级用满(Payload::fit), 默认正好是一个 16K 的块
+inline flatbuffers::FlatBufferBuilder& localBuilder(size_t initial_size = 16 * 1024 - sizeof(pool::Payload)){
+    static thread_local flatbuffers::FlatBufferBuilder fbb(pool::Payload::fit(initial_size), &BufferPool::instance(), false);
+    fbb.Clear();
+    return fbb;
+}
+
+// 把完成的缓冲区交给 ENetData, 不拷贝
+// 之后builder不再持有缓冲区, 下一次使用时从池里重新取一块
+inline std::shared_ptr<enet::ENetData> release(flatbuffers::FlatBufferBuilder& fbb, uint32_t sid, uint32_t cid){
+    size_t size = 0, offset = 0;
+    uint8_t* buf = fbb.ReleaseRaw(size, offset);
+    auto data = enet::ENetData::make_data();
+    data->session_id = sid;
+    data->channel_id = cid;
+    data->attach(pool::Payload::of(buf), offset, size - offset);
+    return data;
+}
+
+} // namespace flat
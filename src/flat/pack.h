@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <flatbuffers/flatbuffers.h>
+#include "io_fb.h"
+#include "pack_fb.h"
+
+// pack.fbs 的编解码辅助: 量化, 位压缩, 以及从组件数组直接写结构体数组
+namespace flat{
+
+// PackedEntity::status_flags 的位定义, 只用低16位
+enum Status : uint16_t {
+    Alive      = 1u << 0,
+    Moving     = 1u << 1,
+    Attacking  = 1u << 2,
+    Casting1   = 1u << 3,
+    Casting2   = 1u << 4,
+    Stunned    = 1u << 5,
+    Invincible = 1u << 6,
+    Player     = 1u << 7,   // 玩家控制的实体, 生成时设置
+};
+
+// PackedCommand::buttons 的位定义
+enum Button : uint8_t {
+    Attack = 1u << 0,
+    Skill1 = 1u << 1,
+    Skill2 = 1u << 2,
+};
+
+inline uint8_t packButtons(bool attack, bool skill1, bool skill2){
+    return (attack ? Attack : 0) | (skill1 ? Skill1 : 0) | (skill2 ? Skill2 : 0);
+}
+
+inline int16_t clamp16(float v){
+    v = std::nearbyint(v);
+    return static_cast<int16_t>(std::clamp(v, -32768.0f, 32767.0f));
+}
+
+inline int16_t clamp16(int32_t v){
+    return static_cast<int16_t>(std::clamp<int32_t>(v, INT16_MIN, INT16_MAX));
+}
+
+// 相对房间原点的16位定点数
+// 默认 1/16 单位的位置精度, 可以覆盖原点附近 ±2048 个单位; 速度 1/256 精度, ±128 单位每秒
+struct Quantizer{
+    float origin_x = 0.0f;
+    float origin_y = 0.0f;
+    float pos_scale = 16.0f;
+    float vel_scale = 256.0f;
+
+    int16_t posX(float x) const { return clamp16((x - origin_x) * pos_scale); }
+    int16_t posY(float y) const { return clamp16((y - origin_y) * pos_scale); }
+    int16_t vel(float v) const { return clamp16(v * vel_scale); }
+
+    float unposX(int16_t q) const { return origin_x + q / pos_scale; }
+    float unposY(int16_t q) const { return origin_y + q / pos_scale; }
+    float unvel(int16_t q) const { return q / vel_scale; }
+
+    io::Quant toWire() const {
+        return io::Quant(origin_x, origin_y, pos_scale, vel_scale);
+    }
+    static Quantizer fromWire(const io::Quant* q){
+        Quantizer ret;
+        if (q) {
+            ret.origin_x = q->origin_x();
+            ret.origin_y = q->origin_y();
+            ret.pos_scale = q->pos_scale();
+            ret.vel_scale = q->vel_scale();
+        }
+        return ret;
+    }
+};
+
+// World 组件数组的只读视图, 每一列都是 count 个连续的元素, 下标一一对应
+struct EntityColumns{
+    size_t count = 0;
+    const uint32_t* id = nullptr;
+    const int32_t* hp = nullptr;
+    const uint32_t* flags = nullptr;
+    const float* x = nullptr;
+    const float* y = nullptr;
+    const float* vx = nullptr;
+    const float* vy = nullptr;
+};
+
+inline io::PackedEntity packEntity(const Quantizer& q, const EntityColumns& cols, size_t i){
+    return io::PackedEntity(cols.id[i], clamp16(cols.hp[i]), static_cast<uint16_t>(cols.flags[i]),
+        q.posX(cols.x[i]), q.posY(cols.y[i]), q.vel(cols.vx[i]), q.vel(cols.vy[i]));
+}
+
+// 先在builder中预留出未初始化的结构体数组, 再逐个写入, 不经过中间的vector
+inline flatbuffers::Offset<flatbuffers::Vector<const io::PackedEntity*>>
+createEntities(flatbuffers::FlatBufferBuilder& fbb, const Quantizer& q, const EntityColumns& cols){
+    io::PackedEntity* out = nullptr;
+    auto vec = fbb.CreateUninitializedVectorOfStructs<io::PackedEntity>(cols.count, &out);
+    for (size_t i = 0; i < cols.count; ++i) {
+        out[i] = packEntity(q, cols, i);
+    }
+    return vec;
+}
+
+inline flatbuffers::Offset<flatbuffers::Vector<const io::PackedCommand*>>
+createCommands(flatbuffers::FlatBufferBuilder& fbb, const io::PackedCommand* cmds, size_t n){
+    return fbb.CreateVectorOfStructs(cmds, n);
+}
+
+// 构建一帧实体状态
+inline flatbuffers::Offset<io::PackedFrame>
+createEntityFrame(flatbuffers::FlatBufferBuilder& fbb, uint32_t tick, const Quantizer& q, const EntityColumns& cols){
+    auto entities = createEntities(fbb, q, cols);
+    io::Quant wire = q.toWire();
+    return io::CreatePackedFrame(fbb, tick, io::DataType_Entitys, &wire, entities);
+}
+
+// 构建一帧指令
+inline flatbuffers::Offset<io::PackedFrame>
+createCommandFrame(flatbuffers::FlatBufferBuilder& fbb, uint32_t tick, const io::PackedCommand* cmds, size_t n){
+    auto commands = createCommands(fbb, cmds, n);
+    return io::CreatePackedFrame(fbb, tick, io::DataType_Commands, nullptr, 0, commands);
+}
+
+} // namespace flat
@@ -0,0 +1,367 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "builder_pool.h"
+#include "delta.h"
+#include "enet.h"
+#include "lfree.h"
+#include "pack.h"
+#include "priority.h"
+#include "rate.h"
+#include "scheduler.h"
+
+// 快照编码和分发
+// world 线程在每个tick结束时把房间的快照复制成一个 SnapshotJob 交给广播线程, 广播线程给房间内的每个会话
+// 做增量编码, 交给网络线程发送. 一个房间的任务总是交给同一个广播线程, 每个会话的编码器只在这个线程中访问.
+// 每个会话只编码它视野(AOI)内的实体: world 线程按会话的玩家实体查询可见集合随快照一起交过来(见 world/aoi.h),
+// 挑选时从房间的快照中取出这些实体; 进出视野的实体在增量编码中成为 spawns/despawns.
+// 编码之前按会话的优先级累加器在字节预算内挑选实体, 见 priority.h; 预算和发送频率按会话的链路状态调节, 见 rate.h.
+//
+// 一个快照内各个会话的挑选和编码互不依赖, 有编码线程池时切块并行, 每个线程用自己的 builder, 编好的包直接交给网络线程.
+// 收到整个房间, 选中了全部实体并且基线也是完整帧的会话, 编出来的帧只取决于基线的tick, 这样的会话按基线分组, 每组只编码一次,
+// 同一个包发给组内所有会话(ENetServer::broadcast). 链路良好, 确认进度相同的会话通常都在一个组里.
+namespace server{
+
+// 一个房间一个tick的快照
+struct SnapshotJob{
+    // 一个会话的视野: 可见的 entity_id 是 visible[begin, end), 升序
+    // scoped 为 false 时(没有做 AOI, 或者会话还没有玩家实体)收到整个房间
+    struct Scope{
+        uint32_t begin = 0;
+        uint32_t end = 0;
+        uint32_t viewer = 0;   // 会话的玩家实体, 优先级按离它的距离计算
+        bool scoped = false;
+    };
+
+    uint32_t room_id = 0;
+    uint32_t tick = 0;
+    flat::Quantizer quant;
+    std::vector<io::PackedEntity> entities; // 按 entity_id 升序
+    std::vector<uint32_t> sessions;         // 接收这个快照的会话
+    std::vector<Scope> scopes;              // 为空或者和 sessions 一一对应
+    std::vector<uint32_t> visible;
+};
+
+struct BroadcastStats{
+    uint64_t frames = 0;       // 编码的房间快照数
+    uint64_t packets = 0;      // 发出的包数
+    uint64_t bytes = 0;
+    uint64_t full = 0;         // 其中的全量帧
+    uint64_t deferred = 0;     // 超出预算推迟到之后发送的实体更新
+    uint64_t skipped = 0;      // 按链路状态降低频率而没有发送的帧
+    uint64_t backoffs = 0;     // 链路拥塞导致的降速次数
+    uint64_t shared = 0;       // 直接使用同组其他会话编好的帧的包数
+};
+
+class Broadcaster{
+public:
+    Broadcaster(enet::ENetServer& net, uint32_t channel_id, size_t queue_size,
+        const snap::PriorityConfig& priority = snap::PriorityConfig(), const RateConfig& rate = RateConfig(),
+        world::ThreadPool* pool = nullptr)
+        :net(net)
+        ,channel_id(channel_id)
+        ,priority(priority)
+        ,rate(rate)
+        ,pool(pool)
+        ,jobs(queue_size)
+        ,spare(queue_size)
+        ,controls(queue_size)
+    {}
+    ~Broadcaster(){
+        // ring_queue 析构时会等待队列为空, 先把剩下的取出来
+        std::shared_ptr<SnapshotJob> job;
+        while (jobs.try_get(job) || spare.try_get(job)) {}
+        Control c;
+        while (controls.try_get(c)) {}
+    }
+    Broadcaster(const Broadcaster&) = delete;
+    Broadcaster& operator=(const Broadcaster&) = delete;
+
+    // 取一个空的任务, 编码完成的任务回收复用, 数组的容量保留下来
+    // 多个 world 线程可以同时调用
+    std::shared_ptr<SnapshotJob> acquire(){
+        std::shared_ptr<SnapshotJob> job;
+        if (!spare.try_get(job)) {
+            job = std::make_shared<SnapshotJob>();
+        }
+        return job;
+    }
+    // 交给广播线程, 队列满时等待
+    void publish(std::shared_ptr<SnapshotJob> job){
+        jobs.put(std::move(job));
+    }
+
+    // 会话确认收到了 tick, 解码线程调用; 确认只会越来越新, 队列满时丢掉也没关系
+    void ack(uint32_t session_id, uint32_t tick){
+        controls.try_put(Control{ Control::Ack, session_id, tick });
+    }
+    // 会话控制的实体, 优先级按离它的距离计算
+    void watch(uint32_t session_id, uint32_t entity_id){
+        controls.put(Control{ Control::Watch, session_id, entity_id });
+    }
+    // 会话断开, 删除它的编码器
+    void forget(uint32_t session_id){
+        controls.put(Control{ Control::Forget, session_id, 0 });
+    }
+    // 会话的链路采样, 网络线程调用; 下一次采样会覆盖它, 队列满时丢掉也没关系
+    void link(const enet::LinkStats& s){
+        Control c{ Control::Link, s.session_id, 0 };
+        c.link = s;
+        controls.try_put(c);
+    }
+
+    // 广播线程, 阻塞直到 close 之后队列中的任务全部完成
+    void run(){
+        std::shared_ptr<SnapshotJob> job;
+        while (jobs.get(job)) {
+            applyControls();
+            encode(*job);
+            recycle(std::move(job));
+        }
+        applyControls();
+    }
+    void close(){
+        jobs.quit();
+    }
+    // 队列中还有没开始编码的快照, 广播线程跟不上时一直为真
+    bool busy(){
+        return jobs.readable();
+    }
+
+    // 任务不需要编码时直接交还
+    void recycle(std::shared_ptr<SnapshotJob> job){
+        job->entities.clear();
+        job->sessions.clear();
+        job->scopes.clear();
+        job->visible.clear();
+        spare.try_put(job);
+    }
+
+    // 只能在广播线程退出之后读取, deferred 和 backoffs 包括还在线的会话
+    BroadcastStats stats() const {
+        BroadcastStats s = broadcast_stats;
+        for (const auto& kv : clients) {
+            s.deferred += kv.second.filter.deferredCount();
+            s.backoffs += kv.second.rate.backoffCount();
+        }
+        return s;
+    }
+
+private:
+    struct Control{
+        enum Kind : uint8_t { Ack, Watch, Forget, Link };
+        Kind kind = Ack;
+        uint32_t session_id = 0;
+        uint32_t value = 0;    // Ack: tick, Watch: entity_id
+        enet::LinkStats link;
+    };
+    struct Client{
+        Client(const snap::PriorityConfig& priority, const RateConfig& rate)
+            :filter(priority)
+            ,rate(rate, priority.budget)
+        {}
+        // tick 发出的帧是否选中了全部实体
+        bool completeAt(uint32_t tick) const { return complete[tick % History] == tick; }
+        void markComplete(uint32_t tick, bool whole){ complete[tick % History] = whole ? tick : 0; }
+
+        static const size_t History = 32;
+        snap::DeltaEncoder<History> encoder;
+        snap::PriorityFilter filter;
+        RateController rate;
+        std::array<uint32_t, History> complete{};
+    };
+    // 一个会话本帧的挑选和编码
+    struct Task{
+        uint32_t session_id = 0;
+        Client* client = nullptr;
+        const SnapshotJob::Scope* scope = nullptr; // 为空时是整个房间
+        std::vector<io::PackedEntity> seen;         // 视野内的实体, 每帧复用
+        const std::vector<io::PackedEntity>* view = nullptr;
+        uint32_t key = NoShare;          // 可以共享的帧按基线tick分组, 0 表示没有基线的全量帧
+        size_t leader = 0;               // 同组第一个任务的下标, 只有它编码
+        std::vector<uint32_t> group;     // leader 上: 接收这一帧的所有会话
+        size_t bytes = 0;
+        bool full = false;
+    };
+    static const uint32_t NoShare = 0xFFFFFFFFu;
+    static const size_t Grain = 4;
+
+    Client& client(uint32_t session_id){
+        return clients.try_emplace(session_id, priority, rate).first->second;
+    }
+    void retire(const Client& c){
+        broadcast_stats.deferred += c.filter.deferredCount();
+        broadcast_stats.backoffs += c.rate.backoffCount();
+    }
+
+    void applyControls(){
+        Control c;
+        while (controls.try_get(c)) {
+            if (c.kind == Control::Forget) {
+                auto it = clients.find(c.session_id);
+                if (it != clients.end()) {
+                    retire(it->second);
+                    clients.erase(it);
+                }
+            }else if (c.kind == Control::Watch) {
+                client(c.session_id).filter.watch(c.value);
+            }else if (c.kind == Control::Link) {
+                // 还没有收到过快照的会话不用建立状态
+                auto it = clients.find(c.session_id);
+                if (it != clients.end()) {
+                    it->second.rate.sample(c.link);
+                }
+            }else {
+                auto it = clients.find(c.session_id);
+                if (it != clients.end()) {
+                    it->second.encoder.ack(c.value);
+                }
+            }
+        }
+    }
+
+    // 按会话的可见集合从房间的快照中取出实体, 两者都按 entity_id 升序
+    static void narrow(const SnapshotJob& job, const SnapshotJob::Scope& scope, std::vector<io::PackedEntity>& out){
+        out.clear();
+        auto it = job.entities.begin();
+        for (uint32_t k = scope.begin; k < scope.end && it != job.entities.end(); ++k) {
+            const uint32_t id = job.visible[k];
+            it = std::lower_bound(it, job.entities.end(), id, [](const io::PackedEntity& e, uint32_t v){
+                return e.entity_id() < v;
+            });
+            if (it != job.entities.end() && it->entity_id() == id) {
+                out.push_back(*it);
+            }
+        }
+    }
+
+    // 没有线程池时在广播线程上串行执行
+    template<class F>
+    void parallel(size_t n, F&& fn){
+        auto chunk = [&](size_t begin, size_t end){
+            for (size_t i = begin; i < end; ++i) {
+                fn(i);
+            }
+        };
+        if (pool) {
+            pool->parallelFor(n, Grain, chunk);
+        }else {
+            chunk(0, n);
+        }
+    }
+
+    void encode(const SnapshotJob& job){
+        ++broadcast_stats.frames;
+        // 1. 会话的状态只在这里建立, 之后的并行阶段只访问各自的 Client
+        size_t n = 0;
+        for (size_t k = 0; k < job.sessions.size(); ++k) {
+            Client& c = client(job.sessions[k]);
+            if (!c.rate.due(job.tick)) {
+                ++broadcast_stats.skipped;
+                continue;
+            }
+            c.filter.setBudget(c.rate.budget());
+            if (tasks.size() == n) {
+                tasks.emplace_back();
+            }
+            Task& t = tasks[n++];
+            t.session_id = job.sessions[k];
+            t.client = &c;
+            t.scope = k < job.scopes.size() && job.scopes[k].scoped ? &job.scopes[k] : nullptr;
+            if (t.scope) {
+                c.filter.watch(t.scope->viewer);
+            }
+            t.group.clear();
+        }
+
+        // 2. 取出视野内的实体并挑选, 判断能不能和其他会话共享
+        parallel(n, [&](size_t i){
+            Task& t = tasks[i];
+            Client& c = *t.client;
+            const io::PackedEntity* cur = job.entities.data();
+            size_t m = job.entities.size();
+            if (t.scope) {
+                narrow(job, *t.scope, t.seen);
+                cur = t.seen.data();
+                m = t.seen.size();
+            }
+            const snap::Snapshot* base = c.encoder.baseline();
+            t.view = &c.filter.select(base, c.encoder.last(), job.quant, cur, m);
+            // 只看到一部分房间的帧还取决于视野, 不和其他会话共享
+            const bool whole = c.filter.complete() && t.scope == nullptr;
+            t.key = whole && (base == nullptr || c.completeAt(base->tick)) ? (base ? base->tick : 0) : NoShare;
+            c.markComplete(job.tick, whole);
+        });
+
+        // 3. 按基线分组
+        leaders.clear();
+        for (size_t i = 0; i < n; ++i) {
+            Task& t = tasks[i];
+            t.leader = i;
+            if (t.key == NoShare) {
+                continue;
+            }
+            auto it = leaders.try_emplace(t.key, i).first;
+            t.leader = it->second;
+            tasks[t.leader].group.push_back(t.session_id);
+        }
+
+        // 4. 编码并交给网络线程; 组内其他会话只记录本帧
+        parallel(n, [&](size_t i){
+            Task& t = tasks[i];
+            Client& c = *t.client;
+            if (t.leader != i) {
+                c.encoder.commit(job.tick, t.view->data(), t.view->size());
+                return;
+            }
+            const uint64_t full = c.encoder.fullFrames();
+            flatbuffers::FlatBufferBuilder& fbb = flat::localBuilder();
+            fbb.Finish(c.encoder.encode(fbb, job.tick, job.quant, t.view->data(), t.view->size()));
+            std::shared_ptr<enet::ENetData> data = flat::release(fbb, t.session_id, channel_id);
+            t.bytes = data->length();
+            t.full = c.encoder.fullFrames() != full;
+            if (t.group.size() > 1) {
+                net.broadcast(data, t.group);
+            }else {
+                net.send(data);
+            }
+        });
+
+        for (size_t i = 0; i < n; ++i) {
+            const Task& t = tasks[i];
+            if (t.leader != i) {
+                continue;
+            }
+            const size_t receivers = std::max<size_t>(1, t.group.size());
+            broadcast_stats.packets += receivers;
+            broadcast_stats.bytes += t.bytes * receivers;
+            broadcast_stats.full += t.full ? receivers : 0;
+            broadcast_stats.shared += receivers - 1;
+        }
+    }
+
+private:
+    enet::ENetServer& net;
+    uint32_t channel_id;
+    snap::PriorityConfig priority;
+    RateConfig rate;
+    world::ThreadPool* pool;
+    // 每帧复用
+    std::vector<Task> tasks;
+    std::unordered_map<uint32_t, size_t> leaders;
+    // world 线程 -> 广播线程
+    lfree::ring_queue<std::shared_ptr<SnapshotJob>> jobs;
+    // 广播线程 -> world 线程, 回收的任务
+    lfree::ring_queue<std::shared_ptr<SnapshotJob>> spare;
+    // 解码线程和网络线程 -> 广播线程
+    lfree::ring_queue<Control> controls;
+    std::unordered_map<uint32_t, Client> clients;
+    BroadcastStats broadcast_stats;
+}; // class Broadcaster
+
+} // namespace server
@@ -0,0 +1,25 @@
+#include "server.h"
+
+#include <csignal>
+#include <pthread.h>
+
+int main() {
+    // 信号只由主线程等待: 在创建任何线程之前屏蔽, 各阶段的线程继承屏蔽字
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &set, nullptr);
+
+    // 允许256个客户端连接,每个链接一个通道
+    server::ServerConfig cfg;
+    server::Server svr(cfg);
+    svr.createRoom(cfg.default_room);
+    svr.start();
+
+    int sig = 0;
+    sigwait(&set, &sig);
+    infolog << "signal " << sig << ", shutting down";
+    svr.stop();
+    return 0;
+}
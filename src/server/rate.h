@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "enet.h"
+
+// 按链路状态调节每个会话的快照频率和字节预算
+// 网络线程定期把每个连接的往返时间, 丢包率和在途的可靠数据量交给广播线程. 链路排队(往返时间明显高于测到的最小值),
+// 丢包或者在途数据过多时发送速率减半, 链路良好时线性增加(AIMD). 速率先体现在每帧的字节预算上, 预算降到下限之后
+// 再降低发送频率; 恢复时反过来, 先恢复频率再放大预算. 这样差的链路不会因为不停重传可靠包把服务器的发送队列堆满.
+namespace server{
+
+struct RateConfig{
+    uint32_t sample_ms = 100;          // 链路采样间隔, 0 表示不调节, 每个tick都按 PriorityConfig::budget 发送
+    uint32_t max_interval = 6;         // 两次快照之间最多间隔的tick数
+    uint32_t min_budget = 300;         // 每帧字节预算的下限, 上限是 PriorityConfig::budget
+    uint32_t rtt_slack = 100;          // 往返时间比最小值高出这么多毫秒认为链路在排队
+    uint32_t loss_limit = 3277;        // 丢包率上限, 65536 表示 100%, 默认 5%
+    uint32_t transit_limit = 16384;    // 在途未确认的可靠数据字节数上限
+    float initial = 0.5f;              // 新会话从这个比例的速率开始
+    float increase = 0.05f;            // 链路良好时每次采样增加的比例
+    float decrease = 0.5f;             // 拥塞时速率乘以这个系数
+    uint32_t cooldown = 2;             // 降速之后这么多次采样内不再降速, 等上一次降速生效
+};
+
+// 每个会话一个, 只在广播线程中使用
+class RateController{
+public:
+    // max_budget 为 0 时不限制字节数, 只调节频率
+    RateController(const RateConfig& cfg, uint32_t max_budget)
+        :cfg(cfg)
+        ,max_budget(max_budget)
+    {
+        const float lowest = max_budget ? float(std::min(cfg.min_budget, max_budget)) / max_budget : 1.0f;
+        floor = lowest / std::max(1u, cfg.max_interval);
+        rate = cfg.sample_ms ? std::max(floor, std::min(1.0f, cfg.initial)) : 1.0f;
+        apply();
+    }
+
+    void sample(const enet::LinkStats& s){
+        if (cfg.sample_ms == 0) {
+            return;
+        }
+        if (s.rtt > 0) {
+            min_rtt = std::min(min_rtt, s.rtt);
+        }
+        const bool congested = s.loss > cfg.loss_limit || s.in_transit > cfg.transit_limit
+            || (s.rtt > 0 && s.rtt > min_rtt + cfg.rtt_slack);
+        if (hold > 0) {
+            --hold;
+        }
+        if (congested) {
+            if (hold == 0) {
+                rate = std::max(floor, rate * cfg.decrease);
+                hold = cfg.cooldown;
+                ++backoffs;
+            }
+        }else {
+            rate = std::min(1.0f, rate + cfg.increase);
+        }
+        apply();
+    }
+
+    // tick 是否要给这个会话发快照
+    bool due(uint32_t tick){
+        if (sent != 0 && tick - sent < send_interval) {
+            return false;
+        }
+        sent = tick;
+        return true;
+    }
+
+    // 当前每帧的字节预算, 0 表示不限制
+    uint32_t budget() const { return frame_budget; }
+    uint32_t interval() const { return send_interval; }
+    float fraction() const { return rate; }
+    uint64_t backoffCount() const { return backoffs; }
+
+private:
+    // 速率换算成预算和间隔: 预算不低于下限, 不够的部分用拉长间隔来补
+    void apply(){
+        if (max_budget == 0) {
+            frame_budget = 0;
+            send_interval = std::min(std::max(1u, cfg.max_interval), static_cast<uint32_t>(std::lround(1.0f / rate)));
+            return;
+        }
+        const float bytes = rate * max_budget;
+        const uint32_t low = std::min(cfg.min_budget, max_budget);
+        if (bytes >= low) {
+            frame_budget = static_cast<uint32_t>(bytes);
+            send_interval = 1;
+        }else {
+            frame_budget = low;
+            send_interval = std::min(std::max(1u, cfg.max_interval), static_cast<uint32_t>(std::ceil(low / bytes)));
+        }
+    }
+
+private:
+    RateConfig cfg;
+    uint32_t max_budget;
+    float floor = 0.0f;        // 最低速率, 最小预算配最大间隔
+    float rate = 1.0f;         // 相对最高速率的比例
+    uint32_t min_rtt = UINT32_MAX;
+    uint32_t hold = 0;
+    uint64_t backoffs = 0;
+    uint32_t frame_budget = 0;
+    uint32_t send_interval = 1;
+    uint32_t sent = 0;
+}; // class RateController
+
+} // namespace server
@@ -1,9 +1,329 @@
-
 #include "server.h"
 
-int main() {
-    // 允许256个客户端连接,每个链接一个通道
-    server::Server svr(8080,256,1);
-    svr.start();
-    return 0;
-}
\ No newline at end of file
+#include <algorithm>
+#include <string>
+#include "affinity.h"
+
+namespace server{
+
+static world::RoomManagerConfig roomConfig(const ServerConfig& cfg){
+    world::RoomManagerConfig rc;
+    rc.threads = cfg.world.threads;
+    rc.cpus = cfg.world.cpus;
+    return rc;
+}
+
+Server::Server(const ServerConfig& c)
+    :cfg(c)
+    ,net(c.port, c.client_limit, c.channel_n)
+    ,manager(roomConfig(c))
+    ,limiter(c.limiter)
+{
+    const uint32_t decode_n = std::max(1u, cfg.decode.threads);
+    for (uint32_t i = 0; i < decode_n; ++i) {
+        // 每个解码线程一个 Connect, 解码器的统计各自独立
+        decoders.push_back(std::make_unique<conn::Connect>(net));
+        decoders.back()->bind(&manager);
+        decoders.back()->setLimiter(&limiter);
+        decoders.back()->setAckCallback([this](uint32_t sid, uint32_t tick){ onAck(sid, tick); });
+    }
+    const uint32_t encode_n = cfg.encode.threads ? cfg.encode.threads : std::max(1u, std::thread::hardware_concurrency()) - 1;
+    if (encode_n) {
+        encode_pool = std::make_unique<world::ThreadPool>(encode_n);
+        for (size_t i = 0; i < encode_pool->size(); ++i) {
+            place(encode_pool->worker(i), "encode", i, cfg.encode);
+        }
+    }
+    const uint32_t broadcast_n = std::max(1u, cfg.broadcast.threads);
+    for (uint32_t i = 0; i < broadcast_n; ++i) {
+        broadcasters.push_back(std::make_unique<Broadcaster>(net, cfg.channel_id, cfg.queue_size, cfg.priority, cfg.rate,
+            encode_pool.get()));
+    }
+    net.setConnCallback([this](uint32_t sid){ onConnect(sid); });
+    net.setDisconnCallback([this](uint32_t sid){ onDisconnect(sid); });
+    net.setIdleTimeout(cfg.idle_timeout);
+    if (cfg.rate.sample_ms) {
+        net.setLinkCallback(cfg.rate.sample_ms, [this](const enet::LinkStats& s){ onLink(s); });
+    }
+}
+
+Server::~Server(){
+    stop();
+}
+
+std::shared_ptr<world::Room> Server::createRoom(uint32_t room_id, const world::Config& c, const std::function<void(world::World&)>& init){
+    return manager.create(room_id, c, [this, room_id, &init](world::World& w){
+        if (!cfg.checkpoint_dir.empty()) {
+            const std::string path = cfg.checkpoint_dir + "/room-" + std::to_string(room_id) + ".ckpt";
+            if (world::CheckpointFile::exists(path)) {
+                if (w.restore(path)) {
+                    infolog << "room " << room_id << " restored from checkpoint at tick " << w.currentTick();
+                }else {
+                    warninglog << "room " << room_id << " starts empty, checkpoint " << path << " is not usable";
+                }
+            }
+            w.setCheckpoint(&checkpoints, path, cfg.checkpoint_interval);
+        }
+        if (init) {
+            init(w);
+        }
+        // 从初始化之后开始录制, 回放时用同样的 init 构造初始状态
+        if (!cfg.record_dir.empty() && !w.record(cfg.record_dir + "/room-" + std::to_string(room_id) + ".rec")) {
+            warninglog << "room " << room_id << " is not recorded";
+        }
+        std::shared_ptr<RoomViews> views = std::make_shared<RoomViews>();
+        w.setSnapshotCallback([this, room_id, views](const world::World& w){ publish(room_id, w, *views); });
+    });
+}
+
+std::shared_ptr<world::Room> Server::createLockstepRoom(uint32_t room_id, const world::LockstepConfig& c,
+    const std::function<void(world::LockstepRoom&)>& init){
+    return manager.create(room_id, c, [this, room_id, &init](world::LockstepRoom& r){
+        // members 只在房间线程中使用, 每帧复用
+        r.setSender([this, room_id, members = std::vector<uint32_t>()](const std::shared_ptr<enet::ENetData>& data) mutable {
+            members.clear();
+            if (manager.members(room_id, members) && !members.empty()) {
+                data->setTargets(members);
+                net.send(data);
+            }
+        });
+        if (init) {
+            init(r);
+        }
+    });
+}
+
+bool Server::destroyRoom(uint32_t room_id){
+    std::vector<uint32_t> members;
+    manager.members(room_id, members);
+    if (!manager.destroy(room_id)) {
+        return false;
+    }
+    for (uint32_t sid : members) {
+        shard(room_id).forget(sid);
+    }
+    return true;
+}
+
+bool Server::join(uint32_t session_id, uint32_t room_id){
+    std::shared_ptr<world::Room> old = manager.route(session_id);
+    if (old && old->id() == room_id) {
+        return true;
+    }
+    if (!manager.attach(session_id, room_id)) {
+        return false;
+    }
+    std::shared_ptr<world::Room> room = manager.route(session_id);
+    if (room) {
+        enter(*room, session_id);
+    }
+    // 换了房间, 旧的基线没有意义, 下一帧发全量
+    if (old) {
+        leave(*old, session_id);
+        shard(old->id()).forget(session_id);
+    }
+    return true;
+}
+
+void Server::enter(world::Room& room, uint32_t session_id){
+    const float x = cfg.spawn_x, y = cfg.spawn_y;
+    room.input().produce([session_id, x, y](world::InputBuffer& in){
+        in.join(session_id, x, y);
+    });
+}
+
+void Server::leave(world::Room& room, uint32_t session_id){
+    room.input().produce([session_id](world::InputBuffer& in){
+        in.leave(session_id);
+    });
+}
+
+bool Server::watch(uint32_t session_id, uint32_t entity_id){
+    std::shared_ptr<world::Room> room = manager.route(session_id);
+    if (!room) {
+        return false;
+    }
+    shard(room->id()).watch(session_id, entity_id);
+    return true;
+}
+
+std::thread Server::spawn(const char* stage, size_t i, const StageConfig& stage_cfg, std::function<void()> fn){
+    std::thread t(std::move(fn));
+    place(t, stage, i, stage_cfg);
+    return t;
+}
+
+void Server::place(std::thread& t, const char* stage, size_t i, const StageConfig& stage_cfg){
+    affinity::name(t, std::string(stage) + "-" + std::to_string(i));
+    const int cpu = affinity::pick(stage_cfg.cpus, i);
+    if (!affinity::pin(t, cpu)) {
+        warninglog << "failed to pin " << stage << " thread " << i << " to cpu " << cpu;
+    }
+}
+
+void Server::start(){
+    std::lock_guard<std::mutex> lock(mtx);
+    if (started || stopped) {
+        return;
+    }
+    started = true;
+    net_thread = spawn("net", 0, cfg.net, [this](){ net.start(cfg.net_timeout); });
+    for (size_t i = 0; i < decoders.size(); ++i) {
+        decode_threads.push_back(spawn("decode", i, cfg.decode, [this, i](){ decoders[i]->start(); }));
+    }
+    for (size_t i = 0; i < broadcasters.size(); ++i) {
+        broadcast_threads.push_back(spawn("broadcast", i, cfg.broadcast, [this, i](){ broadcasters[i]->run(); }));
+    }
+    if (!cfg.checkpoint_dir.empty()) {
+        checkpoints.start();
+        affinity::name(checkpoints.thread(), "checkpoint");
+    }
+    manager.start();
+    infolog << "server started on port " << cfg.port << ": decode " << decoders.size() << ", world "
+            << manager.threads() << ", broadcast " << broadcasters.size() << ", encode "
+            << (encode_pool ? encode_pool->size() : 0) << " threads";
+}
+
+void Server::stop(){
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (stopped) {
+            return;
+        }
+        stopped = true;
+        if (!started) {
+            return;
+        }
+    }
+    // 1. 停止接收, 解码线程读完接收队列中剩下的包后退出
+    net.closeReceive();
+    for (auto& t : decode_threads) {
+        t.join();
+    }
+    // 2. 房间执行完正在进行的tick, 最后的快照进入广播队列; 已经提交的检查点写完
+    manager.stop();
+    checkpoints.stop();
+    // 3. 广播线程编码完剩下的快照
+    for (auto& b : broadcasters) {
+        b->close();
+    }
+    for (auto& t : broadcast_threads) {
+        t.join();
+    }
+    // 4. 网络线程把发送队列中的包发出去
+    net.quit();
+    net_thread.join();
+
+    uint64_t decoded = 0, merged = 0, rejected = 0, limited = 0, dropped = 0;
+    for (auto& d : decoders) {
+        decoded += d->stats().decodedCommands();
+        merged += d->stats().mergedCommands();
+        rejected += d->stats().rejectedCommands();
+        dropped += d->stats().droppedPackets();
+        limited += d->limitedPackets();
+    }
+    infolog << "net: " << net.idleKicks() << " idle sessions disconnected";
+    if (!cfg.checkpoint_dir.empty()) {
+        infolog << "checkpoint: " << checkpoints.written() << " written, " << checkpoints.failed() << " failed";
+    }
+    infolog << "decode: " << decoded << " commands, " << merged << " merged, " << rejected << " for other players, "
+            << dropped << " invalid packets, " << limited << " packets over rate limit";
+
+    BroadcastStats total;
+    for (auto& b : broadcasters) {
+        const BroadcastStats s = b->stats();
+        total.frames += s.frames;
+        total.packets += s.packets;
+        total.bytes += s.bytes;
+        total.full += s.full;
+        total.deferred += s.deferred;
+        total.skipped += s.skipped;
+        total.backoffs += s.backoffs;
+        total.shared += s.shared;
+    }
+    infolog << "server stopped: " << total.frames << " snapshots, " << total.packets << " packets, "
+            << total.bytes << " bytes (" << total.shared << " packets shared), " << total.full << " full frames, "
+            << total.deferred << " deferred updates, "
+            << total.skipped << " frames skipped and " << total.backoffs << " backoffs by rate control";
+}
+
+void Server::publish(uint32_t room_id, const world::World& w, RoomViews& views){
+    Broadcaster& b = shard(room_id);
+    std::shared_ptr<SnapshotJob> job = b.acquire();
+    if (!manager.members(room_id, job->sessions) || job->sessions.empty()) {
+        // 房间已经删除或者没有人
+        b.recycle(std::move(job));
+        return;
+    }
+    job->room_id = room_id;
+    job->tick = w.currentTick();
+    job->quant = w.quantizer();
+    job->entities.assign(w.snapshot().begin(), w.snapshot().end());
+    scope(w, views, *job);
+    b.publish(std::move(job));
+}
+
+void Server::scope(const world::World& w, RoomViews& views, SnapshotJob& job){
+    if (cfg.view_radius <= 0.0f) {
+        return;
+    }
+    views.arena.reset();
+    const uint64_t generation = ++views.generation;
+    job.scopes.resize(job.sessions.size());
+    for (size_t i = 0; i < job.sessions.size(); ++i) {
+        const uint32_t sid = job.sessions[i];
+        SnapshotJob::Scope& s = job.scopes[i];
+        // 还没有玩家实体(Join 在下一个tick才生效)的会话收到整个房间
+        const entt::entity e = w.findPlayer(sid);
+        if (e == entt::null) {
+            s = SnapshotJob::Scope();
+            continue;
+        }
+        RoomViews::View& v = views.sessions.try_emplace(sid, RoomViews::View{ world::Interest(cfg.view_radius) }).first->second;
+        v.seen = generation;
+        const world::Position p = w.position(e);
+        v.interest.update(w.spatial(), p.x, p.y, &views.arena);
+        const std::vector<uint32_t>& ids = v.interest.visibleIds();
+        s.begin = static_cast<uint32_t>(job.visible.size());
+        job.visible.insert(job.visible.end(), ids.begin(), ids.end());
+        s.end = static_cast<uint32_t>(job.visible.size());
+        s.viewer = entt::to_integral(e);
+        s.scoped = true;
+    }
+    // 离开房间的会话
+    if (views.sessions.size() > job.sessions.size()) {
+        std::erase_if(views.sessions, [generation](const auto& kv){ return kv.second.seen != generation; });
+    }
+}
+
+void Server::onConnect(uint32_t session_id){
+    limiter.reset(session_id, conn::nowMs());
+    if (cfg.default_room) {
+        join(session_id, cfg.default_room);
+    }
+}
+
+void Server::onDisconnect(uint32_t session_id){
+    std::shared_ptr<world::Room> room = manager.route(session_id);
+    manager.detach(session_id);
+    if (room) {
+        leave(*room, session_id);
+        shard(room->id()).forget(session_id);
+    }
+}
+
+void Server::onAck(uint32_t session_id, uint32_t tick){
+    std::shared_ptr<world::Room> room = manager.route(session_id);
+    if (room) {
+        shard(room->id()).ack(session_id, tick);
+    }
+}
+
+void Server::onLink(const enet::LinkStats& s){
+    std::shared_ptr<world::Room> room = manager.route(s.session_id);
+    if (room) {
+        shard(room->id()).link(s);
+    }
+}
+
+} // namespace server
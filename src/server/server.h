@@ -1,33 +1,144 @@
-#pragma once 
+#pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 #include "log.h"
 #include "enet.h"
-#include <thread>
+#include "aoi.h"
+#include "broadcast.h"
+#include "connect.h"
+#include "rooms.h"
 
 
 namespace server{
+
+// 一个阶段的线程数和CPU绑定, 第 i 个线程绑定到 cpus[i % size], cpus 为空时不绑定
+struct StageConfig{
+    uint32_t threads = 1;
+    std::vector<int> cpus;
+};
+
+struct ServerConfig{
+    uint16_t port = 8080;
+    uint32_t client_limit = 256;
+    uint32_t channel_n = 1;
+    uint32_t channel_id = 0;         // 快照使用的通道
+    uint32_t net_timeout = 1;        // 网络线程每次等待事件的毫秒数
+    uint32_t idle_timeout = 60000;   // 会话这么多毫秒没有发来任何包就断开, 0 表示不检查
+    size_t queue_size = 4096;        // 阶段之间的队列长度
+    uint32_t default_room = 1;       // 新连接进入的房间, 0 表示不自动进入
+    float spawn_x = 0.0f;            // 会话进入状态同步的房间时, 它的玩家实体出生的位置
+    float spawn_y = 0.0f;
+    // 每个会话只收到它的玩家实体这个半径内的实体(AOI), 0 表示收到整个房间
+    float view_radius = 50.0f;
+    std::string record_dir;          // 不为空时每个房间的输入录制到这个目录下的 room-<id>.rec, 见 world/record.h
+    // 不为空时每个房间每 checkpoint_interval 个tick在后台保存检查点到这个目录下的 room-<id>.ckpt,
+    // 创建房间时已经有检查点就从它恢复, 见 world/checkpoint.h
+    std::string checkpoint_dir;
+    uint32_t checkpoint_interval = 300;
+    conn::LimiterConfig limiter;     // 每个会话的上行指令限流, 在解码之前检查
+    snap::PriorityConfig priority;   // 每个会话每帧快照的字节预算和实体优先级
+    RateConfig rate;                 // 按链路状态调节每个会话的快照频率和预算
+    // 网络收发只有一个线程(enet 的 host 不是线程安全的), 只使用 cpus
+    StageConfig net;
+    // 解码和路由, 从网络线程的接收队列中读取
+    StageConfig decode;
+    // 房间的工作线程, threads 为 0 时取硬件线程数
+    StageConfig world{ 0, {} };
+    // 快照编码和分发, 按房间分片
+    StageConfig broadcast;
+    // 各个广播线程共用的编码线程池, 一个快照内的会话切块并行编码, 广播线程自己也参与;
+    // threads 为 0 时取硬件线程数减一
+    StageConfig encode{ 0, {} };
+};
+
+// 服务器的线程模型, 数据沿着四个阶段单向流动, 阶段之间用队列连接:
+//   网络线程 --(接收队列)--> 解码线程 --(房间的 InputQueue)--> 房间工作线程
+//   房间工作线程 --(SnapshotJob 队列)--> 广播线程(和编码线程池) --(发送队列)--> 网络线程
+// 关闭时按同样的顺序排空: 先停止接收, 解码线程读完接收队列后退出; 房间执行完正在进行的tick后停止;
+// 广播线程编码完剩下的快照后退出; 最后网络线程把发送队列中的包发出去再退出.
 class Server{
 public:
-    Server(uint16_t port,uint32_t client_limit = 256,uint32_t channel_n = 1)
-        :net(port,client_limit,channel_n)
-        ,net_thread(&Server::net_handler, this)
-    {
+    explicit Server(const ServerConfig& cfg = ServerConfig());
+    ~Server();
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
 
-    }
-    
-    void start(){
-        
-    }
+    // 创建房间, 房间每个tick的快照交给广播阶段; 可以在 start 之前或之后调用
+    // 从检查点恢复的房间在 init 之前已经有了实体, init 可以用 World::currentTick() 不为0来判断, 只注册系统和协程
+    std::shared_ptr<world::Room> createRoom(uint32_t room_id, const world::Config& cfg = world::Config(),
+        const std::function<void(world::World&)>& init = nullptr);
+    // 创建帧同步的房间, 每帧的指令直接广播给房间内的会话, 不经过广播阶段; 玩家用 PlayerEvent 进出, 见 world::LockstepRoom
+    std::shared_ptr<world::Room> createLockstepRoom(uint32_t room_id, const world::LockstepConfig& cfg = world::LockstepConfig(),
+        const std::function<void(world::LockstepRoom&)>& init = nullptr);
+    bool destroyRoom(uint32_t room_id);
+    // 会话换到另一个房间, 之后只接收这个房间的快照
+    // 会话的玩家 id 就是 session_id: 新房间收到它的 PlayerEvent::Join, 旧房间收到 Leave
+    bool join(uint32_t session_id, uint32_t room_id);
+    // 会话在当前房间中控制的实体(entt::to_integral), 快照按离它的距离安排实体的优先级; 换房间之后要重新设置
+    // 做 AOI 的房间里, 有玩家实体的会话总是按自己的玩家计算
+    bool watch(uint32_t session_id, uint32_t entity_id);
+
+    // 启动所有阶段
+    void start();
+    // 按顺序排空并停止所有阶段, 可以重复调用
+    void stop();
+
+    world::RoomManager& rooms() { return manager; }
+    enet::ENetServer& network() { return net; }
 
 private:
-    // 网络层线程处理函数
-    void net_handler(){
-        // 负责收发网络消息
-        net.start(0);
-    }
+    // 一个状态同步房间里各个会话的 AOI, 只在房间的工作线程中访问
+    struct RoomViews{
+        struct View{
+            world::Interest interest;
+            uint64_t seen = 0;    // 最后一次查询的 generation, 用来清理离开的会话
+        };
+        std::unordered_map<uint32_t, View> sessions;
+        uint64_t generation = 0;
+        // 查询的中间结果, 每次 publish 回收
+        world::FrameArena arena{ 16 * 1024 };
+    };
+
+    // 房间工作线程中, 复制快照交给对应的广播线程
+    void publish(uint32_t room_id, const world::World& w, RoomViews& views);
+    // 按每个会话的玩家实体查询视野, 可见集合放进 job
+    void scope(const world::World& w, RoomViews& views, SnapshotJob& job);
+    Broadcaster& shard(uint32_t room_id) { return *broadcasters[room_id % broadcasters.size()]; }
+    // 在房间的输入队列中放入会话的玩家进出事件, 下一个tick生效
+    void enter(world::Room& room, uint32_t session_id);
+    void leave(world::Room& room, uint32_t session_id);
+    void onConnect(uint32_t session_id);
+    void onDisconnect(uint32_t session_id);
+    void onAck(uint32_t session_id, uint32_t tick);
+    void onLink(const enet::LinkStats& s);
+    std::thread spawn(const char* stage, size_t i, const StageConfig& stage_cfg, std::function<void()> fn);
+    void place(std::thread& t, const char* stage, size_t i, const StageConfig& stage_cfg);
 
 private:
+    ServerConfig cfg;
     enet::ENetServer net;
+    // 在房间之后析构, 房间析构时等它写完自己的检查点
+    world::CheckpointWriter checkpoints;
+    world::RoomManager manager;
+    conn::RateLimiter limiter;
+    std::unique_ptr<world::ThreadPool> encode_pool;
+    std::vector<std::unique_ptr<conn::Connect>> decoders;
+    std::vector<std::unique_ptr<Broadcaster>> broadcasters;
+
     std::thread net_thread;
+    std::vector<std::thread> decode_threads;
+    std::vector<std::thread> broadcast_threads;
+
+    std::mutex mtx;
+    bool started = false;
+    bool stopped = false;
 }; // class Server
-}// namespace server
\ No newline at end of file
+}// namespace server
@@ -0,0 +1,314 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <flatbuffers/flatbuffers.h>
+#include "pack.h"
+
+// 增量快照
+// 服务器为每个客户端保存最近N个tick发出去的快照, 以客户端确认过的tick为基线,
+// 只编码变化的实体和字段; 新出现和消失的实体单独列出; 基线过期时退化为全量帧.
+// 客户端用 DeltaDecoder 还原出完整状态, 并把最后还原的tick通过 Frame.ack 回传.
+//
+// changes 的编码, 按 entity_id 升序, 每个实体:
+//   varint(entity_id - 上一个entity_id) | mask(1字节) | mask中每个置位字段的 int16 (小端)
+// tick 从1开始, 0 表示没有基线.
+namespace snap{
+
+// changes 中 mask 的位定义
+enum Field : uint8_t {
+    Hp    = 1u << 0,
+    Flags = 1u << 1,
+    X     = 1u << 2,
+    Y     = 1u << 3,
+    Vx    = 1u << 4,
+    Vy    = 1u << 5,
+};
+
+// 一个tick的实体快照, 按 entity_id 升序
+struct Snapshot{
+    uint32_t tick = 0;
+    std::vector<io::PackedEntity> entities;
+};
+
+// 最近N个tick的快照环, 用 tick % N 寻址, 过期的快照被自然覆盖
+template<size_t N = 32>
+class SnapshotRing{
+public:
+    // 占用tick对应的槽位, 返回清空后的快照, vector的容量被复用
+    Snapshot& slot(uint32_t tick){
+        Snapshot& s = ring[tick % N];
+        s.tick = tick;
+        s.entities.clear();
+        return s;
+    }
+    const Snapshot* find(uint32_t tick) const {
+        if (tick == 0) {
+            return nullptr;
+        }
+        const Snapshot& s = ring[tick % N];
+        return s.tick == tick ? &s : nullptr;
+    }
+
+private:
+    std::array<Snapshot, N> ring;
+};
+
+namespace detail{
+
+inline uint8_t diff(const io::PackedEntity& a, const io::PackedEntity& b){
+    uint8_t mask = 0;
+    if (a.hp() != b.hp()) mask |= Hp;
+    if (a.status_flags() != b.status_flags()) mask |= Flags;
+    if (a.x() != b.x()) mask |= X;
+    if (a.y() != b.y()) mask |= Y;
+    if (a.vx() != b.vx()) mask |= Vx;
+    if (a.vy() != b.vy()) mask |= Vy;
+    return mask;
+}
+
+inline void putVarint(std::vector<uint8_t>& out, uint32_t v){
+    while (v >= 0x80) {
+        out.push_back(static_cast<uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+inline void put16(std::vector<uint8_t>& out, int16_t v){
+    uint16_t u = static_cast<uint16_t>(v);
+    out.push_back(static_cast<uint8_t>(u));
+    out.push_back(static_cast<uint8_t>(u >> 8));
+}
+
+// 越界返回false
+inline bool getVarint(const uint8_t*& p, const uint8_t* end, uint32_t& v){
+    v = 0;
+    for (int shift = 0; shift < 35 && p < end; shift += 7) {
+        uint8_t b = *p++;
+        v |= static_cast<uint32_t>(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool get16(const uint8_t*& p, const uint8_t* end, int16_t& v){
+    if (end - p < 2) {
+        return false;
+    }
+    v = static_cast<int16_t>(p[0] | (p[1] << 8));
+    p += 2;
+    return true;
+}
+
+} // namespace detail
+
+// 服务器端, 每个客户端一个
+template<size_t N = 32>
+class DeltaEncoder{
+public:
+    // 客户端确认收到了tick, 之后以它为基线
+    // 比已确认的旧, 还没发出过, 或者已经不在环里的tick被忽略, 返回false;
+    // 否则一个伪造的很大的 ack 会让之后真实的确认全部失效, 每帧都退化成全量
+    bool ack(uint32_t tick){
+        if (tick <= acked || tick > sent || history.find(tick) == nullptr) {
+            return false;
+        }
+        acked = tick;
+        return true;
+    }
+    // 基线丢失(比如断线重连)后强制下一帧发全量
+    void reset(){
+        acked = 0;
+    }
+
+    // entities 必须按 entity_id 升序
+    flatbuffers::Offset<io::DeltaFrame> encode(flatbuffers::FlatBufferBuilder& fbb, uint32_t tick,
+        const flat::Quantizer& q, const io::PackedEntity* entities, size_t n){
+        spawns.clear();
+        despawns.clear();
+        changes.clear();
+        const Snapshot* base = history.find(acked);
+        if (base == nullptr) {
+            spawns.assign(entities, entities + n);
+            ++full_count;
+        }else {
+            diff(base->entities, entities, n);
+        }
+        uint32_t baseline = base ? base->tick : 0;
+        // 差分完成之后再记录本帧, 基线和本帧可能落在同一个槽位
+        Snapshot& cur = history.slot(tick);
+        cur.entities.assign(entities, entities + n);
+        sent = tick;
+
+        io::Quant wire = q.toWire();
+        auto s = fbb.CreateVectorOfStructs(spawns.data(), spawns.size());
+        auto d = fbb.CreateVector(despawns.data(), despawns.size());
+        auto c = fbb.CreateVector(changes.data(), changes.size());
+        return io::CreateDeltaFrame(fbb, tick, baseline, &wire, s, d, c);
+    }
+
+    // 本帧和另一个编码器(基线和实体都相同)编出的帧完全一样时, 直接发送那一帧, 这里只记录本帧
+    void commit(uint32_t tick, const io::PackedEntity* entities, size_t n){
+        if (history.find(acked) == nullptr) {
+            ++full_count;
+        }
+        Snapshot& cur = history.slot(tick);
+        cur.entities.assign(entities, entities + n);
+        sent = tick;
+    }
+
+    // 当前的基线和上一帧编码的实体, 不存在时为空
+    const Snapshot* baseline() const { return history.find(acked); }
+    const Snapshot* last() const { return history.find(sent); }
+
+    uint32_t ackTick() const { return acked; }
+    uint64_t fullFrames() const { return full_count; }
+
+private:
+    // 两个有序序列的归并
+    void diff(const std::vector<io::PackedEntity>& base, const io::PackedEntity* cur, size_t n){
+        size_t i = 0, j = 0;
+        uint32_t prev = 0;
+        while (i < base.size() || j < n) {
+            if (j == n || (i < base.size() && base[i].entity_id() < cur[j].entity_id())) {
+                despawns.push_back(base[i].entity_id());
+                ++i;
+            }else if (i == base.size() || cur[j].entity_id() < base[i].entity_id()) {
+                spawns.push_back(cur[j]);
+                ++j;
+            }else {
+                uint8_t mask = detail::diff(base[i], cur[j]);
+                if (mask) {
+                    const io::PackedEntity& e = cur[j];
+                    detail::putVarint(changes, e.entity_id() - prev);
+                    prev = e.entity_id();
+                    changes.push_back(mask);
+                    if (mask & Hp) detail::put16(changes, e.hp());
+                    if (mask & Flags) detail::put16(changes, static_cast<int16_t>(e.status_flags()));
+                    if (mask & X) detail::put16(changes, e.x());
+                    if (mask & Y) detail::put16(changes, e.y());
+                    if (mask & Vx) detail::put16(changes, e.vx());
+                    if (mask & Vy) detail::put16(changes, e.vy());
+                }
+                ++i;
+                ++j;
+            }
+        }
+    }
+
+private:
+    SnapshotRing<N> history;
+    uint32_t acked = 0;
+    uint32_t sent = 0;
+    uint64_t full_count = 0;
+    // 复用的中间缓冲
+    std::vector<io::PackedEntity> spawns;
+    std::vector<uint32_t> despawns;
+    std::vector<uint8_t> changes;
+};
+
+// 客户端, 由增量帧还原完整状态
+template<size_t N = 32>
+class DeltaDecoder{
+public:
+    // 基线丢失, 帧过时或者数据损坏时返回false, 此时状态不变, 继续确认旧的tick, 等服务器发全量帧
+    bool apply(const io::DeltaFrame* frame){
+        if (frame == nullptr || frame->tick() <= last) {
+            return false;
+        }
+        const Snapshot* base = nullptr;
+        if (frame->baseline() != 0) {
+            base = history.find(frame->baseline());
+            if (base == nullptr) {
+                return false;
+            }
+            next.assign(base->entities.begin(), base->entities.end());
+        }else {
+            next.clear();
+        }
+        if (!applyChanges(frame->changes())) {
+            return false;
+        }
+        if (auto d = frame->despawns()) {
+            // despawns 由服务器按升序写出
+            next.erase(std::remove_if(next.begin(), next.end(), [d](const io::PackedEntity& e){
+                return std::binary_search(d->begin(), d->end(), e.entity_id());
+            }), next.end());
+        }
+        if (auto s = frame->spawns()) {
+            size_t mid = next.size();
+            for (uint32_t k = 0; k < s->size(); ++k) {
+                next.push_back(*s->Get(k));
+            }
+            std::inplace_merge(next.begin(), next.begin() + mid, next.end(), byId);
+        }
+        quant = flat::Quantizer::fromWire(frame->quant());
+        last = frame->tick();
+        Snapshot& cur = history.slot(last);
+        cur.entities.swap(next);
+        current = &cur;
+        return true;
+    }
+
+    // 需要回传给服务器的 ack
+    uint32_t ack() const { return last; }
+    const flat::Quantizer& quantizer() const { return quant; }
+    const std::vector<io::PackedEntity>& state() const {
+        static const std::vector<io::PackedEntity> empty;
+        return current ? current->entities : empty;
+    }
+
+private:
+    static bool byId(const io::PackedEntity& a, const io::PackedEntity& b){
+        return a.entity_id() < b.entity_id();
+    }
+
+    bool applyChanges(const flatbuffers::Vector<uint8_t>* changes){
+        if (changes == nullptr) {
+            return true;
+        }
+        const uint8_t* p = changes->data();
+        const uint8_t* end = p + changes->size();
+        uint32_t id = 0;
+        auto it = next.begin();
+        while (p < end) {
+            uint32_t delta;
+            if (!detail::getVarint(p, end, delta) || p == end) {
+                return false;
+            }
+            id += delta;
+            uint8_t mask = *p++;
+            it = std::lower_bound(it, next.end(), id, [](const io::PackedEntity& e, uint32_t v){
+                return e.entity_id() < v;
+            });
+            if (it == next.end() || it->entity_id() != id) {
+                return false;
+            }
+            int16_t hp = it->hp(), x = it->x(), y = it->y(), vx = it->vx(), vy = it->vy();
+            int16_t flags = static_cast<int16_t>(it->status_flags());
+            if ((mask & Hp) && !detail::get16(p, end, hp)) return false;
+            if ((mask & Flags) && !detail::get16(p, end, flags)) return false;
+            if ((mask & X) && !detail::get16(p, end, x)) return false;
+            if ((mask & Y) && !detail::get16(p, end, y)) return false;
+            if ((mask & Vx) && !detail::get16(p, end, vx)) return false;
+            if ((mask & Vy) && !detail::get16(p, end, vy)) return false;
+            *it = io::PackedEntity(id, hp, static_cast<uint16_t>(flags), x, y, vx, vy);
+        }
+        return true;
+    }
+
+private:
+    SnapshotRing<N> history;
+    const Snapshot* current = nullptr;
+    std::vector<io::PackedEntity> next;
+    flat::Quantizer quant;
+    uint32_t last = 0;
+};
+
+} // namespace snap
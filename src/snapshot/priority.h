@@ -0,0 +1,228 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "delta.h"
+#include "pack.h"
+
+// 按优先级在带宽预算内挑选实体
+// 人多的区域即使经过AOI过滤, 一帧的变化量也可能超出客户端链路的承受能力. 每个客户端为每个实体保存一个优先级累加器,
+// 实体有新状态但还没发给客户端时, 每个tick按类型和离观察者的距离增加优先级; 每帧按优先级从高到低把更新放进帧里,
+// 直到字节预算用完. 没放进去的实体保留累加的优先级, 等得越久越靠前, 不会一直发不出去.
+//
+// 和增量编码的配合: DeltaEncoder 以客户端确认过的tick为基线差分, 客户端每帧都从基线重新还原. 没选中的实体
+// 尽量沿用上一帧发出的值(客户端可能已经看到了), 但这部分相对基线同样有开销, 一直沿用的话预算会被已经发过的实体占满,
+// 新的实体永远挤不进来. 所以沿用也按优先级排在新的更新后面, 预算用完时退回基线的值(客户端看到的位置回退到确认过的tick),
+// 基线中没有的实体暂时不出现. 退回的实体继续累加优先级, 很快会再被发出去.
+namespace snap{
+
+struct PriorityConfig{
+    uint32_t budget = 1200;        // 每帧实体数据的字节预算, 不含帧头, 0 表示不限制
+    float player_weight = 4.0f;    // 每个tick增加的优先级, 玩家(flat::Player)和其他实体分开设置
+    float npc_weight = 1.0f;
+    float falloff = 32.0f;         // 距离观察者 falloff 远(世界坐标)的实体, 优先级的增长速度减半
+};
+
+// 编码开销的估算, 和 DeltaEncoder 的格式对应
+namespace cost{
+
+const uint32_t Spawn = sizeof(io::PackedEntity);
+const uint32_t Despawn = sizeof(uint32_t);
+
+// varint 的 id 差值按2字节估算
+inline uint32_t change(uint8_t mask){
+    return mask ? 3 + 2 * static_cast<uint32_t>(__builtin_popcount(mask)) : 0;
+}
+
+// 相对基线发送 e 的开销, 基线中没有时是新出现的实体
+inline uint32_t of(const io::PackedEntity* base, const io::PackedEntity& e){
+    return base ? change(detail::diff(*base, e)) : Spawn;
+}
+
+} // namespace cost
+
+// 每个客户端一个, 和它的 DeltaEncoder 一起只在广播线程中使用
+class PriorityFilter{
+public:
+    explicit PriorityFilter(const PriorityConfig& cfg = PriorityConfig())
+        :cfg(cfg)
+    {}
+
+    // 和 entt::null 的值相同
+    static const uint32_t NoViewer = 0xFFFFFFFFu;
+
+    // 观察者实体(客户端自己控制的角色), 距离按它计算; NoViewer 表示没有, 距离不影响优先级
+    void watch(uint32_t entity_id){
+        viewer = entity_id;
+    }
+    uint32_t watching() const { return viewer; }
+    // 按链路状况调整每帧的字节预算, 0 表示不限制
+    void setBudget(uint32_t bytes){
+        cfg.budget = bytes;
+    }
+    uint32_t budget() const { return cfg.budget; }
+
+    // 挑选本帧交给 DeltaEncoder 的实体, 按 entity_id 升序
+    // base 是编码器的基线, prev 是上一帧编码的实体, 都可以为空; cur 是房间本tick的快照, 按 entity_id 升序
+    const std::vector<io::PackedEntity>& select(const Snapshot* base, const Snapshot* prev,
+        const flat::Quantizer& q, const io::PackedEntity* cur, size_t n){
+        view.clear();
+        whole = true;
+        if (cfg.budget == 0) {
+            view.assign(cur, cur + n);
+            return view;
+        }
+        picks.assign(n, nullptr);
+        candidates.clear();
+        holds.clear();
+        next.clear();
+        const io::PackedEntity* eye = find(cur, n, viewer);
+        size_t bi = 0, pi = 0, ai = 0, matched = 0;
+        for (size_t j = 0; j < n; ++j) {
+            const io::PackedEntity& e = cur[j];
+            const uint32_t id = e.entity_id();
+            const io::PackedEntity* b = seek(base, bi, id);
+            const io::PackedEntity* p = seek(prev, pi, id);
+            matched += b != nullptr;
+            // 放不下时退回基线的值, 不占预算; 基线中没有的实体暂时不出现
+            picks[j] = b;
+            const uint32_t keep = p ? cost::of(b, *p) : Never;
+            if (p && detail::diff(*p, e) == 0) {
+                // 客户端已经是最新的, 优先级清零; 和基线相同时不占预算
+                if (keep == 0) {
+                    picks[j] = &e;
+                }else {
+                    holds.push_back(Hold{ static_cast<uint32_t>(j), keep, p });
+                }
+                continue;
+            }
+            const float priority = accumulated(ai, id) + growth(q, e, eye);
+            candidates.push_back(Candidate{ static_cast<uint32_t>(j), cost::of(b, e), keep, p, priority });
+        }
+        // 消失的实体总是要发
+        const uint32_t gone = base ? cost::Despawn * static_cast<uint32_t>(base->entities.size() - matched) : 0;
+        uint32_t left = gone < cfg.budget ? cfg.budget - gone : 0;
+
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b){
+            return a.priority > b.priority;
+        });
+        // 按优先级依次尝试发新值, 放不下时沿用上一帧的值, 还放不下就退回基线.
+        // 优先级最高的总是最先尝试, 预算大于一个实体的开销就不会饿死
+        for (const Candidate& c : candidates) {
+            if (c.send <= left) {
+                left -= c.send;
+                picks[c.j] = &cur[c.j];
+                continue;
+            }
+            if (c.keep <= left) {
+                left -= c.keep;
+                picks[c.j] = c.prev;
+            }
+            next.push_back(Acc{ cur[c.j].entity_id(), c.priority });
+            ++deferred_count;
+            whole = false;
+        }
+        // 已经是最新但还没确认的实体, 剩下的预算用来保持客户端看到的值, 退回基线的下一帧从零开始累加
+        for (const Hold& h : holds) {
+            if (h.keep <= left) {
+                left -= h.keep;
+                picks[h.j] = h.prev;
+            }else {
+                whole = false;
+            }
+        }
+        std::sort(next.begin(), next.end(), [](const Acc& a, const Acc& b){ return a.id < b.id; });
+        acc.swap(next);
+
+        for (const io::PackedEntity* e : picks) {
+            if (e) {
+                view.push_back(*e);
+            }
+        }
+        return view;
+    }
+
+    // 上一次 select 是否原样选中了所有实体; 这样的帧只取决于基线和房间的快照, 可以在会话之间共享
+    bool complete() const { return whole; }
+    // 因为预算推迟的实体更新次数
+    uint64_t deferredCount() const { return deferred_count; }
+    // 当前有待发更新的实体数
+    size_t pending() const { return acc.size(); }
+
+private:
+    struct Acc{
+        uint32_t id;
+        float priority;
+    };
+    static const uint32_t Never = 0xFFFFFFFFu;
+
+    struct Candidate{
+        uint32_t j;                    // 在 cur 中的下标
+        uint32_t send;                 // 发新值的开销
+        uint32_t keep;                 // 沿用上一帧的值的开销, 上一帧没有时为 Never
+        const io::PackedEntity* prev;
+        float priority;
+    };
+    struct Hold{
+        uint32_t j;
+        uint32_t keep;
+        const io::PackedEntity* prev;
+    };
+
+    float growth(const flat::Quantizer& q, const io::PackedEntity& e, const io::PackedEntity* eye) const {
+        const float w = (e.status_flags() & flat::Player) ? cfg.player_weight : cfg.npc_weight;
+        if (eye == nullptr || cfg.falloff <= 0.0f) {
+            return w;
+        }
+        const float dx = float(e.x() - eye->x()) / q.pos_scale;
+        const float dy = float(e.y() - eye->y()) / q.pos_scale;
+        return w * cfg.falloff / (cfg.falloff + std::sqrt(dx * dx + dy * dy));
+    }
+
+    // 累加器和 cur 一样按 id 升序, 顺序推进游标
+    float accumulated(size_t& i, uint32_t id) const {
+        while (i < acc.size() && acc[i].id < id) {
+            ++i;
+        }
+        return i < acc.size() && acc[i].id == id ? acc[i].priority : 0.0f;
+    }
+
+    static const io::PackedEntity* seek(const Snapshot* s, size_t& i, uint32_t id){
+        if (s == nullptr) {
+            return nullptr;
+        }
+        const std::vector<io::PackedEntity>& v = s->entities;
+        while (i < v.size() && v[i].entity_id() < id) {
+            ++i;
+        }
+        return i < v.size() && v[i].entity_id() == id ? &v[i] : nullptr;
+    }
+
+    static const io::PackedEntity* find(const io::PackedEntity* cur, size_t n, uint32_t id){
+        if (id == NoViewer) {
+            return nullptr;
+        }
+        const io::PackedEntity* it = std::lower_bound(cur, cur + n, id, [](const io::PackedEntity& e, uint32_t v){
+            return e.entity_id() < v;
+        });
+        return it != cur + n && it->entity_id() == id ? it : nullptr;
+    }
+
+private:
+    PriorityConfig cfg;
+    uint32_t viewer = NoViewer;
+    bool whole = true;
+    uint64_t deferred_count = 0;
+    std::vector<Acc> acc;                        // 有待发更新的实体, 按 id 升序
+    // 每帧复用的中间缓冲
+    std::vector<Acc> next;
+    std::vector<Candidate> candidates;
+    std::vector<Hold> holds;
+    std::vector<const io::PackedEntity*> picks;
+    std::vector<io::PackedEntity> view;
+}; // class PriorityFilter
+
+} // namespace snap
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+#include <entt/entt.hpp>
+#include "arena.h"
+#include "grid.h"
+
+// 兴趣区域(AOI)
+// 每个客户端只关心视野半径内的实体, 每个tick查询空间索引得到可见集合,
+// 和上一tick比较得到进入和离开事件. 可见集合交给 World::gather 生成该客户端的快照(或者随快照交给广播线程,
+// 见 server::Server::scope), 进入/离开的实体在增量编码中自然成为 spawns/despawns.
+// 传入帧分配器时, 查询的中间结果和进入/离开集合从帧分配器分配, 只有可见集合跨tick保留.
+namespace world{
+
+class Interest{
+public:
+    explicit Interest(float radius = 50.0f)
+        :radius(radius)
+    {}
+
+    // 以(x, y)为中心刷新可见集合
+    // arena 非空时进入/离开集合在 arena 下一次 reset 之前有效
+    void update(const SpatialIndex& index, float x, float y, FrameArena* arena = nullptr){
+        std::pmr::memory_resource* res = arena ? static_cast<std::pmr::memory_resource*>(arena) : std::pmr::get_default_resource();
+        FrameVector<entt::entity> found(res);
+        found.reserve(visible.size() + visible.size() / 4);
+        index.query(x, y, radius, found);
+        FrameVector<uint32_t> current(res);
+        current.reserve(found.size());
+        for (entt::entity e : found) {
+            current.push_back(entt::to_integral(e));
+        }
+        std::sort(current.begin(), current.end());
+
+        entered = FrameVector<uint32_t>(res);
+        left = FrameVector<uint32_t>(res);
+        entered.reserve(current.size());
+        left.reserve(visible.size());
+        std::set_difference(current.begin(), current.end(), visible.begin(), visible.end(), std::back_inserter(entered));
+        std::set_difference(visible.begin(), visible.end(), current.begin(), current.end(), std::back_inserter(left));
+        // 可见集合留有余量, 人数在附近波动时不反复扩容
+        if (visible.capacity() < current.size()) {
+            visible.reserve(current.size() + current.size() / 2);
+        }
+        visible.assign(current.begin(), current.end());
+    }
+
+    void setRadius(float r) { radius = r; }
+    float viewRadius() const { return radius; }
+    // 当前可见的 entity_id, 升序
+    const std::vector<uint32_t>& visibleIds() const { return visible; }
+    // 本tick进入视野的 entity_id
+    const FrameVector<uint32_t>& enterIds() const { return entered; }
+    // 本tick离开视野的 entity_id
+    const FrameVector<uint32_t>& leaveIds() const { return left; }
+
+private:
+    float radius;
+    std::vector<uint32_t> visible;
+    FrameVector<uint32_t> entered;
+    FrameVector<uint32_t> left;
+};
+
+} // namespace world
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <vector>
+
+// 帧分配器
+// 一个tick中的临时数据(快照, 命中, 中间结果)从一块连续的内存中顺序分配, 释放是空操作,
+// 下一个tick开始时整体回收. 一个tick用到的内存超过当前块时向系统再申请一块,
+// 回收时把多块合并成一块更大的, 稳定之后每个tick都只用一块, 不再调用全局分配器.
+namespace world{
+
+struct ArenaStats{
+    uint64_t allocations = 0;  // 上一个tick的分配次数
+    uint64_t bytes = 0;        // 上一个tick分配的字节数
+    uint64_t peak = 0;         // 单个tick分配字节数的最大值
+    uint64_t upstream = 0;     // 累计向系统申请内存块的次数
+    uint64_t resets = 0;
+};
+
+class FrameArena : public std::pmr::memory_resource{
+public:
+    explicit FrameArena(size_t initial = 64 * 1024){
+        grow(0, initial);
+    }
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // 回收上一个tick的全部内存, 之前分配出去的指针全部失效
+    // 不能和 allocate 同时调用
+    void reset(){
+        const uint64_t used = bytes.load(std::memory_order_relaxed);
+        last.allocations = allocations.load(std::memory_order_relaxed);
+        last.bytes = used;
+        last.peak = std::max(last.peak, used);
+        ++last.resets;
+        const size_t used_blocks = blockOf(state.load(std::memory_order_relaxed)) + 1;
+        if (used_blocks > 1) {
+            // 合并成一块, 大小是峰值向上取2的幂
+            size_t size = blocks[0].size;
+            while (size < last.peak) {
+                size *= 2;
+            }
+            for (size_t i = 0; i < used_blocks; ++i) {
+                blocks[i].data.reset();
+            }
+            grow(0, size);
+        }
+        state.store(0, std::memory_order_relaxed);
+        allocations.store(0, std::memory_order_relaxed);
+        bytes.store(0, std::memory_order_relaxed);
+    }
+
+    // 上一个tick的统计, reset 时更新
+    const ArenaStats& stats() const { return last; }
+    size_t capacity() const { return blocks[0].size; }
+
+private:
+    // 当前块的下标和块内偏移放在同一个原子变量中, 换块和分配不会交错
+    static const int OFFSET_BITS = 48;
+    static const size_t MAX_BLOCKS = 32;
+    static size_t blockOf(uint64_t s) { return size_t(s >> OFFSET_BITS); }
+    static size_t offsetOf(uint64_t s) { return size_t(s & ((uint64_t(1) << OFFSET_BITS) - 1)); }
+    static uint64_t pack(size_t block, size_t offset) { return (uint64_t(block) << OFFSET_BITS) | offset; }
+
+    struct Block{
+        std::unique_ptr<std::byte[]> data;
+        size_t size = 0;
+    };
+
+    // 当前块中用CAS顺序分配, 放不下时加锁换一块新的
+    void* do_allocate(size_t size, size_t align) override {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        bytes.fetch_add(size, std::memory_order_relaxed);
+        uint64_t s = state.load(std::memory_order_acquire);
+        while (true) {
+            const size_t k = blockOf(s);
+            const Block& b = blocks[k];
+            const uintptr_t base = reinterpret_cast<uintptr_t>(b.data.get());
+            const size_t start = ((base + offsetOf(s) + align - 1) & ~(uintptr_t(align) - 1)) - base;
+            if (start + size <= b.size) {
+                if (state.compare_exchange_weak(s, pack(k, start + size), std::memory_order_acq_rel)) {
+                    return b.data.get() + start;
+                }
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(mtx);
+            if (blockOf(state.load(std::memory_order_acquire)) == k) {
+                if (k + 1 == MAX_BLOCKS) {
+                    throw std::bad_alloc();
+                }
+                grow(k + 1, std::max(b.size * 2, size + align));
+            }
+            s = state.load(std::memory_order_acquire);
+        }
+    }
+
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    void grow(size_t k, size_t size){
+        blocks[k].data.reset(new std::byte[size]);
+        blocks[k].size = size;
+        ++last.upstream;
+        state.store(pack(k, 0), std::memory_order_release);
+    }
+
+private:
+    Block blocks[MAX_BLOCKS];
+    std::atomic<uint64_t> state{ 0 };
+    std::atomic<uint64_t> allocations{ 0 };
+    std::atomic<uint64_t> bytes{ 0 };
+    std::mutex mtx;
+    ArenaStats last;
+}; // class FrameArena
+
+// 从帧分配器分配的数组, 在下一个tick开始之前有效
+template<class T>
+using FrameVector = std::pmr::vector<T>;
+
+} // namespace world
@@ -0,0 +1,140 @@
+#include "checkpoint.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "log.h"
+
+// 检查点文件的读写
+namespace world{
+
+void CheckpointWriter::start(){
+    std::lock_guard<std::mutex> lock(mtx);
+    if (running) {
+        return;
+    }
+    running = true;
+    worker = std::thread(&CheckpointWriter::run, this);
+}
+
+void CheckpointWriter::stop(){
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        running = false;
+    }
+    cv.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+bool CheckpointWriter::submit(CheckpointImage* image){
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (running) {
+            jobs.push_back(image);
+            cv.notify_one();
+            return true;
+        }
+    }
+    image->busy.store(false, std::memory_order_release);
+    return false;
+}
+
+void CheckpointWriter::run(){
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        cv.wait(lock, [this](){ return !jobs.empty() || !running; });
+        if (jobs.empty()) {
+            break;
+        }
+        CheckpointImage* image = jobs.front();
+        jobs.pop_front();
+        lock.unlock();
+        if (write(*image)) {
+            written_n.fetch_add(1, std::memory_order_relaxed);
+        }else {
+            failed_n.fetch_add(1, std::memory_order_relaxed);
+        }
+        // 之后 world 线程可以重新使用这块缓冲
+        image->busy.store(false, std::memory_order_release);
+        lock.lock();
+    }
+}
+
+// 写到临时文件, 落盘之后改名, 崩溃时留下的总是上一个完整的检查点
+bool CheckpointWriter::write(const CheckpointImage& image){
+    const std::string tmp = image.path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        errorlog << "failed to create checkpoint " << tmp;
+        return false;
+    }
+    const uint8_t* p = image.bytes.data();
+    size_t left = image.bytes.size();
+    while (left > 0) {
+        ssize_t n = ::write(fd, p, left);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            errorlog << "failed to write checkpoint " << tmp;
+            ::close(fd);
+            return false;
+        }
+        p += n;
+        left -= size_t(n);
+    }
+    bool ok = ::fsync(fd) == 0;
+    ok = ::close(fd) == 0 && ok;
+    if (!ok || std::rename(tmp.c_str(), image.path.c_str()) != 0) {
+        errorlog << "failed to commit checkpoint " << image.path;
+        return false;
+    }
+    return true;
+}
+
+bool CheckpointFile::exists(const std::string& path){
+    return ::access(path.c_str(), F_OK) == 0;
+}
+
+bool CheckpointFile::open(const std::string& path){
+    close();
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        errorlog << "failed to open checkpoint " << path;
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(CheckpointHeader)) {
+        errorlog << "checkpoint " << path << " is too short";
+        close();
+        return false;
+    }
+    void* p = ::mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+        errorlog << "failed to map checkpoint " << path;
+        close();
+        return false;
+    }
+    base = static_cast<const uint8_t*>(p);
+    length = size_t(st.st_size);
+    return true;
+}
+
+void CheckpointFile::close(){
+    if (base) {
+        ::munmap(const_cast<uint8_t*>(base), length);
+        base = nullptr;
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    length = 0;
+}
+
+} // namespace world
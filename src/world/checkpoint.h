@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "fixed.h"
+
+// 房间状态的检查点
+// 进程重启时房间的状态从检查点恢复, 不用重新加载. 检查点是一块平坦的, 和地址无关的内存:
+//   CheckpointHeader, 然后按 slot 顺序的各列: x, y, vx, vy(Real), entity, hp, status, player_id, view_tick,
+//   cooldown(4字节), move_x, move_y, buttons(1字节); 最后是还没到期的定时器的各列: entity, kind, data,
+//   剩余的tick数(4字节). 每列补齐到8字节
+// 运动学数据本来就是 SoA 的列, 保存和恢复都是整列拷贝; 实体按原来的 id 重建, 快照中的 entity_id 不变.
+// 定时器按剩余的tick数重新放进时间轮, 技能冷却和自定义定时器恢复之后照常到期, 但之前的 TimerId 失效.
+//
+// world 线程在tick结束时把状态拷贝到两块缓冲中空闲的一块, 交给后台的 CheckpointWriter 写文件(先写临时文件,
+// fsync 之后改名, 文件总是完整的), tick 只付出一次内存拷贝, 不等磁盘. 两块都在写的时候跳过这一次.
+// 恢复时只读映射检查点文件, 直接从映射的内存中按列重建.
+// 协程不保存, 由房间的初始化重新启动.
+namespace world{
+
+struct CheckpointHeader{
+    static const uint32_t MAGIC = 0x504b4347;   // "GCKP"
+    static const uint16_t VERSION = 2;
+    uint32_t magic = MAGIC;
+    uint16_t version = VERSION;
+    uint16_t real_size = 0;    // sizeof(Real), 浮点和定点数的检查点不能混用
+    uint32_t tick = 0;         // 保存的是这个tick结束时的状态
+    uint32_t entities = 0;
+    uint32_t timers = 0;       // 还没到期的定时器数
+    uint32_t reserved = 0;
+    uint64_t bytes = 0;        // 整个检查点的长度
+    uint64_t hash = 0;         // 保存时的 World::stateHash, 恢复之后用来校验
+};
+
+// 各列在检查点中的偏移
+struct CheckpointLayout{
+    size_t x, y, vx, vy;
+    size_t entity, hp, status, player, view, cooldown;
+    size_t move_x, move_y, buttons;
+    size_t timer_entity, timer_kind, timer_data, timer_left;
+    size_t total;
+
+    // n 个实体, m 个定时器
+    CheckpointLayout(size_t n, size_t m){
+        size_t at = align(sizeof(CheckpointHeader));
+        auto next = [&at](size_t bytes){
+            size_t p = at;
+            at = align(at + bytes);
+            return p;
+        };
+        x = next(n * sizeof(Real));
+        y = next(n * sizeof(Real));
+        vx = next(n * sizeof(Real));
+        vy = next(n * sizeof(Real));
+        entity = next(n * 4);
+        hp = next(n * 4);
+        status = next(n * 4);
+        player = next(n * 4);
+        view = next(n * 4);
+        cooldown = next(n * 4);
+        move_x = next(n);
+        move_y = next(n);
+        buttons = next(n);
+        timer_entity = next(m * 4);
+        timer_kind = next(m * 4);
+        timer_data = next(m * 4);
+        timer_left = next(m * 4);
+        total = at;
+    }
+    static size_t align(size_t n){ return (n + 7) & ~size_t(7); }
+};
+
+struct CheckpointStats{
+    uint64_t saved = 0;        // 交给写线程的次数
+    uint64_t skipped = 0;      // 两块缓冲都在写, 跳过的次数
+    uint64_t bytes = 0;        // 最近一次的大小
+    uint64_t copy_ns = 0;      // 最近一次在 world 线程上拷贝的耗时
+};
+
+// 一块检查点缓冲, 写线程写完之后清除 busy
+struct CheckpointImage{
+    std::vector<uint8_t> bytes;
+    std::string path;
+    std::atomic<bool> busy{ false };
+};
+
+// 后台写检查点文件的线程, 多个房间共用一个
+class CheckpointWriter{
+public:
+    CheckpointWriter() = default;
+    ~CheckpointWriter(){ stop(); }
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    void start();
+    // 写完已经提交的检查点之后退出
+    void stop();
+    // 调用者已经设置了 image->busy, 没有启动时清除 busy 并返回false
+    bool submit(CheckpointImage* image);
+
+    std::thread& thread() { return worker; }
+    uint64_t written() const { return written_n.load(std::memory_order_relaxed); }
+    uint64_t failed() const { return failed_n.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+    bool write(const CheckpointImage& image);
+
+private:
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<CheckpointImage*> jobs;
+    std::thread worker;
+    bool running = false;
+    std::atomic<uint64_t> written_n{ 0 };
+    std::atomic<uint64_t> failed_n{ 0 };
+}; // class CheckpointWriter
+
+// 只读映射的检查点文件
+class CheckpointFile{
+public:
+    CheckpointFile() = default;
+    ~CheckpointFile(){ close(); }
+    CheckpointFile(const CheckpointFile&) = delete;
+    CheckpointFile& operator=(const CheckpointFile&) = delete;
+
+    static bool exists(const std::string& path);
+    bool open(const std::string& path);
+    void close();
+
+    const uint8_t* data() const { return base; }
+    size_t size() const { return length; }
+
+private:
+    int fd = -1;
+    const uint8_t* base = nullptr;
+    size_t length = 0;
+};
+
+} // namespace world
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <entt/entt.hpp>
+#include "kinematics.h"
+
+// 攻击和技能的碰撞检测
+// 粗检测: 实体按 y 分带, 带内按 x 排序(sort and sweep), 形状的包围盒在每条带中二分出 x 的区间, 再用 y 过滤;
+// 细检测: 圆和矩形对实体圆的精确判定, 由调用方完成(需要回退到历史位置).
+// 实体每个tick只移动很小的距离, 排序的结果几乎不变, 插入排序的代价接近线性.
+// 坐标, 排序键和距离都用 Real, WORLD_FIXED_POINT 下命中判定和运动一样逐位确定.
+namespace world{
+
+// 距离平方的类型: 浮点数就是本身; Q16 只有 ±32768, 相距 200 的平方就会溢出, 换成 Q32
+template<class T>
+struct Square{
+    using type = T;
+    static T of(T v){ return v; }
+};
+template<>
+struct Square<Q16>{
+    using type = Q32;
+    static Q32 of(Q16 v){ return Q32::fromRaw(int64_t(v.raw()) << 16); }
+};
+using RealSq = Square<Real>::type;
+
+// 判定形状, T 是模拟使用的数值类型, 定点数模式下判定也不经过浮点数
+template<class T>
+struct BasicShape{
+    using Sq = typename Square<T>::type;
+    enum Kind : uint8_t { Circle, Box };
+    Kind kind;
+    T x, y;   // 圆心或者矩形中心
+    T hx, hy; // 圆的半径(hx), 或者矩形的半宽和半高
+
+    static BasicShape circle(T x, T y, T r){ return BasicShape{ Circle, x, y, r, r }; }
+    static BasicShape box(T x, T y, T hx, T hy){ return BasicShape{ Box, x, y, hx, hy }; }
+    // 面朝 (mx, my) 方向, 边长为 size 的方形, 方向为零时以 (x, y) 为中心; mx, my 是 [-128, 127] 的输入
+    // 方向先缩小到 [-1, 1], 平方和不超过 2, Q16 也不会溢出
+    static BasicShape ahead(T x, T y, int mx, int my, T size){
+        using std::sqrt;
+        const T half = size / T(2);
+        const T dx = T(mx) / T(128), dy = T(my) / T(128);
+        const T len = sqrt(dx * dx + dy * dy);
+        if (len == T(0)) {
+            return box(x, y, half, half);
+        }
+        return box(x + dx / len * half, y + dy / len * half, half, half);
+    }
+
+    // 半径为 radius 的圆(实体)和形状是否相交, d2 是圆心到形状中心的距离平方
+    bool overlaps(T px, T py, T radius, Sq& d2) const {
+        using std::abs;
+        using std::max;
+        const Sq zero = Sq(0);
+        const Sq dx = Square<T>::of(px) - Square<T>::of(x);
+        const Sq dy = Square<T>::of(py) - Square<T>::of(y);
+        const Sq r = Square<T>::of(radius);
+        d2 = dx * dx + dy * dy;
+        if (kind == Circle) {
+            const Sq reach = Square<T>::of(hx) + r;
+            return d2 <= reach * reach;
+        }
+        // 圆心到矩形的最近点
+        const Sq cx = max(abs(dx) - Square<T>::of(hx), zero);
+        const Sq cy = max(abs(dy) - Square<T>::of(hy), zero);
+        return cx * cx + cy * cy <= r * r;
+    }
+};
+using Shape = BasicShape<Real>;
+
+// 一次命中: 谁的哪个动作碰到了谁, 每个tick重新生成
+struct Contact{
+    entt::entity source;
+    entt::entity target;
+    uint8_t action;   // flat::Status 中的动作位
+    RealSq dist2;     // 目标到形状中心的距离平方
+};
+
+class Broadphase{
+public:
+    // 按 y 分成高度为 strip 的带, 每一带内按 x 排序; 查询只扫描和包围盒相交的几条带中 x 在区间内的一段
+    // 实体密集时只按 x 一个轴扫描, 区间内大部分实体的 y 都不满足, 分带之后扫描的数量和包围盒的面积成正比
+    // 排序键和坐标都是 Real, 定点数模式下分带和比较都是整数运算; 配置中的浮点数在这里转换
+    Broadphase(float min_y, float max_y, float strip)
+        :min_y(Real(min_y))
+        ,inv(Real(1.0f / strip))
+    {
+        rows = std::max(1, int(std::ceil((max_y - min_y) / strip)));
+        begins.resize(size_t(rows) + 1, 0);
+    }
+
+    // 每个tick调用一次, 读取当前的位置并保持有序
+    // 删除的 slot(>= size) 去掉, 新增的追加在末尾, 追加很多时整体排序
+    void update(const Kinematics& body){
+        const size_t n = body.size();
+        const size_t known = order.size();
+        order.erase(std::remove_if(order.begin(), order.end(), [n](uint32_t s){ return s >= n; }), order.end());
+        for (size_t s = known; s < n; ++s) {
+            order.push_back(static_cast<uint32_t>(s));
+        }
+        xs.resize(n);
+        ys.resize(n);
+        strips.resize(n);
+        const Real* x = body.x();
+        const Real* y = body.y();
+        const Real* vx = body.vx();
+        const Real* vy = body.vy();
+        using std::abs;
+        using std::max;
+        max_speed = Real(0);
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t s = order[i];
+            xs[i] = x[s];
+            ys[i] = y[s];
+            strips[i] = row(ys[i]);
+            max_speed = max(max_speed, abs(vx[s]) + abs(vy[s]));
+        }
+        if (n > known && (n - known) * 8 > n) {
+            sortAll();
+        }else{
+            insertionSort();
+        }
+        // 每一带的起始位置
+        std::fill(begins.begin(), begins.end(), 0);
+        for (size_t i = 0; i < n; ++i) {
+            ++begins[strips[i] + 1];
+        }
+        for (int r = 0; r < rows; ++r) {
+            begins[r + 1] += begins[r];
+        }
+    }
+
+    // 包围盒 [x0, x1] x [y0, y1] 内的实体, 回调 f(slot, x, y)
+    template<class F>
+    void sweep(Real x0, Real y0, Real x1, Real y1, F&& f) const {
+        const int r1 = row(y1);
+        for (int r = row(y0); r <= r1; ++r) {
+            auto first = xs.begin() + begins[r];
+            auto last = xs.begin() + begins[r + 1];
+            size_t i = std::lower_bound(first, last, x0) - xs.begin();
+            const size_t end = begins[r + 1];
+            for (; i < end && xs[i] <= x1; ++i) {
+                if (ys[i] >= y0 && ys[i] <= y1) {
+                    f(order[i], xs[i], ys[i]);
+                }
+            }
+        }
+    }
+
+    template<class F>
+    void sweep(const Shape& shape, Real margin, F&& f) const {
+        sweep(shape.x - shape.hx - margin, shape.y - shape.hy - margin, shape.x + shape.hx + margin, shape.y + shape.hy + margin, f);
+    }
+
+    // 上一次 update 时最快的实体每秒移动的距离上界(|vx| + |vy|)
+    Real maxSpeed() const { return max_speed; }
+    // 上一次 update 中插入排序移动元素的次数
+    size_t swaps() const { return swap_count; }
+
+private:
+    int row(Real y) const { return std::clamp(toIndex((y - min_y) * inv), 0, rows - 1); }
+
+    static int toIndex(float v){ return int(v); }
+    template<class Raw, class Wide, int Frac>
+    static int toIndex(Fixed<Raw, Wide, Frac> v){ return int(v.toInt()); }
+
+    bool before(int sa, Real xa, int sb, Real xb) const {
+        return sa < sb || (sa == sb && xa < xb);
+    }
+
+    void insertionSort(){
+        swap_count = 0;
+        for (size_t i = 1; i < xs.size(); ++i) {
+            if (!before(strips[i], xs[i], strips[i - 1], xs[i - 1])) {
+                continue;
+            }
+            Real kx = xs[i], ky = ys[i];
+            int ks = strips[i];
+            uint32_t ko = order[i];
+            size_t j = i;
+            for (; j > 0 && before(ks, kx, strips[j - 1], xs[j - 1]); --j) {
+                xs[j] = xs[j - 1];
+                ys[j] = ys[j - 1];
+                strips[j] = strips[j - 1];
+                order[j] = order[j - 1];
+                ++swap_count;
+            }
+            xs[j] = kx;
+            ys[j] = ky;
+            strips[j] = ks;
+            order[j] = ko;
+        }
+    }
+
+    void sortAll(){
+        const size_t n = order.size();
+        tmp.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            tmp[i] = Item{ xs[i], ys[i], strips[i], order[i] };
+        }
+        std::sort(tmp.begin(), tmp.end(), [this](const Item& a, const Item& b){ return before(a.strip, a.x, b.strip, b.x); });
+        for (size_t i = 0; i < n; ++i) {
+            xs[i] = tmp[i].x;
+            ys[i] = tmp[i].y;
+            strips[i] = tmp[i].strip;
+            order[i] = tmp[i].slot;
+        }
+        swap_count = n;
+    }
+
+private:
+    struct Item{
+        Real x, y;
+        int strip;
+        uint32_t slot;
+    };
+    Real min_y;
+    Real inv;
+    int rows;
+    // 四个数组同序, 按 (strip, x) 升序
+    std::vector<uint32_t> order;
+    std::vector<Real> xs;
+    std::vector<Real> ys;
+    std::vector<int> strips;
+    std::vector<uint32_t> begins; // 每一带在数组中的起始位置, 共 rows + 1 项
+    std::vector<Item> tmp;
+    Real max_speed = Real(0);
+    size_t swap_count = 0;
+}; // class Broadphase
+
+} // namespace world
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+// World 中的组件, 和 io::Entity 的字段一一对应
+namespace world{
+
+struct Hp{ int32_t value; };
+struct Status{ uint32_t flags; }; // 位定义见 flat::Status
+// 位置和速度存放在 World 的 SoA 数组(Kinematics)中, 实体只持有下标
+// Position/Velocity 作为读写接口的值类型
+struct Position{ float x, y; };
+struct Velocity{ float vx, vy; };
+struct Body{ uint32_t slot; };
+
+// 玩家控制的实体
+struct Player{ uint32_t player_id; };
+// 玩家最近一次的输入, 没有新输入时保持
+struct Intent{
+    int8_t move_x;
+    int8_t move_y;
+    uint8_t buttons; // 位定义见 flat::Button
+    uint32_t view_tick; // 发出输入时客户端看到的快照tick, 命中判定回到这个tick
+};
+// 冷却中的动作, flat::Status 的动作位, 冷却结束时由定时器清掉
+struct Cooldown{ uint32_t mask; };
+
+} // namespace world
@@ -0,0 +1,325 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+// 确定性的定点数
+// 只用整数运算, 同样的输入在任何机器, 任何编译选项下都得到逐位相同的结果, 帧同步, 回滚和回放依赖这一点.
+// 浮点数只在边界上转换(配置, 量化发送), 不参与模拟过程中的计算.
+// 有符号数右移在 C++20 之前是实现定义的, 这里假定是算术右移, 主流编译器都是如此.
+namespace world{
+
+namespace detail{
+
+template<class T> struct Unsigned;
+template<> struct Unsigned<int64_t>{ using type = uint64_t; };
+template<> struct Unsigned<__int128>{ using type = unsigned __int128; };
+
+// 整数平方根, 逐位试商, 向下取整, 用于编译期生成表
+template<class U>
+constexpr U isqrt(U n){
+    U res = 0;
+    U bit = U(1) << (sizeof(U) * 8 - 2);
+    while (bit > n) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (n >= res + bit) {
+            n -= res + bit;
+            res = (res >> 1) + bit;
+        }else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return res;
+}
+
+constexpr int64_t PI_Q60 = 3622009729038561421ll;
+constexpr int64_t PI_Q32 = 13493037705ll;
+// 2^64 / 2pi, 把 Q32 的弧度换成一周为 2^32 的二进制角度
+constexpr int64_t TURN_PER_RAD_Q32 = 2935890503282001226ll;
+
+// 四分之一周期的正弦表, 1024 段, Q32
+// 在编译期用 Q60 的整数泰勒展开生成, 不依赖浮点库
+constexpr int SIN_BITS = 10;
+constexpr int SIN_SIZE = 1 << SIN_BITS;
+constexpr int SIN_SHIFT = 30 - SIN_BITS;
+
+struct SinTable{
+    int64_t v[SIN_SIZE + 1];
+};
+
+// x 在 [0, pi/2] 内, Q60
+constexpr int64_t sinQ60(int64_t x){
+    __int128 x2 = (__int128(x) * x) >> 60;
+    __int128 term = x, sum = x;
+    for (int k = 1; k < 16; ++k) {
+        term = -((term * x2) >> 60) / ((2 * k) * (2 * k + 1));
+        sum += term;
+    }
+    return int64_t(sum);
+}
+
+constexpr SinTable makeSinTable(){
+    SinTable t{};
+    for (int i = 0; i <= SIN_SIZE; ++i) {
+        int64_t x = int64_t((__int128(PI_Q60 / 2) * i) >> SIN_BITS);
+        t.v[i] = (sinQ60(x) + (int64_t(1) << 27)) >> 28;
+    }
+    return t;
+}
+
+constexpr SinTable SIN_TABLE = makeSinTable();
+
+// pos 在 [0, 2^30] 内, 对应 [0, pi/2], 表项之间线性插值
+constexpr int64_t sinQuarter(uint32_t pos){
+    uint32_t i = pos >> SIN_SHIFT;
+    if (i >= SIN_SIZE) {
+        return SIN_TABLE.v[SIN_SIZE];
+    }
+    int64_t frac = pos & ((1u << SIN_SHIFT) - 1);
+    int64_t a = SIN_TABLE.v[i], b = SIN_TABLE.v[i + 1];
+    return a + (((b - a) * frac) >> SIN_SHIFT);
+}
+
+// 一周为 2^32 的二进制角度的正弦, Q32
+constexpr int64_t sinTurn(uint32_t turn){
+    const uint32_t quarter = 1u << 30;
+    uint32_t pos = turn & (quarter - 1);
+    switch (turn >> 30) {
+    case 0: return sinQuarter(pos);
+    case 1: return sinQuarter(quarter - pos);
+    case 2: return -sinQuarter(pos);
+    default: return -sinQuarter(quarter - pos);
+    }
+}
+
+// [0, 1] 上的反正切表, 1024 段, Q32
+// 编译期生成: 两次半角变换 t / (1 + sqrt(1 + t^2)) 把参数缩小到 0.2 以内, 再用 Q60 的整数级数展开
+constexpr int ATAN_BITS = 10;
+constexpr int ATAN_SIZE = 1 << ATAN_BITS;
+constexpr int ATAN_SHIFT = 32 - ATAN_BITS;
+
+struct AtanTable{
+    int64_t v[ATAN_SIZE + 1];
+};
+
+// t 在 [0, 1] 内, Q60
+constexpr int64_t atanQ60(int64_t t){
+    using u128 = unsigned __int128;
+    const u128 one = u128(1) << 60;
+    u128 x = u128(t);
+    for (int k = 0; k < 2; ++k) {
+        u128 x2 = (x * x) >> 60;
+        u128 s = isqrt((one + x2) << 60);
+        x = (x << 60) / (one + s);
+    }
+    __int128 x2 = __int128((x * x) >> 60);
+    __int128 term = __int128(x), sum = __int128(x);
+    for (int k = 1; k < 16; ++k) {
+        term = -((term * x2) >> 60);
+        sum += term / (2 * k + 1);
+    }
+    return int64_t(sum * 4);
+}
+
+constexpr AtanTable makeAtanTable(){
+    AtanTable t{};
+    for (int i = 0; i <= ATAN_SIZE; ++i) {
+        int64_t x = int64_t(i) << (60 - ATAN_BITS);
+        t.v[i] = (atanQ60(x) + (int64_t(1) << 27)) >> 28;
+    }
+    return t;
+}
+
+constexpr AtanTable ATAN_TABLE = makeAtanTable();
+
+// t 在 [0, 2^32] 内, 对应 [0, 1], 表项之间线性插值
+constexpr int64_t atanUnit(uint64_t t){
+    uint64_t i = t >> ATAN_SHIFT;
+    if (i >= ATAN_SIZE) {
+        return ATAN_TABLE.v[ATAN_SIZE];
+    }
+    int64_t frac = int64_t(t & ((uint64_t(1) << ATAN_SHIFT) - 1));
+    int64_t a = ATAN_TABLE.v[i], b = ATAN_TABLE.v[i + 1];
+    return a + (((b - a) * frac) >> ATAN_SHIFT);
+}
+
+// y, x 是同一个定标的原始值, 返回 [-pi, pi] 内的弧度, Q32
+constexpr int64_t atan2Q32(int64_t y, int64_t x){
+    if (x == 0 && y == 0) {
+        return 0;
+    }
+    uint64_t ax = x < 0 ? 0 - uint64_t(x) : uint64_t(x);
+    uint64_t ay = y < 0 ? 0 - uint64_t(y) : uint64_t(y);
+    // 缩到 31 位以内, 比值用64位除法
+    while ((ax | ay) >> 31) {
+        ax >>= 1;
+        ay >>= 1;
+    }
+    // 按八分之一圆折叠到 [0, 1] 上查表
+    int64_t a = ay <= ax ? atanUnit((ay << 32) / ax) : PI_Q32 / 2 - atanUnit((ax << 32) / ay);
+    if (x < 0) {
+        a = PI_Q32 - a;
+    }
+    return y < 0 ? -a : a;
+}
+
+// 平方根, 向下取整
+// 用硬件浮点开方估计, 再用整数修正到精确值: 结果只取决于输入, 和估计值无关
+template<class U>
+inline U isqrtFast(U n){
+    U r = U(std::sqrt(double(n)));
+    while (r * r > n) {
+        --r;
+    }
+    while ((r + 1) * (r + 1) <= n) {
+        ++r;
+    }
+    return r;
+}
+
+} // namespace detail
+
+// Raw 存储类型, Wide 乘除时的中间类型, Frac 小数位数
+// 加减按补码回绕, 乘法四舍五入, 除法向零截断, 除以0时饱和
+template<class Raw, class Wide, int Frac>
+class Fixed{
+    using URaw = std::make_unsigned_t<Raw>;
+    using UWide = typename detail::Unsigned<Wide>::type;
+
+public:
+    using raw_type = Raw;
+    static constexpr int frac_bits = Frac;
+    static constexpr Raw ONE = Raw(1) << Frac;
+
+    constexpr Fixed() : v(0) {}
+    template<class I, std::enable_if_t<std::is_integral_v<I>, int> = 0>
+    constexpr explicit Fixed(I i) : v(Raw(URaw(Raw(i)) * URaw(ONE))) {}
+    // 只在边界上使用, 同样的浮点数得到同样的结果
+    template<class F, std::enable_if_t<std::is_floating_point_v<F>, int> = 0>
+    constexpr explicit Fixed(F f) : v(Raw(double(f) >= 0 ? double(f) * ONE + 0.5 : double(f) * ONE - 0.5)) {}
+
+    static constexpr Fixed fromRaw(Raw r){
+        Fixed f;
+        f.v = r;
+        return f;
+    }
+    constexpr Raw raw() const { return v; }
+    constexpr float toFloat() const { return float(double(v) / double(ONE)); }
+    constexpr double toDouble() const { return double(v) / double(ONE); }
+    // 向下取整
+    constexpr Raw toInt() const { return v >> Frac; }
+
+    friend constexpr Fixed operator+(Fixed a, Fixed b){ return fromRaw(Raw(URaw(a.v) + URaw(b.v))); }
+    friend constexpr Fixed operator-(Fixed a, Fixed b){ return fromRaw(Raw(URaw(a.v) - URaw(b.v))); }
+    friend constexpr Fixed operator-(Fixed a){ return fromRaw(Raw(URaw(0) - URaw(a.v))); }
+    friend constexpr Fixed operator*(Fixed a, Fixed b){
+        return fromRaw(Raw((Wide(a.v) * b.v + (Wide(1) << (Frac - 1))) >> Frac));
+    }
+    friend constexpr Fixed operator/(Fixed a, Fixed b){
+        if (b.v == 0) {
+            return fromRaw(a.v >= 0 ? std::numeric_limits<Raw>::max() : std::numeric_limits<Raw>::min());
+        }
+        return fromRaw(Raw(Wide(a.v) * ONE / b.v));
+    }
+    constexpr Fixed& operator+=(Fixed o){ return *this = *this + o; }
+    constexpr Fixed& operator-=(Fixed o){ return *this = *this - o; }
+    constexpr Fixed& operator*=(Fixed o){ return *this = *this * o; }
+    constexpr Fixed& operator/=(Fixed o){ return *this = *this / o; }
+
+    friend constexpr bool operator==(Fixed a, Fixed b){ return a.v == b.v; }
+    friend constexpr bool operator!=(Fixed a, Fixed b){ return a.v != b.v; }
+    friend constexpr bool operator<(Fixed a, Fixed b){ return a.v < b.v; }
+    friend constexpr bool operator<=(Fixed a, Fixed b){ return a.v <= b.v; }
+    friend constexpr bool operator>(Fixed a, Fixed b){ return a.v > b.v; }
+    friend constexpr bool operator>=(Fixed a, Fixed b){ return a.v >= b.v; }
+
+    friend constexpr Fixed abs(Fixed a){ return a.v < 0 ? -a : a; }
+    friend constexpr Fixed min(Fixed a, Fixed b){ return b < a ? b : a; }
+    friend constexpr Fixed max(Fixed a, Fixed b){ return a < b ? b : a; }
+
+    friend Fixed sqrt(Fixed a){
+        if (a.v <= 0) {
+            return Fixed();
+        }
+        return fromRaw(Raw(detail::isqrtFast(UWide(a.v) << Frac)));
+    }
+    friend constexpr Fixed sin(Fixed a){ return fromQ32(detail::sinTurn(turn(a))); }
+    friend constexpr Fixed cos(Fixed a){ return fromQ32(detail::sinTurn(turn(a) + (1u << 30))); }
+    friend constexpr Fixed atan2(Fixed y, Fixed x){ return fromQ32(detail::atan2Q32(y.v, x.v)); }
+
+    static constexpr Fixed pi(){ return fromQ32(detail::PI_Q32); }
+
+private:
+    // 弧度 -> 一周为 2^32 的二进制角度, 取模即周期
+    static constexpr uint32_t turn(Fixed a){
+        return uint32_t((__int128(a.v) * detail::TURN_PER_RAD_Q32) >> (32 + Frac));
+    }
+    static constexpr Fixed fromQ32(int64_t q){
+        if constexpr (Frac >= 32) {
+            return fromRaw(Raw(q) * (Raw(1) << (Frac - 32)));
+        }else {
+            return fromRaw(Raw((q + (int64_t(1) << (31 - Frac))) >> (32 - Frac)));
+        }
+    }
+
+private:
+    Raw v;
+}; // class Fixed
+
+// ±32768, 精度 1/65536, 距离的平方等中间结果容易溢出, 需要时换成 Q32
+using Q16 = Fixed<int32_t, int64_t, 16>;
+// ±2^31, 精度 2^-32
+using Q32 = Fixed<int64_t, __int128, 32>;
+
+template<class T>
+struct Vec2{
+    T x, y;
+
+    constexpr Vec2() : x(), y() {}
+    constexpr Vec2(T x, T y) : x(x), y(y) {}
+
+    friend constexpr Vec2 operator+(Vec2 a, Vec2 b){ return Vec2(a.x + b.x, a.y + b.y); }
+    friend constexpr Vec2 operator-(Vec2 a, Vec2 b){ return Vec2(a.x - b.x, a.y - b.y); }
+    friend constexpr Vec2 operator-(Vec2 a){ return Vec2(-a.x, -a.y); }
+    friend constexpr Vec2 operator*(Vec2 a, T k){ return Vec2(a.x * k, a.y * k); }
+    friend constexpr Vec2 operator*(T k, Vec2 a){ return Vec2(a.x * k, a.y * k); }
+    friend constexpr Vec2 operator/(Vec2 a, T k){ return Vec2(a.x / k, a.y / k); }
+    constexpr Vec2& operator+=(Vec2 o){ return *this = *this + o; }
+    constexpr Vec2& operator-=(Vec2 o){ return *this = *this - o; }
+    friend constexpr bool operator==(Vec2 a, Vec2 b){ return a.x == b.x && a.y == b.y; }
+    friend constexpr bool operator!=(Vec2 a, Vec2 b){ return !(a == b); }
+
+    constexpr T dot(Vec2 o) const { return x * o.x + y * o.y; }
+    constexpr T cross(Vec2 o) const { return x * o.y - y * o.x; }
+    constexpr T lengthSq() const { return dot(*this); }
+    T length() const {
+        using std::sqrt;
+        return sqrt(lengthSq());
+    }
+    // 零向量返回零向量
+    Vec2 normalized() const {
+        T len = length();
+        return len == T() ? Vec2() : *this / len;
+    }
+};
+
+using Vec2f = Vec2<float>;
+using Vec2q = Vec2<Q16>;
+
+// 模拟使用的数值类型, 编译时用 WORLD_FIXED_POINT 切换成定点数
+#ifdef WORLD_FIXED_POINT
+using Real = Q16;
+#else
+using Real = float;
+#endif
+
+inline constexpr float toFloat(float v){ return v; }
+template<class Raw, class Wide, int Frac>
+constexpr float toFloat(Fixed<Raw, Wide, Frac> v){ return v.toFloat(); }
+
+} // namespace world
@@ -0,0 +1,301 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+#include <entt/entt.hpp>
+
+// 空间索引
+// 实体移动时增量更新: 只有跨出所在的格子(节点)才会移动索引项, 查询只访问附近的格子,
+// 代价和局部密度相关, 和房间的总实体数无关.
+namespace world{
+
+class SpatialIndex{
+public:
+    virtual ~SpatialIndex() {}
+    virtual void insert(entt::entity e, float x, float y) = 0;
+    virtual void move(entt::entity e, float x, float y) = 0;
+    virtual void remove(entt::entity e) = 0;
+    // 以(x, y)为圆心, r为半径的圆内的实体, 追加到out
+    // out 可以使用帧分配器, 每个tick的查询结果不调用全局分配器
+    virtual void query(float x, float y, float r, std::pmr::vector<entt::entity>& out) const = 0;
+    // 矩形内的实体, 追加到out
+    virtual void queryRect(float min_x, float min_y, float max_x, float max_y, std::pmr::vector<entt::entity>& out) const = 0;
+};
+
+namespace detail{
+
+struct Item{
+    entt::entity e;
+    float x, y;
+};
+
+// 实体在索引中的位置, 用实体的下标(不含版本号)寻址
+struct Loc{
+    int32_t node = -1;
+    uint32_t slot = 0;
+};
+
+inline uint32_t key(entt::entity e){
+    return static_cast<uint32_t>(entt::to_entity(e));
+}
+
+inline bool inRect(const Item& it, float min_x, float min_y, float max_x, float max_y){
+    return it.x >= min_x && it.x <= max_x && it.y >= min_y && it.y <= max_y;
+}
+
+inline bool inCircle(const Item& it, float x, float y, float r2){
+    float dx = it.x - x, dy = it.y - y;
+    return dx * dx + dy * dy <= r2;
+}
+
+} // namespace detail
+
+// 均匀网格, 适合实体分布比较均匀的地图
+class UniformGrid : public SpatialIndex{
+public:
+    // expected 是预计的实体数, 每个格子按平均数的两倍预留, 实体在格子间移动时很少再扩容
+    UniformGrid(float min_x, float min_y, float max_x, float max_y, float cell_size, size_t expected = 0)
+        :min_x(min_x), min_y(min_y)
+        ,inv(1.0f / cell_size)
+    {
+        cols = std::max(1, int(std::ceil((max_x - min_x) * inv)));
+        rows = std::max(1, int(std::ceil((max_y - min_y) * inv)));
+        cells.resize(size_t(cols) * rows);
+        if (expected > 0) {
+            const size_t per_cell = std::max<size_t>(4, expected * 2 / cells.size());
+            for (std::vector<detail::Item>& cell : cells) {
+                cell.reserve(per_cell);
+            }
+            locs.reserve(expected);
+        }
+    }
+
+    void insert(entt::entity e, float x, float y) override {
+        uint32_t k = detail::key(e);
+        if (k >= locs.size()) {
+            locs.resize(k + 1);
+        }
+        add(k, cellOf(x, y), detail::Item{ e, x, y });
+    }
+
+    void move(entt::entity e, float x, float y) override {
+        uint32_t k = detail::key(e);
+        if (k >= locs.size() || locs[k].node < 0) {
+            insert(e, x, y);
+            return;
+        }
+        detail::Loc& loc = locs[k];
+        int c = cellOf(x, y);
+        if (c == loc.node) {
+            detail::Item& it = cells[c][loc.slot];
+            it.x = x;
+            it.y = y;
+            return;
+        }
+        erase(loc);
+        add(k, c, detail::Item{ e, x, y });
+    }
+
+    void remove(entt::entity e) override {
+        uint32_t k = detail::key(e);
+        if (k >= locs.size() || locs[k].node < 0) {
+            return;
+        }
+        erase(locs[k]);
+        locs[k].node = -1;
+    }
+
+    void query(float x, float y, float r, std::pmr::vector<entt::entity>& out) const override {
+        const float r2 = r * r;
+        visit(x - r, y - r, x + r, y + r, [&](const detail::Item& it){
+            if (detail::inCircle(it, x, y, r2)) out.push_back(it.e);
+        });
+    }
+
+    void queryRect(float x0, float y0, float x1, float y1, std::pmr::vector<entt::entity>& out) const override {
+        visit(x0, y0, x1, y1, [&](const detail::Item& it){
+            if (detail::inRect(it, x0, y0, x1, y1)) out.push_back(it.e);
+        });
+    }
+
+    // 遍历和矩形相交的格子中的所有项, 不做精确过滤
+    template<class F>
+    void visit(float x0, float y0, float x1, float y1, F&& f) const {
+        int cx0 = col(x0), cx1 = col(x1), cy0 = row(y0), cy1 = row(y1);
+        for (int cy = cy0; cy <= cy1; ++cy) {
+            for (int cx = cx0; cx <= cx1; ++cx) {
+                for (const detail::Item& it : cells[size_t(cy) * cols + cx]) {
+                    f(it);
+                }
+            }
+        }
+    }
+
+private:
+    int col(float x) const { return std::clamp(int((x - min_x) * inv), 0, cols - 1); }
+    int row(float y) const { return std::clamp(int((y - min_y) * inv), 0, rows - 1); }
+    int cellOf(float x, float y) const { return row(y) * cols + col(x); }
+
+    void add(uint32_t k, int c, const detail::Item& it){
+        locs[k].node = c;
+        locs[k].slot = static_cast<uint32_t>(cells[c].size());
+        cells[c].push_back(it);
+    }
+    // 和格子中最后一项交换后删除
+    void erase(const detail::Loc& loc){
+        std::vector<detail::Item>& cell = cells[loc.node];
+        if (loc.slot + 1 != cell.size()) {
+            cell[loc.slot] = cell.back();
+            locs[detail::key(cell[loc.slot].e)].slot = loc.slot;
+        }
+        cell.pop_back();
+    }
+
+private:
+    float min_x, min_y;
+    float inv;
+    int cols, rows;
+    std::vector<std::vector<detail::Item>> cells;
+    std::vector<detail::Loc> locs;
+};
+
+// 松散四叉树, 适合实体分布很不均匀的地图
+// 节点的项数超过 capacity 时分裂; 实体移动时只要还在所在节点的松散边界(2倍大小)内就不动,
+// 减少在节点边界附近来回移动造成的重新插入.
+class LooseQuadtree : public SpatialIndex{
+public:
+    LooseQuadtree(float min_x, float min_y, float max_x, float max_y, uint32_t capacity = 16, uint32_t max_depth = 8)
+        :capacity(capacity), max_depth(max_depth)
+    {
+        float half = std::max(max_x - min_x, max_y - min_y) * 0.5f;
+        nodes.push_back(Node{ (min_x + max_x) * 0.5f, (min_y + max_y) * 0.5f, half, 0 });
+    }
+
+    void insert(entt::entity e, float x, float y) override {
+        uint32_t k = detail::key(e);
+        if (k >= locs.size()) {
+            locs.resize(k + 1);
+        }
+        place(k, detail::Item{ e, x, y });
+    }
+
+    void move(entt::entity e, float x, float y) override {
+        uint32_t k = detail::key(e);
+        if (k >= locs.size() || locs[k].node < 0) {
+            insert(e, x, y);
+            return;
+        }
+        detail::Loc& loc = locs[k];
+        Node& n = nodes[loc.node];
+        if (std::fabs(x - n.cx) <= n.half * 2 && std::fabs(y - n.cy) <= n.half * 2) {
+            detail::Item& it = n.items[loc.slot];
+            it.x = x;
+            it.y = y;
+            return;
+        }
+        erase(loc);
+        place(k, detail::Item{ e, x, y });
+    }
+
+    void remove(entt::entity e) override {
+        uint32_t k = detail::key(e);
+        if (k >= locs.size() || locs[k].node < 0) {
+            return;
+        }
+        erase(locs[k]);
+        locs[k].node = -1;
+    }
+
+    void query(float x, float y, float r, std::pmr::vector<entt::entity>& out) const override {
+        const float r2 = r * r;
+        visit(0, x - r, y - r, x + r, y + r, [&](const detail::Item& it){
+            if (detail::inCircle(it, x, y, r2)) out.push_back(it.e);
+        });
+    }
+
+    void queryRect(float x0, float y0, float x1, float y1, std::pmr::vector<entt::entity>& out) const override {
+        visit(0, x0, y0, x1, y1, [&](const detail::Item& it){
+            if (detail::inRect(it, x0, y0, x1, y1)) out.push_back(it.e);
+        });
+    }
+
+private:
+    struct Node{
+        float cx, cy, half;
+        uint32_t depth;
+        int32_t child = -1; // 第一个子节点的下标, 四个子节点连续存放
+        std::vector<detail::Item> items;
+    };
+
+    // 从根开始找到包含该点的叶子节点
+    void place(uint32_t k, const detail::Item& it){
+        int32_t i = 0;
+        while (nodes[i].child >= 0) {
+            const Node& n = nodes[i];
+            i = n.child + (it.x >= n.cx ? 1 : 0) + (it.y >= n.cy ? 2 : 0);
+        }
+        Node& n = nodes[i];
+        locs[k].node = i;
+        locs[k].slot = static_cast<uint32_t>(n.items.size());
+        n.items.push_back(it);
+        if (n.items.size() > capacity && n.depth < max_depth) {
+            split(i);
+        }
+    }
+
+    void split(int32_t i){
+        int32_t first = static_cast<int32_t>(nodes.size());
+        float h = nodes[i].half * 0.5f;
+        uint32_t d = nodes[i].depth + 1;
+        float cx = nodes[i].cx, cy = nodes[i].cy;
+        // push_back 可能让引用失效, 这里只用下标
+        nodes.push_back(Node{ cx - h, cy - h, h, d });
+        nodes.push_back(Node{ cx + h, cy - h, h, d });
+        nodes.push_back(Node{ cx - h, cy + h, h, d });
+        nodes.push_back(Node{ cx + h, cy + h, h, d });
+        nodes[i].child = first;
+        std::vector<detail::Item> items;
+        items.swap(nodes[i].items);
+        for (const detail::Item& it : items) {
+            place(detail::key(it.e), it);
+        }
+    }
+
+    void erase(const detail::Loc& loc){
+        std::vector<detail::Item>& items = nodes[loc.node].items;
+        if (loc.slot + 1 != items.size()) {
+            items[loc.slot] = items.back();
+            locs[detail::key(items[loc.slot].e)].slot = loc.slot;
+        }
+        items.pop_back();
+    }
+
+    template<class F>
+    void visit(int32_t i, float x0, float y0, float x1, float y1, F&& f) const {
+        const Node& n = nodes[i];
+        // 用松散边界判断相交
+        float l = n.half * 2;
+        if (x1 < n.cx - l || x0 > n.cx + l || y1 < n.cy - l || y0 > n.cy + l) {
+            return;
+        }
+        for (const detail::Item& it : n.items) {
+            f(it);
+        }
+        if (n.child >= 0) {
+            for (int32_t c = 0; c < 4; ++c) {
+                visit(n.child + c, x0, y0, x1, y1, f);
+            }
+        }
+    }
+
+private:
+    uint32_t capacity;
+    uint32_t max_depth;
+    std::vector<Node> nodes;
+    std::vector<detail::Loc> locs;
+};
+
+} // namespace world
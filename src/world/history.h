@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <entt/entt.hpp>
+#include "components.h"
+#include "kinematics.h"
+
+// 最近 N 个tick的运动学状态, 用于延迟补偿
+// 命中判定回到客户端看到的那个tick, 迟到的输入从它对应的tick开始重新模拟.
+namespace world{
+
+class History{
+public:
+    // 一个tick结束时的状态, 以及这个tick中玩家使用的输入
+    struct Frame{
+        uint32_t tick = 0;
+        Kinematics body;
+        std::vector<entt::entity> actors;
+        std::vector<Intent> intents;
+
+        // 实体在这一帧中的slot, 不存在时返回false
+        // 和当前的布局相同时直接用当前的slot, 否则第一次查找时建立索引
+        bool slotOf(entt::entity e, uint32_t current_slot, uint64_t current_layout, uint32_t& slot) const {
+            if (body.layout() == current_layout) {
+                slot = current_slot;
+                return true;
+            }
+            if (index_layout != body.layout() || index_tick != tick) {
+                buildIndex();
+            }
+            uint32_t k = static_cast<uint32_t>(entt::to_entity(e));
+            if (k >= index.size() || index[k] >= body.size() || body.owner(index[k]) != e) {
+                return false;
+            }
+            slot = index[k];
+            return true;
+        }
+
+    private:
+        void buildIndex() const {
+            const auto& owners = body.ownerList();
+            for (uint32_t i = 0; i < owners.size(); ++i) {
+                uint32_t k = static_cast<uint32_t>(entt::to_entity(owners[i]));
+                if (k >= index.size()) {
+                    index.resize(k + 1, UINT32_MAX);
+                }
+                index[k] = i;
+            }
+            index_layout = body.layout();
+            index_tick = tick;
+        }
+
+        mutable std::vector<uint32_t> index;
+        mutable uint64_t index_layout = UINT64_MAX;
+        mutable uint32_t index_tick = 0;
+    };
+
+    explicit History(size_t ticks = 32)
+        :frames(ticks)
+    {}
+
+    // 容量为0时不保存
+    bool enabled() const { return !frames.empty(); }
+    size_t capacity() const { return frames.size(); }
+
+    // 保存一个tick的状态, 复用帧中已有的容量, 稳定之后不再分配内存
+    // 几乎所有实体每个tick都在移动, 直接拷贝连续的列比按块比较差异更便宜
+    Frame& save(uint32_t tick, const Kinematics& body){
+        Frame& f = frames[tick % frames.size()];
+        f.tick = tick;
+        f.body = body;
+        f.actors.clear();
+        f.intents.clear();
+        newest = tick;
+        return f;
+    }
+
+    // tick 已经被覆盖或者还没有保存时返回nullptr
+    const Frame* at(uint32_t tick) const {
+        if (!enabled() || tick == 0) {
+            return nullptr;
+        }
+        const Frame& f = frames[tick % frames.size()];
+        return f.tick == tick ? &f : nullptr;
+    }
+    Frame* at(uint32_t tick) {
+        return const_cast<Frame*>(static_cast<const History*>(this)->at(tick));
+    }
+
+    // 丢弃所有帧, 比如从检查点恢复之后
+    void clear(){
+        for (Frame& f : frames) {
+            f.tick = 0;
+        }
+        newest = 0;
+    }
+
+    uint32_t newestTick() const { return newest; }
+    uint32_t oldestTick() const {
+        return newest >= frames.size() ? newest - static_cast<uint32_t>(frames.size()) + 1 : 1;
+    }
+
+private:
+    std::vector<Frame> frames;
+    uint32_t newest = 0;
+}; // class History
+
+} // namespace world
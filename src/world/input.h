@@ -0,0 +1,159 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace world{
+
+// 玩家进入和离开房间, 在tick开始时先于指令处理
+struct PlayerEvent{
+    enum : uint32_t { Join = 1, Leave = 2 };
+    uint32_t player_id;
+    uint32_t kind;
+    float x, y;        // 进入时的位置
+};
+
+// 一个房间在一个tick内收到的全部输入, 按列存储
+// world 的 input 系统直接顺序遍历这几个数组, 不再逐个玩家去读 flatbuffers 的偏移
+// 同一个玩家在一个tick内发来的多条指令合并成一条: 移动取最后一条, 按键按位或, 确认取最大, 指定的帧取最早的一个.
+// tick 是客户端填的, 不能用它区分指令, 否则给每条指令填不同的帧就能绕过合并. 客户端发得再多,
+// 每个玩家每个tick也只占一条, 最多修改一个历史tick, tick 的开销不会被刷包的客户端放大.
+// 合并用的 player_id 是解码时会话绑定的玩家(conn::Decoder), 客户端填别的 id 也分不出更多条目.
+struct InputBuffer{
+    std::vector<uint32_t> player_id;
+    std::vector<int8_t> move_x;
+    std::vector<int8_t> move_y;
+    std::vector<uint8_t> buttons; // 位定义见 flat::Button
+    std::vector<uint32_t> tick;   // 客户端为这条指令指定的帧, 0 表示没有指定
+    std::vector<uint32_t> ack;    // 客户端最后收到的快照tick, 延迟补偿使用
+    std::vector<PlayerEvent> events; // 按收到的顺序
+
+    size_t size() const { return player_id.size(); }
+
+    void join(uint32_t pid, float x, float y){
+        events.push_back(PlayerEvent{ pid, PlayerEvent::Join, x, y });
+    }
+    void leave(uint32_t pid){
+        events.push_back(PlayerEvent{ pid, PlayerEvent::Leave, 0.0f, 0.0f });
+    }
+
+    // 合并到已有的指令时返回true
+    bool push(uint32_t pid, int8_t mx, int8_t my, uint8_t bt, uint32_t tk = 0, uint32_t ak = 0){
+        if ((size() + 1) * 2 > index.size()) {
+            rehash(std::max<size_t>(64, index.size() * 2));
+        }
+        const size_t mask = index.size() - 1;
+        size_t h = hash(pid) & mask;
+        while (index[h]) {
+            const uint32_t i = index[h] - 1;
+            if (player_id[i] == pid) {
+                move_x[i] = mx;
+                move_y[i] = my;
+                buttons[i] |= bt;
+                ack[i] = std::max(ack[i], ak);
+                if (tk && (tick[i] == 0 || tk < tick[i])) {
+                    tick[i] = tk;
+                }
+                return true;
+            }
+            h = (h + 1) & mask;
+        }
+        index[h] = static_cast<uint32_t>(size() + 1);
+        slots.push_back(static_cast<uint32_t>(h));
+        player_id.push_back(pid);
+        move_x.push_back(mx);
+        move_y.push_back(my);
+        buttons.push_back(bt);
+        tick.push_back(tk);
+        ack.push_back(ak);
+        return false;
+    }
+    void reserve(size_t n){
+        player_id.reserve(n);
+        move_x.reserve(n);
+        move_y.reserve(n);
+        buttons.reserve(n);
+        tick.reserve(n);
+        ack.reserve(n);
+        slots.reserve(n);
+        if (n * 2 > index.size()) {
+            rehash(n * 2);
+        }
+    }
+    // 只清空元素, 保留容量, 稳定之后不再分配内存
+    void clear(){
+        for (uint32_t h : slots) {
+            index[h] = 0;
+        }
+        slots.clear();
+        player_id.clear();
+        move_x.clear();
+        move_y.clear();
+        buttons.clear();
+        tick.clear();
+        ack.clear();
+        events.clear();
+    }
+
+private:
+    static size_t hash(uint32_t pid){
+        return size_t(uint64_t(pid) * 0x9E3779B97F4A7C15ull >> 32);
+    }
+    // 表的大小保持为2的幂, 至少是元素数的两倍
+    void rehash(size_t n){
+        size_t cap = 1;
+        while (cap < n) {
+            cap <<= 1;
+        }
+        index.assign(cap, 0);
+        const size_t mask = cap - 1;
+        for (size_t i = 0; i < size(); ++i) {
+            size_t h = hash(player_id[i]) & mask;
+            while (index[h]) {
+                h = (h + 1) & mask;
+            }
+            index[h] = static_cast<uint32_t>(i + 1);
+            slots[i] = static_cast<uint32_t>(h);
+        }
+    }
+
+    // player_id -> 下标 + 1 的开放寻址表, 0 表示空; slots 是每条指令在表中的位置, 清空时只重置这些位置
+    std::vector<uint32_t> index;
+    std::vector<uint32_t> slots;
+};
+
+// 双缓冲的输入队列
+// 解码线程往后台缓冲区写, world 线程在tick开始时交换前后台, 一个tick只加一次锁
+class InputQueue{
+public:
+    explicit InputQueue(size_t reserve = 256){
+        front.reserve(reserve);
+        back.reserve(reserve);
+    }
+
+    // 解码线程, 一个包加一次锁, 在f中批量写入
+    template<class F>
+    void produce(F&& f){
+        std::lock_guard<std::mutex> lock(mtx);
+        f(back);
+    }
+
+    // world 线程, 取出到目前为止收到的全部输入, 返回的缓冲区在下一次consume之前有效
+    InputBuffer& consume(){
+        std::lock_guard<std::mutex> lock(mtx);
+        front.clear();
+        std::swap(front, back);
+        return front;
+    }
+
+private:
+    std::mutex mtx;
+    InputBuffer front;
+    InputBuffer back;
+};
+
+} // namespace world
@@ -0,0 +1,141 @@
+#include "kinematics.h"
+
+#ifndef WORLD_FIXED_POINT
+#include <immintrin.h>
+#endif
+
+// 禁止编译器把 a + b * c 合并成乘加融合指令, 否则标量和向量的结果会不一致
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+// 所有实现的运算顺序相同: 先乘, 再加, 再 max(下界), 再 min(上界)
+// 向量实现处理完整的块, 剩下的尾部交给标量实现
+namespace world{
+namespace kernel{
+
+namespace {
+
+// 和 max_ps/min_ps 的语义一致: 相等或者有NaN时取第二个操作数
+inline Real clampr(Real v, Real lo, Real hi){
+    v = v > lo ? v : lo;
+    return v < hi ? v : hi;
+}
+
+} // namespace
+
+void integrateScalar(Real* x, Real* y, const Real* vx, const Real* vy, size_t n, Real dt, const Bounds& b){
+    for (size_t i = 0; i < n; ++i) {
+        Real dx = vx[i] * dt;
+        Real dy = vy[i] * dt;
+        x[i] = clampr(x[i] + dx, b.min_x, b.max_x);
+        y[i] = clampr(y[i] + dy, b.min_y, b.max_y);
+    }
+}
+
+void dampScalar(Real* vx, Real* vy, size_t n, Real k){
+    for (size_t i = 0; i < n; ++i) {
+        vx[i] *= k;
+        vy[i] *= k;
+    }
+}
+
+#ifdef WORLD_FIXED_POINT
+
+Kernels scalar(){
+    return Kernels{ "fixed", &integrateScalar, &dampScalar };
+}
+
+Kernels select(bool){
+    return scalar();
+}
+
+#else
+
+void integrateSse2(float* x, float* y, const float* vx, const float* vy, size_t n, float dt, const Bounds& b){
+    const __m128 vdt = _mm_set1_ps(dt);
+    const __m128 lox = _mm_set1_ps(b.min_x), hix = _mm_set1_ps(b.max_x);
+    const __m128 loy = _mm_set1_ps(b.min_y), hiy = _mm_set1_ps(b.max_y);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 px = _mm_add_ps(_mm_loadu_ps(x + i), _mm_mul_ps(_mm_loadu_ps(vx + i), vdt));
+        __m128 py = _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(_mm_loadu_ps(vy + i), vdt));
+        _mm_storeu_ps(x + i, _mm_min_ps(_mm_max_ps(px, lox), hix));
+        _mm_storeu_ps(y + i, _mm_min_ps(_mm_max_ps(py, loy), hiy));
+    }
+    integrateScalar(x + i, y + i, vx + i, vy + i, n - i, dt, b);
+}
+
+void dampSse2(float* vx, float* vy, size_t n, float k){
+    const __m128 vk = _mm_set1_ps(k);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(vx + i, _mm_mul_ps(_mm_loadu_ps(vx + i), vk));
+        _mm_storeu_ps(vy + i, _mm_mul_ps(_mm_loadu_ps(vy + i), vk));
+    }
+    dampScalar(vx + i, vy + i, n - i, k);
+}
+
+__attribute__((target("avx2")))
+void integrateAvx2(float* x, float* y, const float* vx, const float* vy, size_t n, float dt, const Bounds& b){
+    const __m256 vdt = _mm256_set1_ps(dt);
+    const __m256 lox = _mm256_set1_ps(b.min_x), hix = _mm256_set1_ps(b.max_x);
+    const __m256 loy = _mm256_set1_ps(b.min_y), hiy = _mm256_set1_ps(b.max_y);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 px = _mm256_add_ps(_mm256_loadu_ps(x + i), _mm256_mul_ps(_mm256_loadu_ps(vx + i), vdt));
+        __m256 py = _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_mul_ps(_mm256_loadu_ps(vy + i), vdt));
+        _mm256_storeu_ps(x + i, _mm256_min_ps(_mm256_max_ps(px, lox), hix));
+        _mm256_storeu_ps(y + i, _mm256_min_ps(_mm256_max_ps(py, loy), hiy));
+    }
+    integrateScalar(x + i, y + i, vx + i, vy + i, n - i, dt, b);
+}
+
+__attribute__((target("avx2,fma")))
+void integrateFma(float* x, float* y, const float* vx, const float* vy, size_t n, float dt, const Bounds& b){
+    const __m256 vdt = _mm256_set1_ps(dt);
+    const __m256 lox = _mm256_set1_ps(b.min_x), hix = _mm256_set1_ps(b.max_x);
+    const __m256 loy = _mm256_set1_ps(b.min_y), hiy = _mm256_set1_ps(b.max_y);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 px = _mm256_fmadd_ps(_mm256_loadu_ps(vx + i), vdt, _mm256_loadu_ps(x + i));
+        __m256 py = _mm256_fmadd_ps(_mm256_loadu_ps(vy + i), vdt, _mm256_loadu_ps(y + i));
+        _mm256_storeu_ps(x + i, _mm256_min_ps(_mm256_max_ps(px, lox), hix));
+        _mm256_storeu_ps(y + i, _mm256_min_ps(_mm256_max_ps(py, loy), hiy));
+    }
+    integrateScalar(x + i, y + i, vx + i, vy + i, n - i, dt, b);
+}
+
+__attribute__((target("avx2")))
+void dampAvx2(float* vx, float* vy, size_t n, float k){
+    const __m256 vk = _mm256_set1_ps(k);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(vx + i, _mm256_mul_ps(_mm256_loadu_ps(vx + i), vk));
+        _mm256_storeu_ps(vy + i, _mm256_mul_ps(_mm256_loadu_ps(vy + i), vk));
+    }
+    dampScalar(vx + i, vy + i, n - i, k);
+}
+
+Kernels scalar(){
+    return Kernels{ "scalar", &integrateScalar, &dampScalar };
+}
+
+Kernels select(bool deterministic){
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        if (!deterministic && __builtin_cpu_supports("fma")) {
+            return Kernels{ "avx2+fma", &integrateFma, &dampAvx2 };
+        }
+        return Kernels{ "avx2", &integrateAvx2, &dampAvx2 };
+    }
+    // x86-64 都支持 sse2
+    return Kernels{ "sse2", &integrateSse2, &dampSse2 };
+}
+
+#endif // WORLD_FIXED_POINT
+
+} // namespace kernel
+} // namespace world
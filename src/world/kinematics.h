@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <entt/entt.hpp>
+#include "fixed.h"
+
+// 运动学数据 (x, y, vx, vy) 的 SoA 存储和向量化的积分内核
+namespace world{
+
+// 按 Align 字节对齐的分配器, 让每一列都可以用对齐的向量读写
+template<class T, size_t Align = 32>
+struct AlignedAllocator{
+    using value_type = T;
+    template<class U> struct rebind{ using other = AlignedAllocator<U, Align>; };
+
+    AlignedAllocator() = default;
+    template<class U> AlignedAllocator(const AlignedAllocator<U, Align>&) {}
+
+    T* allocate(size_t n){
+        size_t bytes = (n * sizeof(T) + Align - 1) / Align * Align;
+        void* p = std::aligned_alloc(Align, bytes ? bytes : Align);
+        if (p == nullptr) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(p);
+    }
+    void deallocate(T* p, size_t){
+        std::free(p);
+    }
+    template<class U> bool operator==(const AlignedAllocator<U, Align>&) const { return true; }
+    template<class U> bool operator!=(const AlignedAllocator<U, Align>&) const { return false; }
+};
+
+using FloatArray = std::vector<float, AlignedAllocator<float>>;
+using RealArray = std::vector<Real, AlignedAllocator<Real>>;
+
+// 实体的运动学数据, 每一列连续存放, 下标即 slot
+// 删除时和最后一个交换, 所以slot会变化, 由 World 通过 Body 组件维护
+class Kinematics{
+public:
+    void reserve(size_t n){
+        px.reserve(n);
+        py.reserve(n);
+        pvx.reserve(n);
+        pvy.reserve(n);
+        owners.reserve(n);
+    }
+
+    uint32_t add(entt::entity e, Real x, Real y, Real vx, Real vy){
+        px.push_back(x);
+        py.push_back(y);
+        pvx.push_back(vx);
+        pvy.push_back(vy);
+        owners.push_back(e);
+        ++layout_version;
+        return static_cast<uint32_t>(owners.size() - 1);
+    }
+
+    // 删除slot, 返回被换到slot上的实体, 删除的就是最后一个时返回null
+    entt::entity remove(uint32_t slot){
+        size_t last = owners.size() - 1;
+        entt::entity moved = entt::null;
+        if (slot != last) {
+            px[slot] = px[last];
+            py[slot] = py[last];
+            pvx[slot] = pvx[last];
+            pvy[slot] = pvy[last];
+            owners[slot] = owners[last];
+            moved = owners[slot];
+        }
+        px.pop_back();
+        py.pop_back();
+        pvx.pop_back();
+        pvy.pop_back();
+        owners.pop_back();
+        ++layout_version;
+        return moved;
+    }
+
+    void clear(){
+        px.clear();
+        py.clear();
+        pvx.clear();
+        pvy.clear();
+        owners.clear();
+        ++layout_version;
+    }
+
+    size_t size() const { return owners.size(); }
+    Real* x() { return px.data(); }
+    Real* y() { return py.data(); }
+    Real* vx() { return pvx.data(); }
+    Real* vy() { return pvy.data(); }
+    const Real* x() const { return px.data(); }
+    const Real* y() const { return py.data(); }
+    const Real* vx() const { return pvx.data(); }
+    const Real* vy() const { return pvy.data(); }
+    entt::entity owner(uint32_t slot) const { return owners[slot]; }
+    const std::vector<entt::entity>& ownerList() const { return owners; }
+    // 每次增删都会改变, 版本相同的两份数据中同一个实体的slot相同
+    uint64_t layout() const { return layout_version; }
+
+private:
+    RealArray px, py, pvx, pvy;
+    std::vector<entt::entity> owners;
+    uint64_t layout_version = 0;
+};
+
+namespace kernel{
+
+struct Bounds{
+    Real min_x, min_y, max_x, max_y;
+};
+
+// x += vx * dt, y += vy * dt, 再限制在边界内
+using Integrate = void(*)(Real* x, Real* y, const Real* vx, const Real* vy, size_t n, Real dt, const Bounds& b);
+// vx *= k, vy *= k
+using Damp = void(*)(Real* vx, Real* vy, size_t n, Real k);
+
+// 定点数模式下只有标量实现, 整数运算本身就是确定性的
+void integrateScalar(Real* x, Real* y, const Real* vx, const Real* vy, size_t n, Real dt, const Bounds& b);
+void dampScalar(Real* vx, Real* vy, size_t n, Real k);
+
+#ifndef WORLD_FIXED_POINT
+void integrateSse2(float* x, float* y, const float* vx, const float* vy, size_t n, float dt, const Bounds& b);
+void integrateAvx2(float* x, float* y, const float* vx, const float* vy, size_t n, float dt, const Bounds& b);
+// 乘加融合, 结果和其他实现不是逐位相同的, 只在非确定性模式下使用
+void integrateFma(float* x, float* y, const float* vx, const float* vy, size_t n, float dt, const Bounds& b);
+
+void dampSse2(float* vx, float* vy, size_t n, float k);
+void dampAvx2(float* vx, float* vy, size_t n, float k);
+#endif
+
+struct Kernels{
+    const char* name;
+    Integrate integrate;
+    Damp damp;
+};
+
+// 运行时按CPU支持的指令集选择
+// deterministic 为true时不使用FMA, 所有实现和标量版本逐位相同
+Kernels select(bool deterministic);
+Kernels scalar();
+
+} // namespace kernel
+
+} // namespace world
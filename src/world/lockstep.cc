@@ -0,0 +1,134 @@
+#include "lockstep.h"
+#include "builder_pool.h"
+#include "loop.h"
+
+#include <algorithm>
+
+// 帧同步房间的实现
+namespace world{
+
+LockstepRoom::LockstepRoom(const LockstepConfig& c)
+    :cfg(c)
+    ,inputs(c.reserve)
+    ,ring(std::max<uint32_t>(c.window, c.delay + 1))
+{
+    members.reserve(cfg.reserve);
+    frame.reserve(cfg.reserve);
+    for (Slot& s : ring) {
+        s.entries.reserve(cfg.reserve);
+    }
+}
+
+void LockstepRoom::run(){
+    running.store(true, std::memory_order_release);
+    fixedLoop(cfg.tick_rate, cfg.max_catchup, running, lockstep_stats.dropped_ticks, [this](){ tick(); });
+}
+
+void LockstepRoom::stop(){
+    running.store(false, std::memory_order_release);
+}
+
+void LockstepRoom::tick(){
+    const uint32_t now = ++tick_count;
+    collect(now);
+    broadcast(now);
+    ++lockstep_stats.frames;
+}
+
+void LockstepRoom::join(uint32_t player_id){
+    auto it = lower(player_id);
+    if (it != members.end() && it->player_id == player_id) {
+        return;
+    }
+    members.insert(it, Member{ player_id, io::PackedCommand(player_id, cfg.room_id, 0, 0, 0) });
+}
+
+void LockstepRoom::leave(uint32_t player_id){
+    auto it = lower(player_id);
+    if (it != members.end() && it->player_id == player_id) {
+        members.erase(it);
+    }
+}
+
+void LockstepRoom::setSender(const Sender& back){
+    sender = back;
+}
+
+std::vector<LockstepRoom::Member>::iterator LockstepRoom::lower(uint32_t player_id){
+    return std::lower_bound(members.begin(), members.end(), player_id, [](const Member& m, uint32_t id){
+        return m.player_id < id;
+    });
+}
+
+// 先处理玩家进出, 再把本帧收到的指令放到各自的目标帧上
+void LockstepRoom::collect(uint32_t now){
+    InputBuffer& in = inputs.consume();
+    for (const PlayerEvent& ev : in.events) {
+        if (ev.kind == PlayerEvent::Join) {
+            join(ev.player_id);
+        }else if (ev.kind == PlayerEvent::Leave) {
+            leave(ev.player_id);
+        }
+    }
+    const size_t n = in.size();
+    const uint32_t window = static_cast<uint32_t>(ring.size());
+    for (size_t i = 0; i < n; ++i) {
+        auto member = lower(in.player_id[i]);
+        if (member == members.end() || member->player_id != in.player_id[i]) {
+            ++lockstep_stats.dropped;
+            continue;
+        }
+        uint32_t target = in.tick[i] ? in.tick[i] : now + cfg.delay;
+        if (target < now) {
+            // 目标帧已经用补齐的输入广播了, 在最早还没广播的一帧执行
+            ++lockstep_stats.late;
+            target = now;
+        }
+        if (target - now >= window) {
+            ++lockstep_stats.dropped;
+            continue;
+        }
+        Slot& s = slot(target);
+        if (s.tick != target) {
+            s.tick = target;
+            s.entries.clear();
+        }
+        s.entries.push_back(Entry{ in.player_id[i],
+            io::PackedCommand(in.player_id[i], cfg.room_id, in.move_x[i], in.move_y[i], in.buttons[i]) });
+    }
+}
+
+// 按 player_id 升序为每个玩家取出本帧的输入, 没有就重复上一次的, 编码后广播给整个房间
+void LockstepRoom::broadcast(uint32_t now){
+    Slot& s = slot(now);
+    const bool valid = s.tick == now;
+    frame.clear();
+    for (Member& m : members) {
+        bool found = false;
+        if (valid) {
+            // 同一帧有多条时以最后到达的为准, 一个房间的玩家很少, 直接线性查找
+            for (auto it = s.entries.rbegin(); it != s.entries.rend(); ++it) {
+                if (it->player_id == m.player_id) {
+                    m.last = it->cmd;
+                    found = true;
+                    break;
+                }
+            }
+        }
+        if (!found) {
+            ++lockstep_stats.filled;
+        }
+        frame.push_back(m.last);
+    }
+    s.tick = 0;
+    s.entries.clear();
+
+    if (!sender || members.empty()) {
+        return;
+    }
+    flatbuffers::FlatBufferBuilder& fbb = flat::localBuilder(1024);
+    fbb.Finish(flat::createCommandFrame(fbb, now, frame.data(), frame.size()));
+    sender(flat::release(fbb, 0, cfg.channel_id));
+}
+
+} // namespace world
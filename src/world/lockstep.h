@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "enet.h"
+#include "input.h"
+#include "pack.h"
+
+namespace world{
+
+struct LockstepConfig{
+    uint32_t room_id = 0;
+    uint32_t tick_rate = 30;
+    uint32_t max_catchup = 5;
+    uint32_t delay = 3;        // 没有指定帧的指令延后执行的帧数
+    uint32_t window = 32;      // 输入环的帧数, 指定的帧超出窗口的指令直接丢弃
+    uint32_t channel_id = 0;
+    size_t reserve = 64;
+};
+
+struct LockstepStats{
+    uint64_t frames = 0;
+    uint64_t late = 0;         // 到达时目标帧已经广播, 放到当前帧执行
+    uint64_t filled = 0;       // 用上一次输入补齐的次数
+    uint64_t dropped = 0;      // 超出窗口或者不在房间中的指令
+    uint64_t dropped_ticks = 0;
+};
+
+// 帧同步房间
+// 服务器不模拟, 只做转发: 把每个玩家每帧的指令收集到输入环中, 迟到或缺失的输入用该玩家上一次的输入补齐,
+// 每帧向房间内所有玩家广播一个 PackedFrame{tick, Commands}, 玩家按 player_id 升序排列, 客户端各自模拟.
+// 玩家的进出和 World 一样通过输入队列中的 PlayerEvent, 在本帧的指令之前处理; 不在房间中的玩家的指令丢弃.
+// 一般作为 RoomManager 中的一个房间由工作线程驱动(见 RoomManager::create), 也可以用 run 独占一个线程.
+// 除了 input() 之外的接口都只能在房间线程中调用
+class LockstepRoom{
+public:
+    // 广播的出口, 数据的 targets 为空, 由出口用 setTargets 填上房间内的会话, 一般再交给 ENetServer::send
+    using Sender = std::function<void(const std::shared_ptr<enet::ENetData>&)>;
+
+    explicit LockstepRoom(const LockstepConfig& cfg = LockstepConfig());
+
+    // 固定步长循环, 阻塞直到stop
+    void run();
+    void stop();
+    // 推进一帧并广播
+    void tick();
+
+    // 和 PlayerEvent 的 Join, Leave 相同, 已经在房间中的玩家再次进入时保留上一次的输入
+    void join(uint32_t player_id);
+    void leave(uint32_t player_id);
+    void setSender(const Sender& back);
+
+    // 交给 conn::Connect::bind 的输入队列
+    InputQueue& input() { return inputs; }
+    const LockstepConfig& config() const { return cfg; }
+    uint32_t currentTick() const { return tick_count; }
+    const LockstepStats& stats() const { return lockstep_stats; }
+    size_t players() const { return members.size(); }
+    // 最近一帧广播的指令, 按 player_id 升序, 在下一帧之前有效
+    const std::vector<io::PackedCommand>& lastFrame() const { return frame; }
+
+private:
+    struct Member{
+        uint32_t player_id;
+        io::PackedCommand last; // 最近一次的输入, 缺帧时重复使用
+    };
+    struct Entry{
+        uint32_t player_id;
+        io::PackedCommand cmd;
+    };
+    // 输入环中的一帧
+    struct Slot{
+        uint32_t tick = 0;
+        std::vector<Entry> entries;
+    };
+
+    std::vector<Member>::iterator lower(uint32_t player_id);
+    void collect(uint32_t now);
+    void broadcast(uint32_t now);
+    Slot& slot(uint32_t tick) { return ring[tick % ring.size()]; }
+
+private:
+    LockstepConfig cfg;
+    InputQueue inputs;
+    std::vector<Member> members; // 按 player_id 升序
+    std::vector<Slot> ring;
+    std::vector<io::PackedCommand> frame;
+    Sender sender;
+    uint32_t tick_count = 0;
+    LockstepStats lockstep_stats;
+    std::atomic<bool> running { false };
+}; // class LockstepRoom
+
+} // namespace world
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+namespace world{
+
+// 固定步长循环, 阻塞直到 running 变为false
+// 落后时一次最多追 max_catchup 个tick, 再多就丢弃积压, 丢弃的tick数累加到dropped
+template<class F>
+void fixedLoop(uint32_t tick_rate, uint32_t max_catchup, const std::atomic<bool>& running, uint64_t& dropped, F&& tick){
+    using clock = std::chrono::steady_clock;
+    const auto step = std::chrono::nanoseconds(1000000000ull / tick_rate);
+    auto prev = clock::now();
+    clock::duration acc{ 0 };
+    while (running.load(std::memory_order_acquire)) {
+        auto now = clock::now();
+        acc += now - prev;
+        prev = now;
+        uint32_t steps = 0;
+        while (acc >= step && steps < max_catchup) {
+            tick();
+            acc -= step;
+            ++steps;
+        }
+        if (acc >= step) {
+            // 追不上了, 丢弃积压, 避免越追越慢
+            dropped += acc / step;
+            acc = clock::duration{ 0 };
+        }
+        std::this_thread::sleep_until(prev + (step - acc));
+    }
+}
+
+} // namespace world
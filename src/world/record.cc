@@ -0,0 +1,222 @@
+#include "record.h"
+#include "world.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "log.h"
+
+// 输入录制和回放的实现
+namespace world{
+
+static size_t align8(size_t n){
+    return (n + 7) & ~size_t(7);
+}
+
+static size_t recordSize(size_t commands, size_t events){
+    return align8(sizeof(TickRecord) + events * sizeof(PlayerEvent) + commands * (3 * sizeof(uint32_t) + 3));
+}
+
+bool InputRecorder::open(const std::string& path, uint32_t tick_rate, uint32_t first_tick){
+    close();
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        errorlog << "failed to open record file " << path;
+        return false;
+    }
+    file = path;
+    if (!reserve(sizeof(RecordHeader))) {
+        close();
+        return false;
+    }
+    RecordHeader h;
+    h.real_size = sizeof(Real);
+    h.tick_rate = tick_rate;
+    h.first_tick = first_tick;
+    std::memcpy(base, &h, sizeof(h));
+    used = sizeof(h);
+    return true;
+}
+
+bool InputRecorder::append(uint32_t tick, const InputBuffer& in, uint64_t hash){
+    if (fd < 0) {
+        return false;
+    }
+    const size_t n = in.size();
+    const size_t m = in.events.size();
+    const size_t size = recordSize(n, m);
+    if (!reserve(size)) {
+        return false;
+    }
+    uint8_t* p = base + used;
+    TickRecord r{ tick, uint32_t(n), uint32_t(m), uint32_t(size), hash };
+    std::memcpy(p, &r, sizeof(r));
+    p += sizeof(r);
+    auto put = [&p](const void* src, size_t len){
+        if (len) {
+            std::memcpy(p, src, len);
+            p += len;
+        }
+    };
+    put(in.events.data(), m * sizeof(PlayerEvent));
+    put(in.player_id.data(), n * sizeof(uint32_t));
+    put(in.tick.data(), n * sizeof(uint32_t));
+    put(in.ack.data(), n * sizeof(uint32_t));
+    put(in.move_x.data(), n);
+    put(in.move_y.data(), n);
+    put(in.buttons.data(), n);
+    used += size;
+    ++count;
+    return true;
+}
+
+// 文件按 CHUNK 的整数倍扩大, 至少翻倍, 重新映射的次数是对数级的
+bool InputRecorder::reserve(size_t n){
+    if (used + n <= capacity) {
+        return true;
+    }
+    size_t cap = std::max(capacity * 2, (used + n + CHUNK - 1) / CHUNK * CHUNK);
+    if (::ftruncate(fd, off_t(cap)) != 0) {
+        errorlog << "failed to extend record file " << file << " to " << cap << " bytes";
+        return false;
+    }
+    void* p = ::mmap(nullptr, cap, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        errorlog << "failed to map record file " << file;
+        return false;
+    }
+    if (base) {
+        ::munmap(base, capacity);
+    }
+    base = static_cast<uint8_t*>(p);
+    capacity = cap;
+    return true;
+}
+
+void InputRecorder::close(){
+    if (base) {
+        ::munmap(base, capacity);
+        base = nullptr;
+    }
+    if (fd >= 0) {
+        if (::ftruncate(fd, off_t(used)) != 0) {
+            warninglog << "failed to truncate record file " << file;
+        }
+        ::close(fd);
+        fd = -1;
+    }
+    capacity = 0;
+    used = 0;
+    count = 0;
+}
+
+bool InputReplay::open(const std::string& path){
+    close();
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        errorlog << "failed to open record file " << path;
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(RecordHeader)) {
+        errorlog << "record file " << path << " is too short";
+        close();
+        return false;
+    }
+    length = size_t(st.st_size);
+    void* p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+        errorlog << "failed to map record file " << path;
+        length = 0;
+        close();
+        return false;
+    }
+    base = static_cast<const uint8_t*>(p);
+    // 顺序读一遍
+    ::madvise(const_cast<uint8_t*>(base), length, MADV_SEQUENTIAL);
+    const RecordHeader& h = header();
+    if (h.magic != RecordHeader::MAGIC || h.version != RecordHeader::VERSION || h.real_size != sizeof(Real)) {
+        errorlog << "record file " << path << " has an unsupported format";
+        close();
+        return false;
+    }
+    return true;
+}
+
+void InputReplay::close(){
+    if (base) {
+        ::munmap(const_cast<uint8_t*>(base), length);
+        base = nullptr;
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    length = 0;
+}
+
+bool InputReplay::run(World& w, ReplayStats& out, uint64_t max_ticks) const {
+    out = ReplayStats();
+    if (base == nullptr) {
+        return false;
+    }
+    if (w.currentTick() + 1 != header().first_tick) {
+        errorlog << "replay starts at tick " << header().first_tick << ", world is at tick " << w.currentTick();
+        return false;
+    }
+    using clock = std::chrono::steady_clock;
+    auto begin = clock::now();
+    size_t pos = sizeof(RecordHeader);
+    bool ok = true;
+    while (pos + sizeof(TickRecord) <= length && (max_ticks == 0 || out.ticks < max_ticks)) {
+        TickRecord r;
+        std::memcpy(&r, base + pos, sizeof(r));
+        if (r.tick == 0) {
+            break;
+        }
+        if (r.bytes != recordSize(r.commands, r.events) || pos + r.bytes > length || r.tick != w.currentTick() + 1) {
+            errorlog << "corrupted record at offset " << pos;
+            ok = false;
+            break;
+        }
+        const uint8_t* p = base + pos + sizeof(r);
+        const uint8_t* ids = p + r.events * sizeof(PlayerEvent);
+        const uint8_t* ticks = ids + r.commands * sizeof(uint32_t);
+        const uint8_t* acks = ticks + r.commands * sizeof(uint32_t);
+        const uint8_t* mx = acks + r.commands * sizeof(uint32_t);
+        const uint8_t* my = mx + r.commands;
+        const uint8_t* bt = my + r.commands;
+        w.input().produce([&](InputBuffer& in){
+            for (uint32_t i = 0; i < r.events; ++i) {
+                PlayerEvent e;
+                std::memcpy(&e, p + i * sizeof(PlayerEvent), sizeof(e));
+                in.events.push_back(e);
+            }
+            for (uint32_t i = 0; i < r.commands; ++i) {
+                uint32_t pid, tk, ak;
+                std::memcpy(&pid, ids + i * sizeof(uint32_t), sizeof(pid));
+                std::memcpy(&tk, ticks + i * sizeof(uint32_t), sizeof(tk));
+                std::memcpy(&ak, acks + i * sizeof(uint32_t), sizeof(ak));
+                in.push(pid, int8_t(mx[i]), int8_t(my[i]), bt[i], tk, ak);
+            }
+        });
+        w.tick();
+        ++out.ticks;
+        out.commands += r.commands;
+        out.events += r.events;
+        if (w.stateHash() != r.hash) {
+            out.mismatch = r.tick;
+            ok = false;
+            break;
+        }
+        pos += r.bytes;
+    }
+    out.seconds = std::chrono::duration<double>(clock::now() - begin).count();
+    return ok;
+}
+
+} // namespace world
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "input.h"
+
+// 输入的录制和回放
+// World 每个tick处理的输入(合并之后的指令和玩家进出事件)连同tick结束时的状态哈希, 追加写到内存映射的文件中.
+// 回放时从同样的初始状态开始(同样的 Config 和房间初始化), 把每个tick的输入原样交给 World, 不等待时间, 尽快推进,
+// 每个tick比较状态哈希. 线上出现的卡顿可以离线重现和测量, 修改逻辑之后哈希不同说明结果变了.
+//
+// 文件格式, 本机字节序:
+//   RecordHeader
+//   每个tick一条记录: TickRecord, PlayerEvent 数组, 指令的各列(player_id, tick, ack 各4字节, move_x, move_y,
+//   buttons 各1字节), 补齐到8字节
+// 文件按块扩大, 扩出来的部分是0; 进程崩溃时已经写入的记录都在, 读到 tick 为0的记录为止.
+namespace world{
+
+class World;
+
+struct RecordHeader{
+    static const uint32_t MAGIC = 0x43455247;   // "GREC"
+    static const uint16_t VERSION = 1;
+    uint32_t magic = MAGIC;
+    uint16_t version = VERSION;
+    uint16_t real_size = 0;    // sizeof(Real), 浮点和定点数的录制不能混用
+    uint32_t tick_rate = 0;
+    uint32_t first_tick = 0;   // 第一条记录的tick
+    uint64_t reserved = 0;
+};
+
+struct TickRecord{
+    uint32_t tick;
+    uint32_t commands;
+    uint32_t events;
+    uint32_t bytes;            // 整条记录的长度, 包括这个头
+    uint64_t hash;             // tick 结束时的 World::stateHash
+};
+
+// 只在 world 线程中使用
+class InputRecorder{
+public:
+    InputRecorder() = default;
+    ~InputRecorder(){ close(); }
+    InputRecorder(const InputRecorder&) = delete;
+    InputRecorder& operator=(const InputRecorder&) = delete;
+
+    // 创建(覆盖)文件, first_tick 是下一个要录制的tick
+    bool open(const std::string& path, uint32_t tick_rate, uint32_t first_tick);
+    bool append(uint32_t tick, const InputBuffer& in, uint64_t hash);
+    // 解除映射, 把文件截断到实际写入的长度
+    void close();
+
+    bool isOpen() const { return fd >= 0; }
+    size_t bytes() const { return used; }
+    uint64_t ticks() const { return count; }
+
+private:
+    // 保证还能写入 n 字节, 不够时扩大文件重新映射
+    bool reserve(size_t n);
+
+private:
+    static const size_t CHUNK = 1 << 20;
+    std::string file;
+    int fd = -1;
+    uint8_t* base = nullptr;
+    size_t capacity = 0;
+    size_t used = 0;
+    uint64_t count = 0;
+};
+
+struct ReplayStats{
+    uint64_t ticks = 0;
+    uint64_t commands = 0;
+    uint64_t events = 0;
+    uint32_t mismatch = 0;     // 第一个状态哈希不同的tick, 0 表示全部相同
+    double seconds = 0;        // 回放的耗时
+};
+
+// 只读映射录制文件
+class InputReplay{
+public:
+    InputReplay() = default;
+    ~InputReplay(){ close(); }
+    InputReplay(const InputReplay&) = delete;
+    InputReplay& operator=(const InputReplay&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    // 把录制的输入逐tick交给 w 并推进, w 的下一个tick要等于录制的第一个tick
+    // 遇到哈希不同的tick时停止并返回false; max_ticks 为 0 时回放到文件结束
+    bool run(World& w, ReplayStats& out, uint64_t max_ticks = 0) const;
+
+    const RecordHeader& header() const { return *reinterpret_cast<const RecordHeader*>(base); }
+
+private:
+    int fd = -1;
+    const uint8_t* base = nullptr;
+    size_t length = 0;
+};
+
+} // namespace world
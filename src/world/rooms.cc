@@ -0,0 +1,262 @@
+#include "rooms.h"
+
+#include <algorithm>
+#include <string>
+#include "affinity.h"
+#include "log.h"
+
+// 房间管理的实现
+namespace world{
+
+RoomManager::RoomManager(const RoomManagerConfig& c)
+    :cfg(c)
+{
+    room_table.reserve(cfg.reserve);
+    sessions.reserve(cfg.reserve);
+}
+
+RoomManager::~RoomManager(){
+    stop();
+}
+
+void RoomManager::start(){
+    std::lock_guard<std::mutex> lock(mtx);
+    if (running) {
+        return;
+    }
+    running = true;
+    // 启动之前创建的房间从现在开始计时
+    const auto now = std::chrono::steady_clock::now();
+    std::vector<Entry> pending;
+    while (!ready.empty()) {
+        pending.push_back(ready.top());
+        ready.pop();
+    }
+    for (Entry& e : pending) {
+        e.room->deadline = now + e.room->step;
+        e.deadline = e.room->deadline;
+        ready.push(e);
+    }
+    size_t n = cfg.threads ? cfg.threads : std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < n; ++i) {
+        workers.emplace_back(&RoomManager::work, this);
+        affinity::name(workers.back(), "room-" + std::to_string(i));
+        if (!affinity::pin(workers.back(), affinity::pick(cfg.cpus, i))) {
+            warninglog << "failed to pin room worker " << i << " to cpu " << affinity::pick(cfg.cpus, i);
+        }
+    }
+}
+
+void RoomManager::stop(){
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        running = false;
+    }
+    cv.notify_all();
+    for (auto& t : workers) {
+        t.join();
+    }
+    workers.clear();
+}
+
+std::shared_ptr<Room> RoomManager::create(uint32_t room_id, const Config& c, const std::function<void(World&)>& init){
+    if (find(room_id)) {
+        return nullptr;
+    }
+    // 房间的构造和初始化不占用锁
+    std::shared_ptr<Room> room = std::make_shared<Room>(room_id, c);
+    if (init) {
+        init(*room->w);
+    }
+    return add(std::move(room));
+}
+
+std::shared_ptr<Room> RoomManager::create(uint32_t room_id, const LockstepConfig& c, const std::function<void(LockstepRoom&)>& init){
+    if (find(room_id)) {
+        return nullptr;
+    }
+    LockstepConfig lc = c;
+    lc.room_id = room_id;
+    std::shared_ptr<Room> room = std::make_shared<Room>(room_id, lc);
+    if (init) {
+        init(*room->lockstep);
+    }
+    return add(std::move(room));
+}
+
+std::shared_ptr<Room> RoomManager::add(std::shared_ptr<Room> room){
+    {
+        std::unique_lock<std::shared_mutex> lock(route_mtx);
+        if (!room_table.emplace(room->room_id, room).second) {
+            return nullptr;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        room->deadline = std::chrono::steady_clock::now() + room->step;
+        ready.push(Entry{ room->deadline, room });
+    }
+    // 新房间的截止时间可能比等待中的工作线程等的更早
+    cv.notify_one();
+    return room;
+}
+
+bool RoomManager::destroy(uint32_t room_id){
+    std::shared_ptr<Room> room;
+    {
+        std::unique_lock<std::shared_mutex> lock(route_mtx);
+        auto it = room_table.find(room_id);
+        if (it == room_table.end()) {
+            return false;
+        }
+        room = it->second;
+        room_table.erase(it);
+        for (uint32_t sid : room->session_list) {
+            sessions.erase(sid);
+        }
+        room->session_list.clear();
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    room->closed = true;
+    return true;
+}
+
+std::shared_ptr<Room> RoomManager::find(uint32_t room_id) const {
+    std::shared_lock<std::shared_mutex> lock(route_mtx);
+    auto it = room_table.find(room_id);
+    return it == room_table.end() ? nullptr : it->second;
+}
+
+bool RoomManager::attach(uint32_t session_id, uint32_t room_id){
+    std::unique_lock<std::shared_mutex> lock(route_mtx);
+    auto it = room_table.find(room_id);
+    if (it == room_table.end()) {
+        return false;
+    }
+    std::shared_ptr<Room>& cur = sessions[session_id];
+    if (cur == it->second) {
+        return true;
+    }
+    if (cur) {
+        leave(*cur, session_id);
+    }
+    cur = it->second;
+    cur->session_list.push_back(session_id);
+    return true;
+}
+
+void RoomManager::detach(uint32_t session_id){
+    std::unique_lock<std::shared_mutex> lock(route_mtx);
+    auto it = sessions.find(session_id);
+    if (it == sessions.end()) {
+        return;
+    }
+    leave(*it->second, session_id);
+    sessions.erase(it);
+}
+
+void RoomManager::leave(Room& room, uint32_t session_id){
+    std::vector<uint32_t>& list = room.session_list;
+    auto it = std::find(list.begin(), list.end(), session_id);
+    if (it != list.end()) {
+        *it = list.back();
+        list.pop_back();
+    }
+}
+
+std::shared_ptr<Room> RoomManager::route(uint32_t session_id) const {
+    std::shared_lock<std::shared_mutex> lock(route_mtx);
+    auto it = sessions.find(session_id);
+    return it == sessions.end() ? nullptr : it->second;
+}
+
+bool RoomManager::members(uint32_t room_id, std::vector<uint32_t>& out) const {
+    std::shared_lock<std::shared_mutex> lock(route_mtx);
+    auto it = room_table.find(room_id);
+    if (it == room_table.end()) {
+        return false;
+    }
+    out.insert(out.end(), it->second->session_list.begin(), it->second->session_list.end());
+    return true;
+}
+
+bool RoomManager::stats(uint32_t room_id, RoomStats& out) const {
+    std::shared_ptr<Room> room = find(room_id);
+    if (room == nullptr) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    out = room->room_stats;
+    return true;
+}
+
+size_t RoomManager::rooms() const {
+    std::shared_lock<std::shared_mutex> lock(route_mtx);
+    return room_table.size();
+}
+
+void RoomManager::account(Room& room, std::chrono::steady_clock::time_point now){
+    const auto late = std::max(now - room.deadline, std::chrono::steady_clock::duration{ 0 });
+    const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(late).count();
+    RoomStats& s = room.room_stats;
+    s.last_late_ns = ns;
+    s.max_late_ns = std::max(s.max_late_ns, ns);
+    s.avg_late_ns = s.ticks ? s.avg_late_ns * 0.95 + ns * 0.05 : ns;
+    ++s.ticks;
+    if (late >= room.step) {
+        ++s.missed;
+    }
+    // 追不上了, 丢弃积压, 避免越追越慢
+    const uint64_t behind = late / room.step;
+    if (behind >= room.max_catchup) {
+        s.dropped += behind;
+        room.deadline += room.step * behind;
+    }
+    room.deadline += room.step;
+}
+
+// 工作线程: 取出截止时间最早的房间执行
+// 最早的房间还没到期时只有一个线程定时等待它, 其余线程等通知, 避免每个截止时间叫醒所有线程
+void RoomManager::work(){
+    using clock = std::chrono::steady_clock;
+    std::unique_lock<std::mutex> lock(mtx);
+    while (running) {
+        while (!ready.empty() && ready.top().room->closed) {
+            ready.pop();
+        }
+        if (ready.empty()) {
+            cv.wait(lock);
+            continue;
+        }
+        auto now = clock::now();
+        const auto due = ready.top().deadline;
+        if (due > now) {
+            if (due >= timer_due) {
+                cv.wait(lock);
+                continue;
+            }
+            timer_due = due;
+            cv.wait_until(lock, due);
+            if (timer_due == due) {
+                timer_due = clock::time_point::max();
+            }
+            continue;
+        }
+        std::shared_ptr<Room> room = ready.top().room;
+        ready.pop();
+        account(*room, now);
+        // 叫醒一个线程接着计时或者执行下一个到期的房间
+        if (!ready.empty()) {
+            cv.notify_one();
+        }
+        lock.unlock();
+        room->tick();
+        lock.lock();
+        if (!room->closed) {
+            // 自己接着循环, 放回的房间更早时由自己定时等待
+            ready.push(Entry{ room->deadline, room });
+        }
+    }
+}
+
+} // namespace world
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "lockstep.h"
+#include "world.h"
+
+namespace world{
+
+struct RoomManagerConfig{
+    uint32_t threads = 0;      // 工作线程数, 0 时取硬件线程数
+    size_t reserve = 1024;     // 预留的房间数和会话数
+    std::vector<int> cpus;     // 工作线程绑定的CPU, 第 i 个线程绑定到 cpus[i % size], 为空时不绑定
+};
+
+// 一个房间的调度统计, 延迟是tick实际开始的时间相对截止时间(应该开始的时间)
+struct RoomStats{
+    uint64_t ticks = 0;
+    uint64_t missed = 0;       // 开始时已经落后一整个tick以上的次数
+    uint64_t dropped = 0;      // 追不上时丢弃的tick数
+    uint64_t last_late_ns = 0;
+    uint64_t max_late_ns = 0;
+    double avg_late_ns = 0;    // 指数滑动平均
+};
+
+// 一个房间, 由 RoomManager 的工作线程驱动: 状态同步的房间有自己的 World(包含输入队列),
+// 帧同步的房间是一个 LockstepRoom, 只转发指令
+// 同一个房间的tick不会同时在两个线程上执行
+class Room{
+public:
+    Room(uint32_t id, const Config& cfg)
+        :room_id(id)
+        ,w(std::make_unique<World>(cfg))
+        ,max_catchup(cfg.max_catchup)
+        ,step(1000000000ull / cfg.tick_rate)
+    {}
+    Room(uint32_t id, const LockstepConfig& cfg)
+        :room_id(id)
+        ,lockstep(std::make_unique<LockstepRoom>(cfg))
+        ,max_catchup(cfg.max_catchup)
+        ,step(1000000000ull / cfg.tick_rate)
+    {}
+    Room(const Room&) = delete;
+    Room& operator=(const Room&) = delete;
+
+    uint32_t id() const { return room_id; }
+    bool isLockstep() const { return lockstep != nullptr; }
+    // 加入调度之后只能在 addSystem 注册的系统或快照回调中访问; 帧同步的房间没有 World
+    World& world() { return *w; }
+    // 帧同步的房间, 加入调度之后只能在广播的出口中访问
+    LockstepRoom& lockstepRoom() { return *lockstep; }
+    InputQueue& input() { return w ? w->input() : lockstep->input(); }
+
+private:
+    void tick(){
+        if (w) {
+            w->tick();
+        }else {
+            lockstep->tick();
+        }
+    }
+
+private:
+    friend class RoomManager;
+    uint32_t room_id;
+    // 两者只有一个
+    std::unique_ptr<World> w;
+    std::unique_ptr<LockstepRoom> lockstep;
+    uint32_t max_catchup;
+    // 以下由 RoomManager 在调度锁中读写
+    std::chrono::nanoseconds step;
+    std::chrono::steady_clock::time_point deadline;
+    RoomStats room_stats;
+    bool closed = false;
+    // 以下由 RoomManager 在路由锁中读写
+    std::vector<uint32_t> session_list;
+}; // class Room
+
+// 房间管理
+// 大量小房间共用固定数量的工作线程, 不再每个房间一个线程.
+// 所有房间的下一个tick按截止时间放在一个最小堆中, 工作线程总是先执行截止时间最早的(EDF);
+// 会话到房间的路由是一次哈希查找, 解码线程每个包查一次.
+class RoomManager{
+public:
+    explicit RoomManager(const RoomManagerConfig& cfg = RoomManagerConfig());
+    ~RoomManager();
+    RoomManager(const RoomManager&) = delete;
+    RoomManager& operator=(const RoomManager&) = delete;
+
+    // 启动工作线程, 之前创建的房间从现在开始计时
+    void start();
+    // 停止并等待工作线程退出, 正在执行的tick会执行完
+    void stop();
+
+    // 创建房间, init 在加入调度之前调用, 用来生成初始的实体; 第一个tick在一个周期之后
+    // room_id 已经存在时返回nullptr
+    std::shared_ptr<Room> create(uint32_t room_id, const Config& cfg = Config(), const std::function<void(World&)>& init = nullptr);
+    // 创建帧同步的房间, cfg.room_id 换成 room_id; init 在加入调度之前调用, 用来设置广播的出口
+    std::shared_ptr<Room> create(uint32_t room_id, const LockstepConfig& cfg, const std::function<void(LockstepRoom&)>& init = nullptr);
+    // 删除房间和路由到它的会话, 正在执行的tick执行完之后不再调度
+    bool destroy(uint32_t room_id);
+    std::shared_ptr<Room> find(uint32_t room_id) const;
+
+    // 会话进入房间, 之后这个会话的指令只会写入这个房间
+    bool attach(uint32_t session_id, uint32_t room_id);
+    void detach(uint32_t session_id);
+    // 会话所在的房间, 没有时返回nullptr
+    std::shared_ptr<Room> route(uint32_t session_id) const;
+    // 房间中所有会话, 追加到out; 房间不存在时返回false
+    bool members(uint32_t room_id, std::vector<uint32_t>& out) const;
+
+    // 复制一个房间的统计, 房间不存在时返回false
+    bool stats(uint32_t room_id, RoomStats& out) const;
+    size_t rooms() const;
+    size_t threads() const { return workers.size(); }
+
+private:
+    struct Entry{
+        std::chrono::steady_clock::time_point deadline;
+        std::shared_ptr<Room> room;
+        bool operator>(const Entry& o) const { return deadline > o.deadline; }
+    };
+
+    // 把初始化好的房间加入房间表和调度, room_id 已经存在时返回nullptr
+    std::shared_ptr<Room> add(std::shared_ptr<Room> room);
+    void work();
+    // 出堆时记录延迟, 推进截止时间, 在调度锁中调用
+    void account(Room& room, std::chrono::steady_clock::time_point now);
+    // 从房间的会话列表中去掉, 在路由锁中调用
+    void leave(Room& room, uint32_t session_id);
+
+private:
+    RoomManagerConfig cfg;
+    // 房间表和会话路由, 读多写少
+    mutable std::shared_mutex route_mtx;
+    std::unordered_map<uint32_t, std::shared_ptr<Room>> room_table;
+    std::unordered_map<uint32_t, std::shared_ptr<Room>> sessions;
+    // 按截止时间排序的待执行房间, 删除的房间在出堆时丢弃
+    mutable std::mutex mtx;
+    std::condition_variable cv;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> ready;
+    // 正在定时等待的截止时间, 没有线程定时等待时是最大值
+    std::chrono::steady_clock::time_point timer_due = std::chrono::steady_clock::time_point::max();
+    std::vector<std::thread> workers;
+    bool running = false;
+}; // class RoomManager
+
+} // namespace world
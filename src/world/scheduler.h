@@ -0,0 +1,287 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <entt/entt.hpp>
+#include "lfree.h"
+
+// 系统调度
+// 每个系统声明自己读写的组件(或者资源, 比如空间索引, 快照缓冲), 按注册顺序构建依赖图:
+// 后注册的系统和之前的某个系统读写冲突时依赖它, 没有冲突的系统在工作线程上并行执行.
+// 有冲突的系统总是按注册顺序执行, 没有冲突的系统访问的数据不相交, 所以结果和串行执行相同.
+namespace world{
+
+using ComponentId = entt::id_type;
+
+template<class T>
+ComponentId componentId(){
+    return entt::type_hash<T>::value();
+}
+
+// 系统的读写集合
+// 默认是独占的, 和其他所有系统冲突, 创建/销毁实体, 增删组件的系统必须是独占的
+struct Access{
+    std::vector<ComponentId> reads;
+    std::vector<ComponentId> writes;
+    bool exclusive = true;
+
+    template<class... T>
+    Access& read(){
+        (reads.push_back(componentId<T>()), ...);
+        exclusive = false;
+        return *this;
+    }
+    template<class... T>
+    Access& write(){
+        (writes.push_back(componentId<T>()), ...);
+        exclusive = false;
+        return *this;
+    }
+
+    bool conflicts(const Access& o) const {
+        if (exclusive || o.exclusive) {
+            return true;
+        }
+        auto has = [](const std::vector<ComponentId>& ids, ComponentId id){
+            return std::find(ids.begin(), ids.end(), id) != ids.end();
+        };
+        for (ComponentId id : writes) {
+            if (has(o.reads, id) || has(o.writes, id)) {
+                return true;
+            }
+        }
+        for (ComponentId id : reads) {
+            if (has(o.writes, id)) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// 一个系统, 在每个tick中执行
+struct System{
+    std::string name;
+    std::function<void(float dt)> run;
+    Access access;
+};
+
+// 工作线程池
+// 调用线程在等待时也会执行排队的任务, 所以没有工作线程时所有任务都在调用线程上执行
+// parallelFor 的共享状态放在预先分配的槽位中, 提交给工作线程的任务只捕获槽位的指针, 放得进 std::function 的内部缓冲,
+// 稳定状态下切块并行不调用全局分配器.
+class ThreadPool{
+public:
+    explicit ThreadPool(size_t n = 0)
+        :tasks(lfree::queue_size::K1)
+    {
+        for (size_t i = 0; i < n; ++i) {
+            workers.emplace_back([this](){
+                std::function<void()> task;
+                while (tasks.get(task)) {
+                    task();
+                }
+            });
+        }
+    }
+    ~ThreadPool(){
+        tasks.quit();
+        for (auto& t : workers) {
+            t.join();
+        }
+    }
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return workers.size(); }
+    // 第 i 个工作线程, 用来命名和绑定CPU
+    std::thread& worker(size_t i) { return workers[i]; }
+
+    void submit(std::function<void()> task){
+        tasks.put(std::move(task));
+    }
+
+    // 在调用线程执行一个排队的任务, 没有任务时返回false
+    bool runOne(){
+        std::function<void()> task;
+        if (!tasks.try_get(task)) {
+            return false;
+        }
+        task();
+        return true;
+    }
+
+    // 把 [0, n) 按 grain 切块, fn(begin, end) 在调用线程和工作线程上并行执行
+    // 块之间不能有数据依赖, 需要汇总的结果按块写到各自的位置再由调用者合并
+    template<class F>
+    void parallelFor(size_t n, size_t grain, F&& fn){
+        if (n == 0) {
+            return;
+        }
+        grain = std::max<size_t>(grain, 1);
+        const size_t chunks = (n + grain - 1) / grain;
+        Slot* job = chunks == 1 || workers.empty() ? nullptr : acquire();
+        if (job == nullptr) {
+            // 槽位都在使用(同时切块的调用者太多)时也在调用线程上串行执行
+            fn(size_t(0), n);
+            return;
+        }
+        using Fn = std::remove_reference_t<F>;
+        job->fn = const_cast<void*>(static_cast<const void*>(&fn));
+        job->call = [](void* f, size_t begin, size_t end){ (*static_cast<Fn*>(f))(begin, end); };
+        job->chunks = chunks;
+        job->grain = grain;
+        job->n = n;
+        job->next.store(0, std::memory_order_relaxed);
+        job->exited.store(0, std::memory_order_relaxed);
+        const size_t helpers = std::min(workers.size(), chunks - 1);
+        for (size_t i = 0; i < helpers; ++i) {
+            // 帮手只在还有未领取的块时才调用 fn, 此时调用者一定还在等待
+            submit([job](){
+                job->work();
+                job->exited.fetch_add(1, std::memory_order_release);
+            });
+        }
+        job->work();
+        // 等所有帮手都退出之后槽位才能复用; 还在排队的帮手由调用线程自己取出来执行, 它们领不到块, 直接退出
+        while (job->exited.load(std::memory_order_acquire) < helpers) {
+            if (!runOne()) {
+                std::this_thread::yield();
+            }
+        }
+        job->busy.store(false, std::memory_order_release);
+    }
+
+private:
+    // 一次 parallelFor 的共享状态
+    struct Slot{
+        std::atomic<bool> busy{ false };
+        std::atomic<size_t> next{ 0 };
+        std::atomic<size_t> exited{ 0 };  // 已经退出的帮手数
+        size_t chunks = 0;
+        size_t grain = 0;
+        size_t n = 0;
+        void* fn = nullptr;
+        void (*call)(void*, size_t, size_t) = nullptr;
+
+        void work(){
+            size_t c;
+            while ((c = next.fetch_add(1, std::memory_order_relaxed)) < chunks) {
+                const size_t begin = c * grain;
+                call(fn, begin, std::min(begin + grain, n));
+            }
+        }
+    };
+    // 同时切块的调用者(房间的系统, 各个广播线程)最多这么多个
+    static const size_t Slots = 64;
+
+    Slot* acquire(){
+        for (Slot& s : slots) {
+            if (!s.busy.load(std::memory_order_relaxed) && !s.busy.exchange(true, std::memory_order_acquire)) {
+                return &s;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    lfree::ring_queue<std::function<void()>> tasks;
+    std::array<Slot, Slots> slots;
+    std::vector<std::thread> workers;
+}; // class ThreadPool
+
+// 按读写集合构建依赖图, 在线程池上执行一个tick的所有系统
+class Scheduler{
+public:
+    explicit Scheduler(size_t threads = 0)
+        :workers(threads)
+    {}
+
+    // 系统列表变化之后重新构建依赖图
+    void build(const std::vector<System>& systems){
+        const size_t n = systems.size();
+        dependents.assign(n, {});
+        indegree.assign(n, 0);
+        for (size_t j = 0; j < n; ++j) {
+            for (size_t i = 0; i < j; ++i) {
+                if (systems[i].access.conflicts(systems[j].access)) {
+                    dependents[i].push_back(static_cast<uint32_t>(j));
+                    ++indegree[j];
+                }
+            }
+        }
+        pending.reset(new std::atomic<uint32_t>[n]);
+        dirty = false;
+    }
+
+    // 执行所有系统, 返回时全部完成, ns[i] 是第i个系统的耗时
+    void run(const std::vector<System>& systems, float dt, std::vector<uint64_t>& ns){
+        const size_t n = systems.size();
+        if (dirty) {
+            build(systems);
+        }
+        ns.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            pending[i].store(indegree[i], std::memory_order_relaxed);
+        }
+        cur_systems = &systems;
+        cur_dt = dt;
+        cur_ns = &ns;
+        remaining.store(n, std::memory_order_release);
+        for (size_t i = 0; i < n; ++i) {
+            if (indegree[i] == 0) {
+                submit(static_cast<uint32_t>(i));
+            }
+        }
+        while (remaining.load(std::memory_order_acquire) > 0) {
+            if (!workers.runOne()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // 有连续多个独立系统时, 依赖图的宽度就是能同时执行的系统数
+    const std::vector<std::vector<uint32_t>>& graph() const { return dependents; }
+    ThreadPool& pool() { return workers; }
+    void invalidate() { dirty = true; }
+
+private:
+    // 任务只捕获 this 和下标, 放得进 std::function 的内部缓冲, 提交时不分配内存
+    void submit(uint32_t i){
+        workers.submit([this, i](){
+            using clock = std::chrono::steady_clock;
+            auto begin = clock::now();
+            (*cur_systems)[i].run(cur_dt);
+            (*cur_ns)[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - begin).count();
+            for (uint32_t d : dependents[i]) {
+                if (pending[d].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    submit(d);
+                }
+            }
+            remaining.fetch_sub(1, std::memory_order_acq_rel);
+        });
+    }
+
+private:
+    ThreadPool workers;
+    std::vector<std::vector<uint32_t>> dependents;
+    std::vector<uint32_t> indegree;
+    std::unique_ptr<std::atomic<uint32_t>[]> pending;
+    std::atomic<size_t> remaining{ 0 };
+    // 正在执行的一轮, run 返回之前有效
+    const std::vector<System>* cur_systems = nullptr;
+    float cur_dt = 0;
+    std::vector<uint64_t>* cur_ns = nullptr;
+    bool dirty = true;
+}; // class Scheduler
+
+} // namespace world
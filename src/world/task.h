@@ -0,0 +1,237 @@
+#pragma once
+
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "pool.h"
+#include "wheel.h"
+
+// 跨多个tick的逻辑用协程来写
+// 引导技能, AI的巡逻和追击, 延迟生效的效果原来都要在组件里记状态, 每个tick在系统里轮询推进.
+// 写成协程之后状态就是协程里的局部变量:
+//
+//     Task channel(World& w, entt::entity e){
+//         for (int i = 0; i < 6; ++i) {
+//             co_await ticks(5);
+//             if (!w.registry().valid(e)) co_return;
+//             ...
+//         }
+//     }
+//     w.tasks().spawn(channel(w, e));
+//
+// 协程只在所属 World 的线程上, 每个tick开始时(定时器之后, 系统之前)恢复, 恢复不加锁, 也不跨线程.
+// ticks(n) 挂在时间轮上, until(pred) 每个tick开始时检查一次条件, 没有到期的协程不占用每个tick的时间.
+// 协程帧从 pool::BufferPool 分配, 稳定之后启动协程不再调用 malloc.
+namespace world{
+
+class TaskScheduler;
+
+// 由 TaskScheduler 持有并恢复的协程, 没有返回值; 交给 spawn 之前析构时销毁还没有开始的协程
+class Task{
+public:
+    struct promise_type{
+        TaskScheduler* owner = nullptr;
+        promise_type* prev = nullptr;   // 所属调度器中存活的协程链表
+        promise_type* next = nullptr;
+
+        Task get_return_object(){
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        // 创建时挂起, spawn 之后才开始执行; 执行完直接销毁
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void(){}
+        void unhandled_exception(){ std::terminate(); }
+        ~promise_type();
+
+        static void* operator new(size_t size){
+            return pool::BufferPool::instance().allocate(size);
+        }
+        static void operator delete(void* p, size_t size){
+            pool::BufferPool::instance().deallocate(p, size);
+        }
+    };
+    using Handle = std::coroutine_handle<promise_type>;
+
+    Task() = default;
+    Task(Task&& o) noexcept
+        :handle(std::exchange(o.handle, nullptr))
+    {}
+    Task& operator=(Task&& o) noexcept {
+        if (this != &o) {
+            reset();
+            handle = std::exchange(o.handle, nullptr);
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task(){ reset(); }
+
+    explicit operator bool() const { return bool(handle); }
+
+private:
+    friend class TaskScheduler;
+    explicit Task(Handle h)
+        :handle(h)
+    {}
+    Handle release(){ return std::exchange(handle, nullptr); }
+    void reset(){
+        if (handle) {
+            handle.destroy();
+            handle = nullptr;
+        }
+    }
+
+private:
+    Handle handle;
+}; // class Task
+
+// 一个 World 的协程, 只在 World 的线程上使用
+// 在系统中 spawn 的话系统要声明 write<TaskScheduler>()
+class TaskScheduler{
+public:
+    // until 等待的条件, 放在协程帧里, 不单独分配
+    struct Waiter{
+        bool (*test)(Waiter*) = nullptr;
+        std::coroutine_handle<> handle;
+    };
+
+    TaskScheduler() = default;
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+    // 还没有结束的协程直接销毁, 协程中的局部变量照常析构
+    ~TaskScheduler(){
+        while (live) {
+            Task::Handle::from_promise(*live).destroy();
+        }
+    }
+
+    // 立即执行到第一个 co_await, 之后由 resume 推进; 在调用者的线程上执行第一段
+    void spawn(Task task){
+        Task::Handle h = task.release();
+        if (!h) {
+            return;
+        }
+        Task::promise_type& p = h.promise();
+        p.owner = this;
+        p.next = live;
+        if (live) {
+            live->prev = &p;
+        }
+        live = &p;
+        ++count;
+        ++started;
+        h.resume();
+    }
+
+    // World::tick 开始时调用: 先恢复 tick 到期的 ticks(n), 再检查 until 的条件
+    // 本轮中新挂起的协程最早在下一个tick恢复
+    void resume(uint32_t tick){
+        checking.swap(waiters);
+        due.clear();
+        wheel.advance(tick, due);
+        for (size_t i = 0; i < due.size(); ++i) {
+            due[i].resume();
+        }
+        for (Waiter* w : checking) {
+            if (w->test(w)) {
+                w->handle.resume();
+            }else {
+                waiters.push_back(w);
+            }
+        }
+        checking.clear();
+    }
+
+    // 挂起的协程在 resume 的第 n 个tick恢复
+    void sleep(uint32_t n, std::coroutine_handle<> h){
+        wheel.schedule(wheel.now() + n, h);
+    }
+    void wait(Waiter* w){
+        waiters.push_back(w);
+    }
+
+    size_t size() const { return count; }               // 存活的协程数
+    size_t sleeping() const { return wheel.size(); }    // 等待 ticks 的协程数
+    size_t waiting() const { return waiters.size(); }   // 等待 until 的协程数
+    uint64_t spawned() const { return started; }
+
+private:
+    friend struct Task::promise_type;
+    void unlink(Task::promise_type& p){
+        if (p.prev) {
+            p.prev->next = p.next;
+        }else {
+            live = p.next;
+        }
+        if (p.next) {
+            p.next->prev = p.prev;
+        }
+        --count;
+    }
+
+private:
+    timer::Wheel<std::coroutine_handle<>> wheel;
+    std::vector<std::coroutine_handle<>> due;
+    std::vector<Waiter*> waiters;
+    std::vector<Waiter*> checking;
+    Task::promise_type* live = nullptr;
+    size_t count = 0;
+    uint64_t started = 0;
+}; // class TaskScheduler
+
+inline Task::promise_type::~promise_type(){
+    if (owner) {
+        owner->unlink(*this);
+    }
+}
+
+// co_await ticks(n): n 个tick之后恢复, 0 不挂起
+struct TickAwaiter{
+    uint32_t n;
+
+    bool await_ready() const noexcept { return n == 0; }
+    void await_suspend(Task::Handle h) const {
+        assert(h.promise().owner != nullptr);
+        h.promise().owner->sleep(n, h);
+    }
+    void await_resume() const noexcept {}
+};
+
+inline TickAwaiter ticks(uint32_t n){
+    return TickAwaiter{ n };
+}
+inline TickAwaiter nextTick(){
+    return TickAwaiter{ 1 };
+}
+
+// co_await until(pred): pred 为真时不挂起, 否则从下一个tick开始每个tick开始时检查一次, 为真时恢复
+template<class Pred>
+struct UntilAwaiter : TaskScheduler::Waiter{
+    Pred pred;
+
+    explicit UntilAwaiter(Pred p)
+        :pred(std::move(p))
+    {}
+    bool await_ready(){ return pred(); }
+    void await_suspend(Task::Handle h){
+        assert(h.promise().owner != nullptr);
+        handle = h;
+        test = [](TaskScheduler::Waiter* w){ return bool(static_cast<UntilAwaiter*>(w)->pred()); };
+        h.promise().owner->wait(this);
+    }
+    void await_resume() const noexcept {}
+};
+
+template<class Pred>
+UntilAwaiter<std::decay_t<Pred>> until(Pred&& pred){
+    return UntilAwaiter<std::decay_t<Pred>>(std::forward<Pred>(pred));
+}
+
+} // namespace world
@@ -1,4 +1,832 @@
-
 #include "world.h"
+#include "loop.h"
+#include "log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+// 逻辑的实现
+namespace world{
+
+// parallelFor 每块的实体数, 太小时同步的开销比计算还大
+static const size_t parallel_grain = 4096;
+
+World::World(const Config& c)
+    :cfg(c)
+    ,inputs(c.reserve)
+    ,sched(c.threads)
+    ,kernels(kernel::select(c.deterministic))
+    ,frame_arena(c.arena)
+    ,hist(c.history)
+    ,attacks(&frame_arena)
+    ,broad(c.min_y, c.max_y, c.sweep_strip)
+    ,contact_buf(&frame_arena)
+    ,snap(&frame_arena)
+    ,expired_buf(&frame_arena)
+{
+    body.reserve(cfg.reserve);
+    reg.storage<Body>().reserve(cfg.reserve);
+    reg.storage<Hp>().reserve(cfg.reserve);
+    reg.storage<Status>().reserve(cfg.reserve);
+    players.reserve(cfg.reserve);
+
+    // 量化以地图中心为原点
+    quant.origin_x = (cfg.min_x + cfg.max_x) * 0.5f;
+    quant.origin_y = (cfg.min_y + cfg.max_y) * 0.5f;
+
+    if (cfg.quadtree) {
+        index = std::make_unique<LooseQuadtree>(cfg.min_x, cfg.min_y, cfg.max_x, cfg.max_y);
+    }else {
+        index = std::make_unique<UniformGrid>(cfg.min_x, cfg.min_y, cfg.max_x, cfg.max_y, cfg.cell_size, cfg.reserve);
+    }
+
+    // 空间索引, 输入队列和快照缓冲也作为资源参与冲突检测
+    // 迟到的输入会在 input 中重新模拟运动, 所以它也写运动学数据和空间索引
+    pipeline.push_back({ "input", [this](float){ inputSystem(); },
+        Access().read<Status, Body>().write<InputQueue, Intent, Kinematics, SpatialIndex, History>() });
+    pipeline.push_back({ "movement", [this](float dt){ movementSystem(dt); },
+        Access().read<Intent, Status, Body>().write<Kinematics, SpatialIndex>() });
+    pipeline.push_back({ "combat", [this](float){ combatSystem(); },
+        Access().read<Intent, Body, History>().write<Hp, Status, Cooldown, Kinematics, Broadphase, Contact, TimerWheel>() });
+    pipeline.push_back({ "snapshot", [this](float){ snapshotSystem(); },
+        Access().read<Body, Hp, Status, Intent, Kinematics>().write<io::PackedEntity, History>() });
+    tick_stats.system_ns.resize(pipeline.size());
+
+    onTimer(CooldownTimer, [](World& w, const Timer* t, size_t n){
+        for (size_t i = 0; i < n; ++i) {
+            if (Cooldown* cd = w.reg.try_get<Cooldown>(t[i].entity)) {
+                cd->mask &= ~t[i].data;
+            }
+        }
+    });
+}
+
+World::~World(){
+    for (CheckpointImage& img : ckpt_images) {
+        while (img.busy.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void World::run(){
+    running.store(true, std::memory_order_release);
+    fixedLoop(cfg.tick_rate, cfg.max_catchup, running, tick_stats.dropped, [this](){ tick(); });
+}
+
+void World::stop(){
+    running.store(false, std::memory_order_release);
+}
+
+void World::tick(){
+    using clock = std::chrono::steady_clock;
+    ++tick_count;
+    const float step = dt();
+    auto begin = clock::now();
+    beginFrame();
+    takeInput();
+    expireTimers();
+    task_sched.resume(tick_count);
+    sched.run(pipeline, step, tick_stats.system_ns);
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - begin).count();
+    tick_stats.last_ns = ns;
+    tick_stats.max_ns = std::max(tick_stats.max_ns, ns);
+    tick_stats.avg_ns = tick_stats.ticks ? tick_stats.avg_ns * 0.95 + ns * 0.05 : ns;
+    ++tick_stats.ticks;
+    if (rec) {
+        rec->append(tick_count, *frame_input, stateHash());
+    }
+    if (ckpt_interval && tick_count % ckpt_interval == 0) {
+        checkpoint();
+    }
+    if (snapshot_callback) {
+        snapshot_callback(*this);
+    }
+}
+
+// 上一个tick的快照和命中到这里失效
+// 数组先换成空的再回收内存, 按上一个tick的大小预留, 避免增长时在帧分配器中留下废弃的旧缓冲
+void World::beginFrame(){
+    const size_t contacts = contact_buf.size();
+    const size_t pressed = attacks.size();
+    attacks = FrameVector<std::pair<entt::entity, uint8_t>>(&frame_arena);
+    contact_buf = FrameVector<Contact>(&frame_arena);
+    snap = FrameVector<io::PackedEntity>(&frame_arena);
+    expired_buf = FrameVector<Timer>(&frame_arena);
+    frame_arena.reset();
+    attacks.reserve(pressed);
+    contact_buf.reserve(contacts);
+    snap.reserve(body.size());
+}
+
+// 进出房间会增删实体, 在系统调度之外串行处理
+void World::takeInput(){
+    frame_input = &inputs.consume();
+    for (const PlayerEvent& ev : frame_input->events) {
+        if (ev.kind == PlayerEvent::Join) {
+            spawn(ev.player_id, ev.x, ev.y);
+        }else if (ev.kind == PlayerEvent::Leave) {
+            despawn(findPlayer(ev.player_id));
+        }
+    }
+}
+
+entt::entity World::spawn(uint32_t player_id, float x, float y){
+    auto it = players.find(player_id);
+    if (it != players.end()) {
+        return it->second;
+    }
+    entt::entity e = spawnNpc(x, y, 0.0f, 0.0f);
+    reg.emplace<Player>(e, player_id);
+    reg.get<Status>(e).flags |= flat::Player;
+    reg.emplace<Intent>(e, int8_t(0), int8_t(0), uint8_t(0), uint32_t(0));
+    reg.emplace<Cooldown>(e, uint32_t(0));
+    players.emplace(player_id, e);
+    return e;
+}
+
+entt::entity World::spawnNpc(float x, float y, float vx, float vy){
+    entt::entity e = reg.create();
+    reg.emplace<Body>(e, body.add(e, Real(x), Real(y), Real(vx), Real(vy)));
+    reg.emplace<Hp>(e, cfg.spawn_hp);
+    reg.emplace<Status>(e, uint32_t(flat::Alive));
+    index->insert(e, x, y);
+    return e;
+}
+
+void World::despawn(entt::entity e){
+    if (!reg.valid(e)) {
+        return;
+    }
+    if (auto p = reg.try_get<Player>(e)) {
+        players.erase(p->player_id);
+    }
+    index->remove(e);
+    uint32_t slot = reg.get<Body>(e).slot;
+    entt::entity moved = body.remove(slot);
+    if (moved != entt::null) {
+        reg.get<Body>(moved).slot = slot;
+    }
+    reg.destroy(e);
+}
+
+entt::entity World::findPlayer(uint32_t player_id) const {
+    auto it = players.find(player_id);
+    return it == players.end() ? entt::entity(entt::null) : it->second;
+}
+
+Position World::position(entt::entity e) const {
+    uint32_t slot = reg.get<Body>(e).slot;
+    return Position{ toFloat(body.x()[slot]), toFloat(body.y()[slot]) };
+}
+
+Velocity World::velocity(entt::entity e) const {
+    uint32_t slot = reg.get<Body>(e).slot;
+    return Velocity{ toFloat(body.vx()[slot]), toFloat(body.vy()[slot]) };
+}
+
+void World::setVelocity(entt::entity e, float vx, float vy){
+    uint32_t slot = reg.get<Body>(e).slot;
+    body.vx()[slot] = Real(vx);
+    body.vy()[slot] = Real(vy);
+}
+
+bool World::positionAt(entt::entity e, uint32_t tick, Position& out) const {
+    const History::Frame* f = hist.at(tick);
+    const Body* b = reg.valid(e) ? reg.try_get<Body>(e) : nullptr;
+    uint32_t slot = 0;
+    if (f == nullptr || b == nullptr || !f->slotOf(e, b->slot, body.layout(), slot)) {
+        return false;
+    }
+    out = Position{ toFloat(f->body.x()[slot]), toFloat(f->body.y()[slot]) };
+    return true;
+}
+
+bool World::lateInput(uint32_t player_id, uint32_t tick, int8_t move_x, int8_t move_y, uint8_t buttons){
+    entt::entity e = findPlayer(player_id);
+    if (e == entt::null || !patchInput(e, tick, move_x, move_y, buttons)) {
+        return false;
+    }
+    resimulate(tick);
+    return true;
+}
+
+void World::addSystem(const std::string& name, const std::function<void(float)>& fn){
+    addSystem(name, Access(), fn);
+}
+
+void World::addSystem(const std::string& name, const Access& access, const std::function<void(float)>& fn){
+    // snapshot 总是最后一个
+    pipeline.insert(pipeline.end() - 1, System{ name, fn, access });
+    tick_stats.system_ns.resize(pipeline.size());
+    sched.invalidate();
+}
+
+void World::setSnapshotCallback(const std::function<void(const World&)>& back){
+    snapshot_callback = back;
+}
+
+timer::TimerId World::schedule(uint32_t delay, entt::entity e, uint32_t kind, uint32_t data){
+    return timers.schedule(uint64_t(tick_count) + delay, Timer{ e, kind, data });
+}
+
+bool World::cancelTimer(timer::TimerId id){
+    return timers.cancel(id);
+}
+
+void World::onTimer(uint32_t kind, const std::function<void(World&, const Timer*, size_t)>& fn){
+    for (auto& h : timer_handlers) {
+        if (h.first == kind) {
+            h.second = fn;
+            return;
+        }
+    }
+    timer_handlers.emplace_back(kind, fn);
+}
+
+// 同一个tick到期的定时器按类型分段, 每段交给对应的处理函数一次; 没有处理函数的类型只留在 expired 中
+// 段内按实体和数据排序, 顺序是确定的; 不用 stable_sort, 它每次都要申请临时缓冲
+void World::expireTimers(){
+    if (timers.advance(tick_count, expired_buf) == 0) {
+        return;
+    }
+    std::sort(expired_buf.begin(), expired_buf.end(), [](const Timer& a, const Timer& b){
+        if (a.kind != b.kind) {
+            return a.kind < b.kind;
+        }
+        if (a.entity != b.entity) {
+            return entt::to_integral(a.entity) < entt::to_integral(b.entity);
+        }
+        return a.data < b.data;
+    });
+    for (size_t i = 0; i < expired_buf.size();) {
+        size_t j = i;
+        while (j < expired_buf.size() && expired_buf[j].kind == expired_buf[i].kind) {
+            ++j;
+        }
+        for (auto& h : timer_handlers) {
+            if (h.first == expired_buf[i].kind) {
+                h.second(*this, expired_buf.data() + i, j - i);
+                break;
+            }
+        }
+        i = j;
+    }
+}
+
+bool World::record(const std::string& path){
+    auto r = std::make_unique<InputRecorder>();
+    if (!r->open(path, cfg.tick_rate, tick_count + 1)) {
+        return false;
+    }
+    rec = std::move(r);
+    return true;
+}
+
+void World::stopRecording(){
+    rec.reset();
+}
+
+// 按 slot 的顺序, 相同的输入序列在相同的初始状态上得到相同的 slot 排列
+uint64_t World::stateHash() const {
+    uint64_t h = 0xcbf29ce484222325ull ^ tick_count;
+    auto mix = [&h](const void* p, size_t len){
+        const uint8_t* b = static_cast<const uint8_t*>(p);
+        for (; len >= 8; len -= 8, b += 8) {
+            uint64_t v;
+            std::memcpy(&v, b, 8);
+            h = (h ^ v) * 0x100000001b3ull;
+            h ^= h >> 29;
+        }
+        for (; len > 0; --len, ++b) {
+            h = (h ^ *b) * 0x100000001b3ull;
+        }
+    };
+    const size_t n = body.size();
+    mix(body.x(), n * sizeof(Real));
+    mix(body.y(), n * sizeof(Real));
+    mix(body.vx(), n * sizeof(Real));
+    mix(body.vy(), n * sizeof(Real));
+    mix(body.ownerList().data(), n * sizeof(entt::entity));
+    for (size_t i = 0; i < n; ++i) {
+        const entt::entity e = body.owner(uint32_t(i));
+        const Cooldown* cd = reg.try_get<Cooldown>(e);
+        const uint64_t v = uint64_t(uint32_t(reg.get<Hp>(e).value)) << 32 | reg.get<Status>(e).flags;
+        const uint64_t c = cd ? cd->mask : 0;
+        mix(&v, sizeof(v));
+        mix(&c, sizeof(c));
+    }
+    // 时间轮中节点的顺序和调度的历史有关, 每个定时器单独混合之后相加, 和顺序无关
+    uint64_t pending = 0;
+    timers.forEach([&pending](uint64_t when, const Timer& t){
+        uint64_t v = (when * 0x9e3779b97f4a7c15ull) ^ (uint64_t(entt::to_integral(t.entity)) << 32 | t.kind);
+        v = (v ^ (v >> 31) ^ t.data) * 0xbf58476d1ce4e5b9ull;
+        pending += v ^ (v >> 27);
+    });
+    const uint64_t count = timers.size();
+    mix(&count, sizeof(count));
+    mix(&pending, sizeof(pending));
+    return h;
+}
+
+void World::setCheckpoint(CheckpointWriter* writer, const std::string& path, uint32_t interval){
+    ckpt_writer = writer;
+    ckpt_interval = writer ? interval : 0;
+    for (CheckpointImage& img : ckpt_images) {
+        while (img.busy.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+        img.path = path;
+    }
+}
+
+// 拷贝到空闲的缓冲交给写线程; 上一次的还没写完时用另一块, 两块都在写就跳过
+void World::checkpoint(){
+    CheckpointImage* img = nullptr;
+    for (CheckpointImage& c : ckpt_images) {
+        if (!c.busy.load(std::memory_order_acquire)) {
+            img = &c;
+            break;
+        }
+    }
+    if (img == nullptr) {
+        ++ckpt_stats.skipped;
+        return;
+    }
+    using clock = std::chrono::steady_clock;
+    auto begin = clock::now();
+    saveCheckpoint(img->bytes);
+    ckpt_stats.copy_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - begin).count();
+    ckpt_stats.bytes = img->bytes.size();
+    img->busy.store(true, std::memory_order_release);
+    if (ckpt_writer->submit(img)) {
+        ++ckpt_stats.saved;
+    }
+}
+
+void World::saveCheckpoint(std::vector<uint8_t>& out) const {
+    const size_t n = body.size();
+    const size_t m = timers.size();
+    const CheckpointLayout layout(n, m);
+    out.resize(layout.total);
+    uint8_t* base = out.data();
+    CheckpointHeader h;
+    h.real_size = sizeof(Real);
+    h.tick = tick_count;
+    h.entities = static_cast<uint32_t>(n);
+    h.timers = static_cast<uint32_t>(m);
+    h.bytes = layout.total;
+    h.hash = stateHash();
+    std::memcpy(base, &h, sizeof(h));
+    std::memcpy(base + layout.x, body.x(), n * sizeof(Real));
+    std::memcpy(base + layout.y, body.y(), n * sizeof(Real));
+    std::memcpy(base + layout.vx, body.vx(), n * sizeof(Real));
+    std::memcpy(base + layout.vy, body.vy(), n * sizeof(Real));
+    uint32_t* entity = reinterpret_cast<uint32_t*>(base + layout.entity);
+    int32_t* hp = reinterpret_cast<int32_t*>(base + layout.hp);
+    uint32_t* status = reinterpret_cast<uint32_t*>(base + layout.status);
+    uint32_t* player = reinterpret_cast<uint32_t*>(base + layout.player);
+    uint32_t* view = reinterpret_cast<uint32_t*>(base + layout.view);
+    uint32_t* cooldown = reinterpret_cast<uint32_t*>(base + layout.cooldown);
+    int8_t* move_x = reinterpret_cast<int8_t*>(base + layout.move_x);
+    int8_t* move_y = reinterpret_cast<int8_t*>(base + layout.move_y);
+    uint8_t* buttons = base + layout.buttons;
+    for (size_t i = 0; i < n; ++i) {
+        const entt::entity e = body.owner(uint32_t(i));
+        entity[i] = entt::to_integral(e);
+        hp[i] = reg.get<Hp>(e).value;
+        status[i] = reg.get<Status>(e).flags;
+        const Player* p = reg.try_get<Player>(e);
+        const Intent* in = reg.try_get<Intent>(e);
+        const Cooldown* cd = reg.try_get<Cooldown>(e);
+        player[i] = p ? p->player_id : 0;
+        view[i] = in ? in->view_tick : 0;
+        cooldown[i] = cd ? cd->mask : 0;
+        move_x[i] = in ? in->move_x : 0;
+        move_y[i] = in ? in->move_y : 0;
+        buttons[i] = in ? in->buttons : 0;
+    }
+    // 定时器都在当前tick之后到期, 保存剩余的tick数
+    uint32_t* timer_entity = reinterpret_cast<uint32_t*>(base + layout.timer_entity);
+    uint32_t* timer_kind = reinterpret_cast<uint32_t*>(base + layout.timer_kind);
+    uint32_t* timer_data = reinterpret_cast<uint32_t*>(base + layout.timer_data);
+    uint32_t* timer_left = reinterpret_cast<uint32_t*>(base + layout.timer_left);
+    size_t k = 0;
+    timers.forEach([&](uint64_t when, const Timer& t){
+        timer_entity[k] = entt::to_integral(t.entity);
+        timer_kind[k] = t.kind;
+        timer_data[k] = t.data;
+        timer_left[k] = static_cast<uint32_t>(when - tick_count);
+        ++k;
+    });
+}
+
+bool World::restore(const std::string& path){
+    CheckpointFile file;
+    return file.open(path) && restore(file.data(), file.size());
+}
+
+// 按保存时的 slot 顺序重建, 运动学数据的布局和 slot 都和保存时相同
+bool World::restore(const uint8_t* data, size_t len){
+    CheckpointHeader h;
+    if (len < sizeof(h)) {
+        errorlog << "checkpoint is too short";
+        return false;
+    }
+    std::memcpy(&h, data, sizeof(h));
+    const CheckpointLayout layout(h.entities, h.timers);
+    if (h.magic != CheckpointHeader::MAGIC || h.version != CheckpointHeader::VERSION || h.real_size != sizeof(Real)
+        || h.bytes != layout.total || len < layout.total) {
+        errorlog << "checkpoint has an unsupported format";
+        return false;
+    }
+    if (task_sched.size() != 0) {
+        errorlog << "cannot restore a checkpoint while tasks are running";
+        return false;
+    }
+    // 现有的实体和定时器全部删除, id 都空出来; 恢复失败时也删除已经重建的实体, 房间是空的
+    auto discard = [this](){
+        std::vector<entt::entity> old(body.ownerList().begin(), body.ownerList().end());
+        for (entt::entity e : old) {
+            despawn(e);
+        }
+        timers = TimerWheel(tick_count);
+    };
+    discard();
+    const size_t n = h.entities;
+    const Real* x = reinterpret_cast<const Real*>(data + layout.x);
+    const Real* y = reinterpret_cast<const Real*>(data + layout.y);
+    const Real* vx = reinterpret_cast<const Real*>(data + layout.vx);
+    const Real* vy = reinterpret_cast<const Real*>(data + layout.vy);
+    const uint32_t* entity = reinterpret_cast<const uint32_t*>(data + layout.entity);
+    const int32_t* hp = reinterpret_cast<const int32_t*>(data + layout.hp);
+    const uint32_t* status = reinterpret_cast<const uint32_t*>(data + layout.status);
+    const uint32_t* player = reinterpret_cast<const uint32_t*>(data + layout.player);
+    const uint32_t* view = reinterpret_cast<const uint32_t*>(data + layout.view);
+    const uint32_t* cooldown = reinterpret_cast<const uint32_t*>(data + layout.cooldown);
+    const int8_t* move_x = reinterpret_cast<const int8_t*>(data + layout.move_x);
+    const int8_t* move_y = reinterpret_cast<const int8_t*>(data + layout.move_y);
+    const uint8_t* buttons = data + layout.buttons;
+    body.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        const entt::entity want = entt::entity(entity[i]);
+        const entt::entity e = reg.create(want);
+        if (e != want) {
+            errorlog << "checkpoint entity " << entity[i] << " is already in use";
+            reg.destroy(e);
+            discard();
+            return false;
+        }
+        reg.emplace<Body>(e, body.add(e, x[i], y[i], vx[i], vy[i]));
+        reg.emplace<Hp>(e, hp[i]);
+        reg.emplace<Status>(e, status[i]);
+        index->insert(e, toFloat(x[i]), toFloat(y[i]));
+        if (status[i] & flat::Player) {
+            reg.emplace<Player>(e, player[i]);
+            reg.emplace<Intent>(e, move_x[i], move_y[i], buttons[i], view[i]);
+            reg.emplace<Cooldown>(e, cooldown[i]);
+            players[player[i]] = e;
+        }
+    }
+    tick_count = h.tick;
+    timers = TimerWheel(tick_count);
+    const uint32_t* timer_entity = reinterpret_cast<const uint32_t*>(data + layout.timer_entity);
+    const uint32_t* timer_kind = reinterpret_cast<const uint32_t*>(data + layout.timer_kind);
+    const uint32_t* timer_data = reinterpret_cast<const uint32_t*>(data + layout.timer_data);
+    const uint32_t* timer_left = reinterpret_cast<const uint32_t*>(data + layout.timer_left);
+    for (size_t i = 0; i < h.timers; ++i) {
+        timers.schedule(uint64_t(tick_count) + timer_left[i], Timer{ entt::entity(timer_entity[i]), timer_kind[i], timer_data[i] });
+    }
+    // 之前的历史没有保存, 只有检查点这一帧; 更早的 view_tick 按当前位置判定
+    hist.clear();
+    if (hist.enabled()) {
+        History::Frame& f = hist.save(tick_count, body);
+        reg.view<const Player, const Intent>().each([&f](entt::entity e, const Player&, const Intent& in){
+            f.actors.push_back(e);
+            f.intents.push_back(in);
+        });
+    }
+    if (stateHash() != h.hash) {
+        errorlog << "checkpoint at tick " << h.tick << " restored to a different state";
+        discard();
+        return false;
+    }
+    return true;
+}
+
+uint32_t World::toTicks(float seconds) const {
+    return static_cast<uint32_t>(std::lround(seconds * cfg.tick_rate));
+}
+
+// 把本tick收到的输入写到玩家的 Intent 上
+// 指定了已经模拟过的tick的输入是迟到的, 修改历史中的输入, 最后从最早的一个tick开始统一重新模拟
+void World::inputSystem(){
+    InputBuffer& in = *frame_input;
+    const size_t n = in.size();
+    uint32_t replay = 0;
+    for (size_t i = 0; i < n; ++i) {
+        auto it = players.find(in.player_id[i]);
+        if (it == players.end()) {
+            continue;
+        }
+        // 客户端填的帧只接受历史范围之内的, 不能指定未来的帧, 也不能让重新模拟超出历史
+        const uint32_t tk = in.tick[i];
+        if (tk > tick_count || (tk && tk < tick_count && tk + cfg.history <= tick_count)) {
+            ++tick_stats.rejected_inputs;
+            continue;
+        }
+        if (tk && tk < tick_count && patchInput(it->second, tk, in.move_x[i], in.move_y[i], in.buttons[i])) {
+            replay = replay ? std::min(replay, tk) : tk;
+            ++tick_stats.late_inputs;
+        }
+        Intent& intent = reg.get<Intent>(it->second);
+        intent.move_x = in.move_x[i];
+        intent.move_y = in.move_y[i];
+        intent.buttons = in.buttons[i];
+        intent.view_tick = in.ack[i];
+    }
+    if (replay) {
+        // 重新模拟会把 Intent 换成历史中的输入, 结束时是上一个tick的输入, 本tick的新输入要重新写一次
+        FrameVector<Intent> current(&frame_arena);
+        current.reserve(players.size());
+        auto view = reg.view<const Player, Intent>();
+        for (auto e : view) {
+            current.push_back(view.get<Intent>(e));
+        }
+        resimulate(replay);
+        size_t k = 0;
+        for (auto e : view) {
+            view.get<Intent>(e) = current[k++];
+        }
+    }
+}
+
+bool World::patchInput(entt::entity e, uint32_t tick, int8_t move_x, int8_t move_y, uint8_t buttons){
+    const History::Frame* base = hist.at(tick - 1);
+    if (base == nullptr || base->body.layout() != body.layout() || hist.at(tick) == nullptr) {
+        return false;
+    }
+    // 从 tick 开始, 一直到玩家的输入发生变化为止, 都换成新的输入
+    Intent held{};
+    for (uint32_t t = tick; t <= hist.newestTick(); ++t) {
+        History::Frame* f = hist.at(t);
+        auto it = std::find(f->actors.begin(), f->actors.end(), e);
+        if (it == f->actors.end()) {
+            break;
+        }
+        Intent& intent = f->intents[it - f->actors.begin()];
+        if (t == tick) {
+            held = intent;
+        }else if (intent.move_x != held.move_x || intent.move_y != held.move_y || intent.buttons != held.buttons) {
+            break;
+        }
+        intent.move_x = move_x;
+        intent.move_y = move_y;
+        intent.buttons = buttons;
+    }
+    return true;
+}
+
+// 从 tick - 1 结束时的状态开始, 用历史中的输入重新模拟到最近保存的一个tick
+// 调用前已经确认这段时间内没有实体增删, 所以每一帧的slot都和当前一致
+void World::resimulate(uint32_t tick){
+    body = hist.at(tick - 1)->body;
+    const float step = dt();
+    for (uint32_t t = tick; t <= hist.newestTick(); ++t) {
+        History::Frame* f = hist.at(t);
+        for (size_t i = 0; i < f->actors.size(); ++i) {
+            reg.get<Intent>(f->actors[i]) = f->intents[i];
+        }
+        steer();
+        integrate(step);
+        f->body = body;
+    }
+    reindex(true);
+}
+
+void World::movementSystem(float dt){
+    steer();
+    integrate(dt);
+    reindex(false);
+}
+
+void World::steer(){
+    // 玩家的速度由输入决定, move 是 [-127, 127] 的模拟量
+    // Real 是 float 或者定点数(WORLD_FIXED_POINT), 配置中的浮点数在这里转换
+    const Real scale = Real(cfg.speed) / Real(127);
+    const Real zero = Real(0);
+    Real* vx = body.vx();
+    Real* vy = body.vy();
+    reg.view<const Intent, const Body, const Status>().each([=](const Intent& in, const Body& b, const Status& s){
+        if (s.flags & (flat::Stunned)) {
+            vx[b.slot] = vy[b.slot] = zero;
+            return;
+        }
+        vx[b.slot] = Real(in.move_x) * scale;
+        vy[b.slot] = Real(in.move_y) * scale;
+    });
+}
+
+void World::integrate(float dt){
+    // 对整列做积分和衰减, 每块的大小是向量宽度的整数倍
+    const size_t n = body.size();
+    Real* x = body.x();
+    Real* y = body.y();
+    Real* vx = body.vx();
+    Real* vy = body.vy();
+    const kernel::Bounds bounds{ Real(cfg.min_x), Real(cfg.min_y), Real(cfg.max_x), Real(cfg.max_y) };
+    const Real step = Real(dt);
+    const Real damping = Real(cfg.damping);
+    sched.pool().parallelFor(n, parallel_grain, [&](size_t begin, size_t end){
+        kernels.integrate(x + begin, y + begin, vx + begin, vy + begin, end - begin, step, bounds);
+        if (cfg.damping < 1.0f) {
+            kernels.damp(vx + begin, vy + begin, end - begin, damping);
+        }
+    });
+
+}
+
+void World::reindex(bool all){
+    // 只有跨格子时索引才真正移动
+    const Real zero = Real(0);
+    const size_t n = body.size();
+    const Real* x = body.x();
+    const Real* y = body.y();
+    const Real* vx = body.vx();
+    const Real* vy = body.vy();
+    for (size_t i = 0; i < n; ++i) {
+        if (all || vx[i] != zero || vy[i] != zero) {
+            index->move(body.owner(i), toFloat(x[i]), toFloat(y[i]));
+        }
+    }
+}
+
+void World::combatSystem(){
+    // 动作状态位跟随输入, 刚按下的动作做一次命中判定
+    attacks.clear();
+    const uint32_t cd1 = toTicks(cfg.skill1_cooldown);
+    const uint32_t cd2 = toTicks(cfg.skill2_cooldown);
+    reg.view<const Intent, Status, Cooldown>().each([this, cd1, cd2](entt::entity e, const Intent& in, Status& s, Cooldown& cd){
+        const uint32_t was = s.flags;
+        s.flags &= ~uint32_t(flat::Attacking | flat::Casting1 | flat::Casting2);
+        if (!(s.flags & flat::Alive)) {
+            return;
+        }
+        if (in.buttons & flat::Attack) s.flags |= flat::Attacking;
+        // 冷却中的技能不释放
+        if ((in.buttons & flat::Skill1) && !(cd.mask & flat::Casting1)) s.flags |= flat::Casting1;
+        if ((in.buttons & flat::Skill2) && !(cd.mask & flat::Casting2)) s.flags |= flat::Casting2;
+        uint32_t pressed = s.flags & ~was & uint32_t(flat::Attacking | flat::Casting1 | flat::Casting2);
+        if (pressed) {
+            attacks.emplace_back(e, static_cast<uint8_t>(pressed));
+        }
+        if ((pressed & flat::Casting1) && cd1) {
+            cd.mask |= flat::Casting1;
+            schedule(cd1, e, CooldownTimer, flat::Casting1);
+        }
+        if ((pressed & flat::Casting2) && cd2) {
+            cd.mask |= flat::Casting2;
+            schedule(cd2, e, CooldownTimer, flat::Casting2);
+        }
+    });
+    contact_buf.clear();
+    if (!attacks.empty()) {
+        broad.update(body);
+    }
+    // 判定在 Real 上进行, 配置中的浮点数在这里转换
+    const Real attack_range = Real(cfg.attack_range);
+    const Real skill_range = Real(cfg.skill_range);
+    for (auto& a : attacks) {
+        const uint32_t slot = reg.get<Body>(a.first).slot;
+        const Real px = body.x()[slot];
+        const Real py = body.y()[slot];
+        if (a.second & flat::Attacking) {
+            detect(a.first, flat::Attacking, Shape::circle(px, py, attack_range));
+        }
+        if (a.second & flat::Casting1) {
+            detect(a.first, flat::Casting1, Shape::circle(px, py, skill_range));
+        }
+        if (a.second & flat::Casting2) {
+            // 面朝移动输入的方向, 没有输入时以自己为中心
+            const Intent& in = reg.get<Intent>(a.first);
+            detect(a.first, flat::Casting2, Shape::ahead(px, py, in.move_x, in.move_y, skill_range));
+        }
+    }
+    resolve();
+    // 死亡
+    const Real zero = Real(0);
+    Real* vx = body.vx();
+    Real* vy = body.vy();
+    reg.view<const Hp, Status, const Body>().each([=](const Hp& hp, Status& s, const Body& b){
+        if (hp.value <= 0 && (s.flags & flat::Alive)) {
+            s.flags &= ~uint32_t(flat::Alive | flat::Moving);
+            vx[b.slot] = vy[b.slot] = zero;
+        }
+    });
+}
+
+// 命中检测: 形状用攻击者当前的位置, 目标回退到攻击者看到的那个tick(客户端确认过的快照)
+// 粗检测用当前位置, 包围盒外扩实体半径和这段时间内最多能移动的距离, 细检测用历史位置
+void World::detect(entt::entity source, uint8_t action, const Shape& shape){
+    const History::Frame* f = nullptr;
+    uint32_t lag = 0;
+    if (hist.enabled() && hist.newestTick() != 0) {
+        uint32_t view = std::min(std::max(reg.get<Intent>(source).view_tick, hist.oldestTick()), hist.newestTick());
+        f = hist.at(view);
+        lag = tick_count - view;
+    }
+    const Real radius = Real(cfg.body_radius);
+    const Real margin = radius + broad.maxSpeed() * Real(dt()) * Real(lag);
+    const uint64_t layout = body.layout();
+    // 热循环中直接用组件的存储, 不再每次经过 registry 查找
+    const auto& status = reg.storage<Status>();
+    broad.sweep(shape, margin, [&](uint32_t slot, Real x, Real y){
+        entt::entity e = body.owner(slot);
+        if (e == source) {
+            return;
+        }
+        uint32_t old = 0;
+        if (f && f->slotOf(e, slot, layout, old)) {
+            x = f->body.x()[old];
+            y = f->body.y()[old];
+        }
+        RealSq d2 = RealSq(0);
+        if (shape.overlaps(x, y, radius, d2) && (status.get(e).flags & flat::Alive)) {
+            contact_buf.push_back(Contact{ source, e, action, d2 });
+        }
+    });
+}
+
+// 结算伤害: 攻击只命中同一组中最近的目标, 技能命中所有目标
+void World::resolve(){
+    auto& hp = reg.storage<Hp>();
+    const size_t n = contact_buf.size();
+    for (size_t i = 0; i < n; ) {
+        const Contact& c = contact_buf[i];
+        size_t end = i + 1;
+        while (end < n && contact_buf[end].source == c.source && contact_buf[end].action == c.action) {
+            ++end;
+        }
+        if (c.action == flat::Attacking) {
+            size_t best = i;
+            for (size_t k = i + 1; k < end; ++k) {
+                if (contact_buf[k].dist2 < contact_buf[best].dist2) {
+                    best = k;
+                }
+            }
+            hp.get(contact_buf[best].target).value -= cfg.attack_damage;
+        }else{
+            for (size_t k = i; k < end; ++k) {
+                hp.get(contact_buf[k].target).value -= cfg.skill_damage;
+            }
+        }
+        i = end;
+    }
+}
+
+// 生成本tick的快照, 按 entity_id 升序, 交给增量编码
+void World::snapshotSystem(){
+    const size_t n = body.size();
+    snap.resize(n);
+    const Real zero = Real(0);
+    const Real* x = body.x();
+    const Real* y = body.y();
+    const Real* vx = body.vx();
+    const Real* vy = body.vy();
+    // 按 slot 切块并行量化, 每块只写自己的区间, 排序之后和串行的结果相同
+    const entt::registry& r = reg;
+    sched.pool().parallelFor(n, parallel_grain, [&](size_t begin, size_t end){
+        for (size_t i = begin; i < end; ++i) {
+            entt::entity e = body.owner(i);
+            uint32_t flags = r.get<Status>(e).flags;
+            if (vx[i] != zero || vy[i] != zero) {
+                flags |= flat::Moving;
+            }
+            snap[i] = io::PackedEntity(entt::to_integral(e), flat::clamp16(r.get<Hp>(e).value), static_cast<uint16_t>(flags),
+                quant.posX(toFloat(x[i])), quant.posY(toFloat(y[i])), quant.vel(toFloat(vx[i])), quant.vel(toFloat(vy[i])));
+        }
+    });
+    std::sort(snap.begin(), snap.end(), [](const io::PackedEntity& a, const io::PackedEntity& b){
+        return a.entity_id() < b.entity_id();
+    });
+    for (uint32_t i = 0; i < snap.size(); ++i) {
+        uint32_t k = detail::key(entt::entity(snap[i].entity_id()));
+        if (k >= snap_slot.size()) {
+            snap_slot.resize(k + 1);
+        }
+        snap_slot[k] = i;
+    }
+    // 保存本tick结束时的状态和玩家的输入, 之后的命中判定和迟到的输入会用到
+    if (hist.enabled()) {
+        History::Frame& f = hist.save(tick_count, body);
+        reg.view<const Player, const Intent>().each([&f](entt::entity e, const Player&, const Intent& in){
+            f.actors.push_back(e);
+            f.intents.push_back(in);
+        });
+    }
+}
 
-// 逻辑的实现
\ No newline at end of file
+} // namespace world
@@ -1,13 +1,259 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <entt/entt.hpp>
+#include "arena.h"
+#include "checkpoint.h"
+#include "collision.h"
+#include "components.h"
+#include "grid.h"
+#include "history.h"
+#include "input.h"
+#include "kinematics.h"
+#include "pack.h"
+#include "record.h"
+#include "scheduler.h"
+#include "task.h"
+#include "wheel.h"
+
 namespace world{
 
-// 维护世界的状态, 用输入更新, 并进行广播每一帧的输出(状态同步和帧同步)
+struct Config{
+    uint32_t tick_rate = 30;   // 每秒tick数
+    uint32_t max_catchup = 5;  // 落后时一次最多追的tick数, 再多就丢弃积压
+    float speed = 6.0f;        // 玩家满输入时的速度, 单位每秒
+    int32_t spawn_hp = 100;
+    // 地图边界
+    float min_x = -1000.0f;
+    float min_y = -1000.0f;
+    float max_x = 1000.0f;
+    float max_y = 1000.0f;
+    size_t reserve = 2048;     // 预留的实体数, 避免tick中扩容
+    // 空间索引, 默认均匀网格, 实体分布很不均匀的地图可以用松散四叉树
+    float cell_size = 32.0f;
+    bool quadtree = false;
+    // 速度衰减系数, 每tick乘一次, 1 表示不衰减
+    float damping = 1.0f;
+    // 确定性模式: 运动内核不使用FMA, 结果和标量实现逐位相同
+    bool deterministic = false;
+    // 工作线程数, 0 时所有系统都在world线程上串行执行
+    // 不冲突的系统和大数组上的 parallelFor 会分到工作线程上
+    uint32_t threads = 0;
+    // 保存最近多少个tick的运动学状态, 用于延迟补偿, 0 表示关闭
+    uint32_t history = 32;
+    // 攻击和技能的判定距离与伤害
+    // 攻击命中范围内最近的一个目标; skill1 是以自己为中心的圆, skill2 是面朝方向上边长为 skill_range 的方形, 命中范围内所有目标
+    float attack_range = 2.0f;
+    int32_t attack_damage = 10;
+    float skill_range = 6.0f;
+    int32_t skill_damage = 25;
+    float body_radius = 0.5f;  // 实体的碰撞半径
+    float sweep_strip = 8.0f;  // 碰撞检测按 y 分带的高度, 和判定范围差不多大时扫描的实体最少
+    size_t arena = 64 * 1024;  // 帧分配器的初始大小, 不够时自动合并扩大
+    // 技能的冷却时间, 秒, 0 表示没有冷却(默认, 每次按下都释放); 冷却中按住技能键不会释放, 冷却结束时仍然按住就立即释放
+    float skill1_cooldown = 0.0f;
+    float skill2_cooldown = 0.0f;
+};
+
+// 定时器, 以tick为单位, 在到期的那个tick开始时按类型成批交给处理函数, 见 World::schedule
+struct Timer{
+    entt::entity entity;
+    uint32_t kind;
+    uint32_t data;
+};
+enum TimerKind : uint32_t {
+    CooldownTimer = 1,     // data 是冷却结束的动作位
+    UserTimer = 1024,      // 自定义的类型从这里开始
+};
+// 定时器作为资源参与冲突检测, 在系统中调用 schedule/cancelTimer 要声明 write<TimerWheel>()
+using TimerWheel = timer::Wheel<Timer>;
+
+struct TickStats{
+    uint64_t ticks = 0;
+    uint64_t last_ns = 0;      // 上一个tick的总耗时
+    uint64_t max_ns = 0;
+    double avg_ns = 0;         // 指数滑动平均
+    uint64_t dropped = 0;      // 追不上时丢弃的tick数
+    uint64_t late_inputs = 0;  // 修改了历史输入的指令数, 每个玩家每个tick最多一条
+    uint64_t rejected_inputs = 0; // 指定的帧在当前tick之后, 或者早到历史中已经没有的指令数
+    std::vector<uint64_t> system_ns; // 上一个tick每个系统的耗时, 与systems的顺序一致
+};
+
+// 维护世界的状态, 用输入更新, 并进行广播每一帧的输出(状态同步), 帧同步的房间见 LockstepRoom
+// 状态存放在 EnTT 的 registry 中, 每个tick执行 input, movement, combat, snapshot 几个系统
+// 系统按声明的读写集合由 Scheduler 调度, 冲突的系统按注册顺序执行
 class World{
 public:
+    explicit World(const Config& cfg = Config());
+    // 等写线程写完还在使用的检查点缓冲
+    ~World();
+
+    // 固定步长循环, 阻塞直到stop
+    void run();
+    void stop();
+    // 推进一个tick, run 内部调用, 也可以由外部的调度器或回放直接驱动
+    void tick();
+
+    entt::entity spawn(uint32_t player_id, float x, float y);
+    entt::entity spawnNpc(float x, float y, float vx, float vy);
+    void despawn(entt::entity e);
+    entt::entity findPlayer(uint32_t player_id) const;
+
+    Position position(entt::entity e) const;
+    Velocity velocity(entt::entity e) const;
+    void setVelocity(entt::entity e, float vx, float vy);
+    // 实体在 tick 结束时的位置, tick 已经不在历史中或者那时实体不存在时返回false
+    bool positionAt(entt::entity e, uint32_t tick, Position& out) const;
+
+    // 迟到的输入: 把玩家在 tick 的输入改掉(连同之后一直保持不变的几个tick), 再从 tick 开始重新模拟运动
+    // 只重算运动, 战斗的结果不回滚; tick 已经不在历史中, 或者之后有实体增删时返回false
+    bool lateInput(uint32_t player_id, uint32_t tick, int8_t move_x, int8_t move_y, uint8_t buttons);
+
+    // 在 snapshot 之前插入一个自定义系统
+    // 不声明读写集合的系统是独占的, 和其他系统串行执行
+    void addSystem(const std::string& name, const std::function<void(float)>& fn);
+    void addSystem(const std::string& name, const Access& access, const std::function<void(float)>& fn);
+    // 每个tick的快照生成之后调用, 在world线程中执行
+    void setSnapshotCallback(const std::function<void(const World&)>& back);
+
+    // delay 个tick之后到期, 0 和 1 都是下一个tick开始时; 实体在到期前销毁时定时器照常到期, 处理函数自己检查
+    timer::TimerId schedule(uint32_t delay, entt::entity e, uint32_t kind, uint32_t data = 0);
+    bool cancelTimer(timer::TimerId id);
+    // 一类定时器的处理函数, tick开始时在world线程中调用, 这一类本tick到期的定时器一次交给它
+    void onTimer(uint32_t kind, const std::function<void(World&, const Timer*, size_t)>& fn);
+    // 跨多个tick的逻辑, 见 task.h; 协程在每个tick开始时, 定时器的处理函数之后恢复
+    TaskScheduler& tasks() { return task_sched; }
+
+    // 把之后每个tick的输入和状态哈希录制到文件中, 见 record.h; 在world线程中或者加入调度之前调用
+    bool record(const std::string& path);
+    void stopRecording();
+    const InputRecorder* recorder() const { return rec.get(); }
+    // 运动学数据, 生命值, 状态, 技能冷却和未到期定时器的哈希, 录制和回放用来比较两次模拟是否逐位相同
+    uint64_t stateHash() const;
+
+    // 每 interval 个tick在tick结束时保存一次检查点到 path, 由 writer 在后台写文件, 见 checkpoint.h; interval 为0时关闭
+    void setCheckpoint(CheckpointWriter* writer, const std::string& path, uint32_t interval);
+    // 把当前状态按检查点的格式写到 out, 复用 out 的容量
+    void saveCheckpoint(std::vector<uint8_t>& out) const;
+    // 用检查点替换所有实体, tick 也回到检查点的tick; 在加入调度和启动协程之前调用
+    // 格式不对, 实体 id 冲突或者恢复之后的状态哈希和保存时不同时返回false, 这时房间中没有实体
+    bool restore(const uint8_t* data, size_t len);
+    bool restore(const std::string& path);
+    const CheckpointStats& checkpointStats() const { return ckpt_stats; }
+
+    // 交给 conn::Connect::bind 的输入队列
+    InputQueue& input() { return inputs; }
+    entt::registry& registry() { return reg; }
+    const entt::registry& registry() const { return reg; }
+    const Config& config() const { return cfg; }
+    uint32_t currentTick() const { return tick_count; }
+    float dt() const { return 1.0f / cfg.tick_rate; }
+    const TickStats& stats() const { return tick_stats; }
+    const std::vector<System>& systems() const { return pipeline; }
+    // 系统内部可以用 pool().parallelFor 切块并行
+    ThreadPool& pool() { return sched.pool(); }
+    // 本tick的快照, 按 entity_id 升序, 已量化, 在下一个tick开始之前有效
+    const FrameVector<io::PackedEntity>& snapshot() const { return snap; }
+    const flat::Quantizer& quantizer() const { return quant; }
+    const SpatialIndex& spatial() const { return *index; }
+    const Kinematics& kinematics() const { return body; }
+    const History& history() const { return hist; }
+    // 本tick开始时到期的定时器, 按类型排列, 在下一个tick开始之前有效
+    const FrameVector<Timer>& expired() const { return expired_buf; }
+    size_t pendingTimers() const { return timers.size(); }
+    // 本tick combat 中产生的命中, 同一个动作的命中连续存放, 在下一个tick开始之前有效
+    const FrameVector<Contact>& contacts() const { return contact_buf; }
+    // 帧分配器, 每个tick开始时回收; 自定义系统和快照回调中的临时数组可以用 FrameVector<T>(&arena())
+    FrameArena& arena() { return frame_arena; }
+    const ArenaStats& arenaStats() const { return frame_arena.stats(); }
+    const char* kernelName() const { return kernels.name; }
+    // 按升序的 entity_id 从本tick的快照中取出对应的实体, 追加到out, 不存在的跳过
+    // out 可以是 std::vector 或者 FrameVector
+    template<class Out>
+    void gather(const std::vector<uint32_t>& ids, Out& out) const;
 
 private:
+    void inputSystem();
+    void movementSystem(float dt);
+    void combatSystem();
+    void snapshotSystem();
+    // 回收上一个tick的临时数据
+    void beginFrame();
+    // 取出本tick的输入, 先处理玩家进出
+    void takeInput();
+    // 按间隔保存检查点, tick 结束时调用
+    void checkpoint();
+    // 取出本tick到期的定时器交给处理函数
+    void expireTimers();
+    uint32_t toTicks(float seconds) const;
+
+    // movement 的几个步骤, 重新模拟时也会用到
+    void steer();
+    void integrate(float dt);
+    void reindex(bool all);
+    // 修改 tick 开始保持不变的输入, 返回是否修改
+    bool patchInput(entt::entity e, uint32_t tick, int8_t move_x, int8_t move_y, uint8_t buttons);
+    void resimulate(uint32_t tick);
+    // 一个动作的命中检测, 结果追加到 contact_buf
+    void detect(entt::entity source, uint8_t action, const Shape& shape);
+    void resolve();
 
+private:
+    Config cfg;
+    entt::registry reg;
+    InputQueue inputs;
+    InputBuffer* frame_input = nullptr; // 本tick的输入, 在 inputs 中
+    std::unique_ptr<InputRecorder> rec;
+    CheckpointWriter* ckpt_writer = nullptr;
+    uint32_t ckpt_interval = 0;
+    std::array<CheckpointImage, 2> ckpt_images;
+    CheckpointStats ckpt_stats;
+    std::unordered_map<uint32_t, entt::entity> players;
+    std::vector<System> pipeline;
+    Scheduler sched;
+    std::function<void(const World&)> snapshot_callback;
+    Kinematics body;
+    kernel::Kernels kernels;
+    std::unique_ptr<SpatialIndex> index;
+    // 在使用它的数组之前构造, 之后析构
+    FrameArena frame_arena;
+    History hist;
+    FrameVector<std::pair<entt::entity, uint8_t>> attacks; // 本tick按下的攻击和技能
+    Broadphase broad;
+    FrameVector<Contact> contact_buf;
+    FrameVector<io::PackedEntity> snap;
+    std::vector<uint32_t> snap_slot; // 实体下标 -> snap 中的位置
+    TimerWheel timers;
+    FrameVector<Timer> expired_buf;
+    std::vector<std::pair<uint32_t, std::function<void(World&, const Timer*, size_t)>>> timer_handlers;
+    flat::Quantizer quant;
+    uint32_t tick_count = 0;
+    TickStats tick_stats;
+    std::atomic<bool> running { false };
+    // 协程中可能引用 World 的其他成员, 最先析构
+    TaskScheduler task_sched;
 }; // class World
 
-} // namespace world
\ No newline at end of file
+template<class Out>
+void World::gather(const std::vector<uint32_t>& ids, Out& out) const {
+    for (uint32_t id : ids) {
+        uint32_t k = detail::key(entt::entity(id));
+        if (k >= snap_slot.size()) {
+            continue;
+        }
+        uint32_t i = snap_slot[k];
+        // 下标可能被回收复用, 比较完整的id
+        if (i < snap.size() && snap[i].entity_id() == id) {
+            out.push_back(snap[i]);
+        }
+    }
+}
+
+} // namespace world
@@ -0,0 +1,108 @@
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+#include <log.h>
+#include "../../src/server/broadcast.h"
+
+// 一个房间 256 个会话的快照编码耗时
+// 1000 个移动的实体, 会话每个tick确认两个tick之前的快照. 比较:
+//   不限预算: 所有会话选中全部实体, 确认进度相同, 每帧只编码一次, 其余会话共享
+//   限制预算: 每个会话挑选的实体不同, 各自编码, 按编码线程池的线程数比较每个快照的耗时
+// 会话没有真的连接, 网络线程发送时找不到连接直接丢弃.
+
+static const uint32_t sessions = 256;
+static const size_t entities = 1000;
+static const uint32_t rounds = 200;
+
+using namespace server;
+
+struct Result{
+    double us = 0;           // 每个快照的编码耗时
+    BroadcastStats stats;
+};
+
+static Result run(enet::ENetServer& net, uint32_t budget, size_t threads){
+    snap::PriorityConfig pc;
+    pc.budget = budget;
+    RateConfig rc;
+    rc.sample_ms = 0;
+    std::unique_ptr<world::ThreadPool> pool;
+    if (threads) {
+        pool = std::make_unique<world::ThreadPool>(threads);
+    }
+    Broadcaster b(net, 0, 4096, pc, rc, pool.get());
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> pos(-8000, 8000);
+    std::vector<io::PackedEntity> state;
+    for (size_t i = 0; i < entities; ++i) {
+        state.emplace_back(uint32_t(i), 100, flat::Alive | flat::Moving, int16_t(pos(rng)), int16_t(pos(rng)), 16, -16);
+    }
+
+    using clock = std::chrono::steady_clock;
+    auto begin = clock::now();
+    std::thread t([&](){ b.run(); });
+    for (uint32_t tick = 1; tick <= rounds; ++tick) {
+        for (auto& e : state) {
+            e = io::PackedEntity(e.entity_id(), e.hp(), e.status_flags(), int16_t(e.x() + 1), int16_t(e.y() - 1), e.vx(), e.vy());
+        }
+        if (tick > 2) {
+            for (uint32_t sid = 1; sid <= sessions; ++sid) {
+                b.ack(sid, tick - 2);
+            }
+        }
+        std::shared_ptr<SnapshotJob> job = b.acquire();
+        job->room_id = 1;
+        job->tick = tick;
+        job->entities = state;
+        for (uint32_t sid = 1; sid <= sessions; ++sid) {
+            job->sessions.push_back(sid);
+        }
+        b.publish(std::move(job));
+        // 等广播线程取走这个快照, 确认的tick总是已经编码过的
+        while (b.busy()) {
+            std::this_thread::yield();
+        }
+    }
+    b.close();
+    t.join();
+    Result r;
+    r.us = std::chrono::duration<double, std::micro>(clock::now() - begin).count() / rounds;
+    r.stats = b.stats();
+    return r;
+}
+
+static void report(const char* name, size_t threads, const Result& r){
+    infolog << name << ", " << threads << " encode threads: " << r.us << " us per snapshot, "
+            << r.stats.packets << " packets, " << r.stats.shared << " shared, " << r.stats.full << " full";
+}
+
+int main(){
+    enet::ENetServer net(8080, sessions);
+    std::thread net_thread([&](){ net.start(1); });
+
+    const size_t hw = std::max(1u, std::thread::hardware_concurrency());
+    Result shared = run(net, 0, 0);
+    report("unlimited", 0, shared);
+    bool ok = shared.stats.packets == uint64_t(sessions) * rounds && shared.stats.shared > shared.stats.packets * 9 / 10;
+    for (size_t threads = 0; threads < hw; threads = threads ? threads * 2 : 1) {
+        Result r = run(net, 600, threads);
+        report("budget 600", threads, r);
+        ok = ok && r.stats.packets == uint64_t(sessions) * rounds;
+    }
+
+    net.quit();
+    net_thread.join();
+    if (!ok) {
+        errorlog << "failed";
+        return 1;
+    }
+    infolog << "ok";
+    return 0;
+}
+
+// 编译运行
+// flatc --cpp --filename-suffix _fb -o ../../src/flat -I ../../src/flat ../../src/flat/io.fbs ../../src/flat/pack.fbs
+// g++ -O2 -std=c++17 -o broadcast_bench broadcast_bench.cc -I../../src/comm -I../../src/flat -I../../src/snapshot -I../../src/world -I../../src/server -lflatbuffers -lenet -lpthread
@@ -10,7 +10,7 @@ int main() {
             std::shared_ptr<enet::ENetData> data;
             bool ret = client.read(&data);
             if (!ret) break;
-            infolog << std::string{data->data.begin(),data->data.end()};
+            infolog << std::string(reinterpret_cast<const char*>(data->bytes()),data->length());
         }
     });
 
@@ -13,12 +13,10 @@ int main() {
             if (!ret) {
                 break;
             }
-            std::string str(data->data.begin(),data->data.end());
+            std::string str(reinterpret_cast<const char*>(data->bytes()),data->length());
             str = "client [" + std::to_string(data->session_id) + "] : " + str;
             infolog << str;
-            data->data.clear();
-            data->data = std::vector<uint8_t>(str.begin(),str.end());
-            server.send(data);
+            server.send(enet::ENetData::make_data(data->session_id,str,data->channel_id));
         }
     }};
     server.start(0);
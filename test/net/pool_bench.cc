@@ -0,0 +1,129 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <vector>
+#include "../../src/comm/enet.h"
+
+// 网络线程的内存分配次数
+// 模拟网络线程和逻辑线程之间的收发: 网络线程把收到的包做成 ENetData 交给逻辑线程, 逻辑线程释放;
+// 逻辑线程生成要发送的 ENetData, 网络线程取出后像 onSend 一样让包引用负载, 再模拟 freeCallback 释放.
+// 替换全局的 operator new, 只统计网络线程上的调用, 和原来的 make_shared + vector + new shared_ptr 对比.
+
+static thread_local bool net_thread = false;
+static std::atomic<uint64_t> net_allocs{ 0 };
+
+void* operator new(size_t n){
+    if (net_thread) {
+        net_allocs.fetch_add(1, std::memory_order_relaxed);
+    }
+    void* p = std::malloc(n ? n : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+static const int messages = 200000;
+static const int warmup = 20000;
+
+// 原来的做法
+struct Legacy{
+    Legacy(uint32_t sid, const uint8_t* buf, size_t len, uint32_t cid)
+        :session_id(sid), channel_id(cid), data(buf, buf + len)
+    {}
+    uint32_t session_id;
+    uint32_t channel_id;
+    std::vector<uint8_t> data;
+};
+
+// send 返回包的 userData, release 模拟 freeCallback
+template<class Make, class Send, class Release>
+static void run(const char* name, Make&& make, Send&& send, Release&& release){
+    using Data = decltype(make(0, nullptr, 0));
+    lfree::ring_queue<Data> receives{ lfree::queue_size::K2 };
+    lfree::ring_queue<Data> sends{ lfree::queue_size::K2 };
+
+    // 逻辑线程: 读取收到的消息并释放, 每收到一个回一个
+    std::thread logic([&](){
+        uint8_t reply[300] = { 0 };
+        for (int i = 0; i < messages; ++i) {
+            Data in;
+            receives.get(in);
+            in = nullptr;
+            sends.put(make(uint32_t(i % 256), reply, 120 + i % 160));
+        }
+    });
+
+    net_thread = true;
+    uint8_t packet[64] = { 0 };
+    uint64_t before = 0;
+    auto begin = std::chrono::steady_clock::now();
+    int sent = 0;
+    std::vector<void*> inflight; // 模拟还没确认的包
+    inflight.reserve(64);
+    for (int i = 0; i < messages || sent < messages; ) {
+        if (i == warmup) {
+            before = net_allocs.load();
+            begin = std::chrono::steady_clock::now();
+        }
+        if (i < messages) {
+            receives.put(make(uint32_t(i % 256), packet, 16 + i % 48));
+            ++i;
+        }
+        Data out;
+        while (sends.try_get(out)) {
+            inflight.push_back(send(out));
+            out = nullptr;
+            ++sent;
+            if (inflight.size() == 64) {
+                for (void* u : inflight) {
+                    release(u);
+                }
+                inflight.clear();
+            }
+        }
+    }
+    for (void* u : inflight) {
+        release(u);
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    uint64_t allocs = net_allocs.load() - before;
+    net_thread = false;
+    logic.join();
+    infolog << name << ": net thread allocations per 1000 messages: " << allocs * 1000.0 / (messages - warmup)
+            << ", per second: " << allocs / elapsed;
+}
+
+int main(){
+    run("make_shared", [](uint32_t sid, const uint8_t* buf, size_t len){
+        return std::make_shared<Legacy>(sid, buf, len, 0);
+    }, [](const std::shared_ptr<Legacy>& task){
+        // onSend 中给 freeCallback 准备的 new std::shared_ptr
+        return static_cast<void*>(new std::shared_ptr<Legacy>(task));
+    }, [](void* u){
+        delete static_cast<std::shared_ptr<Legacy>*>(u);
+    });
+
+    run("pool", [](uint32_t sid, const uint8_t* buf, size_t len){
+        return enet::ENetData::make_data(sid, buf, len, 0);
+    }, [](const std::shared_ptr<enet::ENetData>& task){
+        // 包只引用 Payload, freeCallback 时释放
+        pool::Payload* p = task->buffer();
+        p->retain();
+        return static_cast<void*>(p);
+    }, [](void* u){
+        static_cast<pool::Payload*>(u)->release();
+    });
+
+    pool::PoolStats s = pool::BufferPool::instance().stats();
+    infolog << "pool upstream allocations: " << s.upstream << ", returned: " << s.returned;
+    return 0;
+}
+
+// 编译运行
+// g++ -O2 -std=c++17 -o pool_bench pool_bench.cc -I../../src/comm -lpthread
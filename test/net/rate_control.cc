@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <cstdint>
+#include <log.h>
+#include "../../src/server/rate.h"
+#include "../../src/snapshot/priority.h"
+
+// 按链路状态调节快照速率
+// 模拟一条 60Hz 发快照的链路: 前5秒带宽充足, 中间5秒降到只能承受满速的五分之一并且有丢包, 最后5秒恢复.
+// 每帧的大小是字节预算加上帧头(人多的时候优先级筛选会把预算用满), 发不出去的数据在链路上排队,
+// 往返时间随排队增加. 比较固定满速发送和使用 RateController 时排队的数据量, 以及恢复之后是否回到满速.
+
+static const uint32_t tick_rate = 60;
+static const uint32_t header = 60;
+static const uint32_t base_rtt = 40;
+
+struct Phase{
+    uint32_t capacity;   // 链路每秒能发出的字节数
+    uint32_t loss;       // 65536 表示 100%
+};
+
+struct Result{
+    uint32_t max_queue[3] = { 0, 0, 0 };
+    double sent[3] = { 0, 0, 0 };          // 每秒发出的字节数
+    uint32_t budget = 0;
+    uint32_t interval = 0;
+    uint64_t backoffs = 0;
+};
+
+static Result run(bool control){
+    const Phase phases[3] = { { 100000, 0 }, { 15000, 6554 }, { 100000, 0 } };
+    server::RateConfig cfg;
+    snap::PriorityConfig pc;
+    server::RateController rate(cfg, pc.budget);
+    const uint32_t sample_ticks = cfg.sample_ms * tick_rate / 1000;
+    Result r;
+    double queue = 0;
+    uint32_t tick = 0;
+    for (int p = 0; p < 3; ++p) {
+        uint64_t bytes = 0;
+        for (uint32_t t = 0; t < tick_rate * 5; ++t) {
+            ++tick;
+            if (!control || rate.due(tick)) {
+                const uint32_t frame = (control ? rate.budget() : pc.budget) + header;
+                queue += frame;
+                bytes += frame;
+            }
+            queue = std::max(0.0, queue - double(phases[p].capacity) / tick_rate);
+            r.max_queue[p] = std::max(r.max_queue[p], static_cast<uint32_t>(queue));
+            if (control && tick % sample_ticks == 0) {
+                enet::LinkStats s;
+                s.rtt = base_rtt + static_cast<uint32_t>(queue * 1000 / phases[p].capacity);
+                s.loss = phases[p].loss;
+                s.in_transit = static_cast<uint32_t>(queue);
+                rate.sample(s);
+            }
+        }
+        r.sent[p] = double(bytes) / 5;
+    }
+    r.budget = control ? rate.budget() : pc.budget;
+    r.interval = control ? rate.interval() : 1;
+    r.backoffs = rate.backoffCount();
+    return r;
+}
+
+static void report(const char* name, const Result& r){
+    infolog << name << ": good " << r.sent[0] << " B/s queue " << r.max_queue[0]
+            << ", degraded " << r.sent[1] << " B/s queue " << r.max_queue[1]
+            << ", recovered " << r.sent[2] << " B/s queue " << r.max_queue[2]
+            << ", final budget " << r.budget << " interval " << r.interval << ", " << r.backoffs << " backoffs";
+}
+
+int main(){
+    Result fixed = run(false);
+    Result adaptive = run(true);
+    report("fixed", fixed);
+    report("adaptive", adaptive);
+    // 降速之后排队的数据量应该远小于固定速率, 恢复之后回到满速
+    bool ok = adaptive.max_queue[1] * 4 < fixed.max_queue[1] && adaptive.sent[1] <= 15000 * 1.2
+        && adaptive.budget == snap::PriorityConfig().budget && adaptive.interval == 1;
+    if (!ok) {
+        errorlog << "failed";
+        return 1;
+    }
+    infolog << "ok";
+    return 0;
+}
+
+// 编译运行
+// flatc --cpp --filename-suffix _fb -o ../../src/flat -I ../../src/flat ../../src/flat/io.fbs ../../src/flat/pack.fbs
+// g++ -O2 -std=c++17 -o rate_control rate_control.cc -I../../src/comm -I../../src/flat -I../../src/snapshot -lflatbuffers -lenet -lpthread
@@ -0,0 +1,109 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include <flatbuffers/flatbuffers.h>
+#include <log.h>
+#include "server.h"
+
+// 客户端经过 Server 控制自己的玩家
+// 两个客户端连到本机的服务器, 进入默认房间时各有一个玩家实体(player_id 是会话 id).
+// 第一个客户端一直向右移动; 第二个客户端只发一个包, 之后因为空闲被断开, 玩家离开房间.
+// 房间里还有一个玩家附近的 NPC 和一个在视野之外的 NPC, 第一个客户端用 DeltaDecoder 还原快照并回传确认.
+// 停止服务器之后检查: 第一个玩家向右移动了, 第二个玩家已经不在房间中, 第一个客户端还原出的状态中有附近的 NPC,
+// 没有视野之外的 NPC.
+
+static const uint16_t port = 18091;
+
+static std::shared_ptr<enet::ENetData> commands(const std::vector<std::pair<uint32_t, int8_t>>& cmds, uint32_t ack = 0){
+    flatbuffers::FlatBufferBuilder fbb;
+    std::vector<flatbuffers::Offset<io::Command>> offsets;
+    for (const auto& c : cmds) {
+        offsets.push_back(io::CreateCommand(fbb, c.first, 1, c.second, 0));
+    }
+    fbb.Finish(io::CreateFrame(fbb, 0, io::DataType_Commands, 0, fbb.CreateVector(offsets), ack));
+    return enet::ENetData::make_data(0, fbb.GetBufferPointer(), fbb.GetSize(), 0);
+}
+
+static bool connected(enet::ENetClient& c){
+    for (int i = 0; i < 200 && c.statu() != enet::Connected; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return c.statu() == enet::Connected;
+}
+
+int main(){
+    server::ServerConfig cfg;
+    cfg.port = port;
+    cfg.world.threads = 1;
+    cfg.encode.threads = 1;
+    cfg.idle_timeout = 300;
+    cfg.spawn_x = 100.0f;
+    cfg.spawn_y = 50.0f;
+    server::Server svr(cfg);
+    uint32_t near = 0, far = 0;
+    std::shared_ptr<world::Room> room = svr.createRoom(cfg.default_room, world::Config(), [&](world::World& w){
+        near = entt::to_integral(w.spawnNpc(cfg.spawn_x + 10.0f, cfg.spawn_y, 0.0f, 0.0f));
+        far = entt::to_integral(w.spawnNpc(cfg.spawn_x + cfg.view_radius * 4, cfg.spawn_y, 0.0f, 0.0f));
+    });
+    svr.start();
+
+    // 会话 id 按连接的顺序分配
+    enet::ENetClient mover("127.0.0.1", port);
+    bool ok = connected(mover);
+    enet::ENetClient idler("127.0.0.1", port);
+    ok = connected(idler) && ok;
+    const uint32_t mover_id = 1, idler_id = 2;
+
+    std::atomic<uint32_t> snapshots{ 0 };
+    std::atomic<uint32_t> ack{ 0 };
+    snap::DeltaDecoder<> state;
+    std::thread reader([&](){
+        std::shared_ptr<enet::ENetData> data;
+        while (mover.read(&data)) {
+            ++snapshots;
+            if (state.apply(flatbuffers::GetRoot<io::DeltaFrame>(data->bytes()))) {
+                ack.store(state.ack());
+            }
+        }
+    });
+
+    idler.send(commands({ { 0, 0 } }));
+    for (uint32_t t = 0; t < 50; ++t) {
+        mover.send(commands({ { 0, 127 } }, ack.load()));
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    // 满输入每秒移动 world::Config::speed, 一秒之后停止; 停止之后房间不再推进, 第一个客户端还连着, 它的玩家还在
+    svr.stop();
+
+    world::World& w = room->world();
+    const entt::entity me = w.findPlayer(mover_id);
+    const world::Position p = me == entt::null ? world::Position{ 0.0f, 0.0f } : w.position(me);
+    infolog << "player " << mover_id << " at (" << p.x << ", " << p.y << "), player " << idler_id
+            << (w.findPlayer(idler_id) == entt::null ? " left" : " still in the room") << ", "
+            << svr.network().idleKicks() << " idle kicks, " << snapshots.load() << " snapshots received";
+    ok = ok && me != entt::null && p.x > cfg.spawn_x + 3.0f && p.y == cfg.spawn_y
+        && w.findPlayer(idler_id) == entt::null && svr.network().idleKicks() == 1 && snapshots.load() > 0;
+
+    mover.quit();
+    reader.join();
+    bool saw_near = false, saw_far = false;
+    for (const io::PackedEntity& e : state.state()) {
+        saw_near = saw_near || e.entity_id() == near;
+        saw_far = saw_far || e.entity_id() == far;
+    }
+    infolog << "client state at tick " << state.ack() << ": " << state.state().size() << " entities, near npc "
+            << (saw_near ? "visible" : "missing") << ", far npc " << (saw_far ? "visible" : "hidden");
+    ok = ok && state.ack() > 0 && saw_near && !saw_far;
+    if (!ok) {
+        errorlog << "failed";
+        return 1;
+    }
+    infolog << "ok";
+    return 0;
+}
+
+// 编译运行
+// flatc --cpp --filename-suffix _fb -o ../../src/flat -I ../../src/flat ../../src/flat/io.fbs ../../src/flat/pack.fbs
+// g++ -O2 -std=c++20 -o server_test server_test.cc ../../src/server/server.cc ../../src/world/world.cc ../../src/world/kinematics.cc ../../src/world/lockstep.cc ../../src/world/record.cc ../../src/world/rooms.cc ../../src/world/checkpoint.cc -I../../src/comm -I../../src/world -I../../src/flat -I../../src/snapshot -I../../src/connect -I../../src/server -lflatbuffers -lenet -lpthread
@@ -0,0 +1,576 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+#include <flatbuffers/flatbuffers.h>
+#include <log.h>
+#include "io_fb.h"
+#include "pack.h"
+#include "frame.pb.h"
+
+// io::Frame 的序列化对比
+// 四种格式: 现有的 flatbuffers table, pack.fbs 的 struct 格式, protobuf, 手写的位压缩格式
+// 实体帧 0~2000 个实体, 指令帧 0~256 条指令, 输出每个元素的编解码耗时, 字节数, 以及每帧的内存分配次数
+// 计时之前每种格式先解码一帧, 逐个字段和原始数据(量化的格式和量化再还原之后的数据)比较, 不一致时报错
+
+// 统计当前线程的内存分配次数, 日志线程的分配不计入
+static thread_local uint64_t alloc_count = 0;
+
+void* operator new(size_t size){
+    ++alloc_count;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+struct Cmd{
+    uint32_t player_id;
+    uint32_t room_id;
+    int8_t move_x;
+    int8_t move_y;
+    bool attack;
+    bool skill1;
+    bool skill2;
+};
+
+// 一帧的原始数据, 实体按列存放, 和 World 的组件数组一致
+struct Data{
+    uint32_t tick = 0;
+    bool command_frame = false;
+    std::vector<uint32_t> id;
+    std::vector<int32_t> hp;
+    std::vector<uint32_t> flags;
+    std::vector<float> x, y, vx, vy;
+    std::vector<Cmd> cmds;
+
+    size_t entities() const { return id.size(); }
+    flat::EntityColumns columns() const {
+        flat::EntityColumns c;
+        c.count = id.size();
+        c.id = id.data();
+        c.hp = hp.data();
+        c.flags = flags.data();
+        c.x = x.data();
+        c.y = y.data();
+        c.vx = vx.data();
+        c.vy = vy.data();
+        return c;
+    }
+};
+
+static uint32_t rnd(){
+    static uint32_t s = 2463534242u;
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    return s;
+}
+static float rndf(float lo, float hi){
+    return lo + (hi - lo) * (rnd() & 0xffffff) / float(0xffffff);
+}
+
+Data makeData(size_t entities, size_t commands, bool command_frame){
+    Data d;
+    d.command_frame = command_frame;
+    uint32_t eid = 0;
+    for (size_t i = 0; i < entities; ++i) {
+        eid += 1 + rnd() % 4;
+        d.id.push_back(eid);
+        d.hp.push_back(rnd() % 1000);
+        d.flags.push_back(flat::Alive | (rnd() & 0xbe));
+        d.x.push_back(rndf(-1000, 1000));
+        d.y.push_back(rndf(-1000, 1000));
+        d.vx.push_back(rndf(-10, 10));
+        d.vy.push_back(rndf(-10, 10));
+    }
+    for (size_t i = 0; i < commands; ++i) {
+        uint32_t b = rnd();
+        d.cmds.push_back(Cmd{ uint32_t(i + 1), 7, int8_t(rnd() % 3 - 1), int8_t(rnd() % 3 - 1), bool(b & 1), bool(b & 2), bool(b & 4) });
+    }
+    return d;
+}
+
+// 量化的格式解码之后应该得到的数据
+static Data quantized(const Data& d){
+    flat::Quantizer q;
+    Data e = d;
+    for (size_t i = 0; i < d.entities(); ++i) {
+        e.hp[i] = flat::clamp16(d.hp[i]);
+        e.flags[i] = uint16_t(d.flags[i]);
+        e.x[i] = q.unposX(q.posX(d.x[i]));
+        e.y[i] = q.unposY(q.posY(d.y[i]));
+        e.vx[i] = q.unvel(q.vel(d.vx[i]));
+        e.vy[i] = q.unvel(q.vel(d.vy[i]));
+    }
+    return e;
+}
+
+// 逐个字段比较, 返回第一个不同的字段, 相同时返回nullptr
+static const char* differ(const Data& a, const Data& b){
+    if (a.tick != b.tick) return "tick";
+    if (a.command_frame != b.command_frame) return "type";
+    if (a.entities() != b.entities()) return "entity count";
+    if (a.cmds.size() != b.cmds.size()) return "command count";
+    for (size_t i = 0; i < a.entities(); ++i) {
+        if (a.id[i] != b.id[i]) return "entity_id";
+        if (a.hp[i] != b.hp[i]) return "hp";
+        if (a.flags[i] != b.flags[i]) return "status_flags";
+        if (a.x[i] != b.x[i] || a.y[i] != b.y[i]) return "position";
+        if (a.vx[i] != b.vx[i] || a.vy[i] != b.vy[i]) return "velocity";
+    }
+    for (size_t i = 0; i < a.cmds.size(); ++i) {
+        const Cmd& x = a.cmds[i];
+        const Cmd& y = b.cmds[i];
+        if (x.player_id != y.player_id) return "player_id";
+        if (x.room_id != y.room_id) return "room_id";
+        if (x.move_x != y.move_x || x.move_y != y.move_y) return "move";
+        if (x.attack != y.attack || x.skill1 != y.skill1 || x.skill2 != y.skill2) return "buttons";
+    }
+    return nullptr;
+}
+
+static void addEntity(Data& d, uint32_t id, int32_t hp, uint32_t flags, float x, float y, float vx, float vy){
+    d.id.push_back(id);
+    d.hp.push_back(hp);
+    d.flags.push_back(flags);
+    d.x.push_back(x);
+    d.y.push_back(y);
+    d.vx.push_back(vx);
+    d.vy.push_back(vy);
+}
+
+// 现有的 Frame, 实体和指令都是 table
+struct FlatTable{
+    const char* name = "flatbuffers table";
+    const bool lossy = false;
+    flatbuffers::FlatBufferBuilder fbb{ 64 * 1024 };
+    std::vector<flatbuffers::Offset<io::Entity>> ents;
+    std::vector<flatbuffers::Offset<io::Command>> cmds;
+
+    size_t encode(const Data& d, uint32_t tick){
+        fbb.Clear();
+        ents.clear();
+        cmds.clear();
+        for (size_t i = 0; i < d.entities(); ++i) {
+            ents.push_back(io::CreateEntity(fbb, d.id[i], d.hp[i], d.flags[i], d.x[i], d.y[i], d.vx[i], d.vy[i]));
+        }
+        for (auto& c : d.cmds) {
+            cmds.push_back(io::CreateCommand(fbb, c.player_id, c.room_id, c.move_x, c.move_y, c.attack, c.skill1, c.skill2));
+        }
+        auto e = fbb.CreateVector(ents);
+        auto c = fbb.CreateVector(cmds);
+        fbb.Finish(io::CreateFrame(fbb, tick, d.command_frame ? io::DataType_Commands : io::DataType_Entitys, e, c));
+        return fbb.GetSize();
+    }
+    uint64_t decode(){
+        flatbuffers::Verifier v(fbb.GetBufferPointer(), fbb.GetSize());
+        if (!v.VerifyBuffer<io::Frame>(nullptr)) return 0;
+        auto f = flatbuffers::GetRoot<io::Frame>(fbb.GetBufferPointer());
+        uint64_t sum = f->tick();
+        if (auto es = f->entities()) {
+            for (uint32_t i = 0; i < es->size(); ++i) {
+                auto e = es->Get(i);
+                sum += e->entity_id() + e->hp() + e->status_flags() + uint64_t(e->x() + e->y() + e->vx() + e->vy());
+            }
+        }
+        if (auto cs = f->commands()) {
+            for (uint32_t i = 0; i < cs->size(); ++i) {
+                auto c = cs->Get(i);
+                sum += c->player_id() + c->move_x() + c->move_y() + c->attack() + c->skill1() + c->skill2();
+            }
+        }
+        return sum;
+    }
+    bool decodeTo(Data& out){
+        flatbuffers::Verifier v(fbb.GetBufferPointer(), fbb.GetSize());
+        if (!v.VerifyBuffer<io::Frame>(nullptr)) return false;
+        auto f = flatbuffers::GetRoot<io::Frame>(fbb.GetBufferPointer());
+        out = Data();
+        out.tick = f->tick();
+        out.command_frame = f->type() == io::DataType_Commands;
+        if (auto es = f->entities()) {
+            for (uint32_t i = 0; i < es->size(); ++i) {
+                auto e = es->Get(i);
+                addEntity(out, e->entity_id(), e->hp(), e->status_flags(), e->x(), e->y(), e->vx(), e->vy());
+            }
+        }
+        if (auto cs = f->commands()) {
+            for (uint32_t i = 0; i < cs->size(); ++i) {
+                auto c = cs->Get(i);
+                out.cmds.push_back(Cmd{ c->player_id(), c->room_id(), c->move_x(), c->move_y(), c->attack(), c->skill1(), c->skill2() });
+            }
+        }
+        return true;
+    }
+};
+
+// pack.fbs, struct + 量化
+struct FlatStruct{
+    const char* name = "flatbuffers struct";
+    const bool lossy = true;
+    flatbuffers::FlatBufferBuilder fbb{ 64 * 1024 };
+    flat::Quantizer q;
+    std::vector<io::PackedCommand> cmds;
+
+    size_t encode(const Data& d, uint32_t tick){
+        fbb.Clear();
+        if (!d.command_frame) {
+            fbb.Finish(flat::createEntityFrame(fbb, tick, q, d.columns()));
+        }else {
+            cmds.clear();
+            for (auto& c : d.cmds) {
+                cmds.emplace_back(c.player_id, c.room_id, c.move_x, c.move_y, flat::packButtons(c.attack, c.skill1, c.skill2));
+            }
+            fbb.Finish(flat::createCommandFrame(fbb, tick, cmds.data(), cmds.size()));
+        }
+        return fbb.GetSize();
+    }
+    uint64_t decode(){
+        flatbuffers::Verifier v(fbb.GetBufferPointer(), fbb.GetSize());
+        if (!v.VerifyBuffer<io::PackedFrame>(nullptr)) return 0;
+        auto f = flatbuffers::GetRoot<io::PackedFrame>(fbb.GetBufferPointer());
+        flat::Quantizer dq = flat::Quantizer::fromWire(f->quant());
+        uint64_t sum = f->tick();
+        if (auto es = f->entities()) {
+            for (uint32_t i = 0; i < es->size(); ++i) {
+                auto e = es->Get(i);
+                sum += e->entity_id() + e->hp() + e->status_flags()
+                    + uint64_t(dq.unposX(e->x()) + dq.unposY(e->y()) + dq.unvel(e->vx()) + dq.unvel(e->vy()));
+            }
+        }
+        if (auto cs = f->commands()) {
+            for (uint32_t i = 0; i < cs->size(); ++i) {
+                auto c = cs->Get(i);
+                sum += c->player_id() + c->move_x() + c->move_y() + c->buttons();
+            }
+        }
+        return sum;
+    }
+    bool decodeTo(Data& out){
+        flatbuffers::Verifier v(fbb.GetBufferPointer(), fbb.GetSize());
+        if (!v.VerifyBuffer<io::PackedFrame>(nullptr)) return false;
+        auto f = flatbuffers::GetRoot<io::PackedFrame>(fbb.GetBufferPointer());
+        flat::Quantizer dq = flat::Quantizer::fromWire(f->quant());
+        out = Data();
+        out.tick = f->tick();
+        out.command_frame = f->type() == io::DataType_Commands;
+        if (auto es = f->entities()) {
+            for (uint32_t i = 0; i < es->size(); ++i) {
+                auto e = es->Get(i);
+                addEntity(out, e->entity_id(), e->hp(), e->status_flags(),
+                    dq.unposX(e->x()), dq.unposY(e->y()), dq.unvel(e->vx()), dq.unvel(e->vy()));
+            }
+        }
+        if (auto cs = f->commands()) {
+            for (uint32_t i = 0; i < cs->size(); ++i) {
+                auto c = cs->Get(i);
+                out.cmds.push_back(Cmd{ c->player_id(), c->room_id(), c->move_x(), c->move_y(),
+                    bool(c->buttons() & flat::Attack), bool(c->buttons() & flat::Skill1), bool(c->buttons() & flat::Skill2) });
+            }
+        }
+        return true;
+    }
+};
+
+struct Proto{
+    const char* name = "protobuf";
+    const bool lossy = false;
+    bench::Frame out;
+    bench::Frame in;
+    std::string buf;
+
+    size_t encode(const Data& d, uint32_t tick){
+        out.Clear();
+        out.set_tick(tick);
+        out.set_type(d.command_frame ? 2 : 1);
+        for (size_t i = 0; i < d.entities(); ++i) {
+            auto e = out.add_entities();
+            e->set_entity_id(d.id[i]);
+            e->set_hp(d.hp[i]);
+            e->set_status_flags(d.flags[i]);
+            e->set_x(d.x[i]);
+            e->set_y(d.y[i]);
+            e->set_vx(d.vx[i]);
+            e->set_vy(d.vy[i]);
+        }
+        for (auto& c : d.cmds) {
+            auto m = out.add_commands();
+            m->set_player_id(c.player_id);
+            m->set_room_id(c.room_id);
+            m->set_move_x(c.move_x);
+            m->set_move_y(c.move_y);
+            m->set_attack(c.attack);
+            m->set_skill1(c.skill1);
+            m->set_skill2(c.skill2);
+        }
+        out.SerializeToString(&buf);
+        return buf.size();
+    }
+    uint64_t decode(){
+        if (!in.ParseFromString(buf)) return 0;
+        uint64_t sum = in.tick();
+        for (auto& e : in.entities()) {
+            sum += e.entity_id() + e.hp() + e.status_flags() + uint64_t(e.x() + e.y() + e.vx() + e.vy());
+        }
+        for (auto& c : in.commands()) {
+            sum += c.player_id() + c.move_x() + c.move_y() + c.attack() + c.skill1() + c.skill2();
+        }
+        return sum;
+    }
+    bool decodeTo(Data& d){
+        if (!in.ParseFromString(buf)) return false;
+        d = Data();
+        d.tick = in.tick();
+        d.command_frame = in.type() == 2;
+        for (auto& e : in.entities()) {
+            addEntity(d, e.entity_id(), e.hp(), e.status_flags(), e.x(), e.y(), e.vx(), e.vy());
+        }
+        for (auto& c : in.commands()) {
+            d.cmds.push_back(Cmd{ c.player_id(), c.room_id(), int8_t(c.move_x()), int8_t(c.move_y()), c.attack(), c.skill1(), c.skill2() });
+        }
+        return true;
+    }
+};
+
+// 手写的位压缩格式
+// 头: tick 32 | 实体数 16 | 指令数 16 | 类型 1
+// 实体: id差值(5位长度 + 变长) | hp 16 | flags 8 | x y vx vy 各16(与struct格式同样的量化)
+// 指令: player_id 32 | room_id 32 | move_x move_y 各8 | buttons 3
+struct BitCodec{
+    const char* name = "bit-packed";
+    const bool lossy = true;
+    std::vector<uint8_t> buf;
+    flat::Quantizer q;
+
+    struct Writer{
+        std::vector<uint8_t>& out;
+        uint64_t acc = 0;
+        int bits = 0;
+        void put(uint32_t v, int n){
+            acc |= uint64_t(v & (n == 32 ? 0xffffffffu : ((1u << n) - 1))) << bits;
+            bits += n;
+            while (bits >= 8) {
+                out.push_back(uint8_t(acc));
+                acc >>= 8;
+                bits -= 8;
+            }
+        }
+        void flush(){
+            if (bits) out.push_back(uint8_t(acc));
+            acc = 0;
+            bits = 0;
+        }
+    };
+    struct Reader{
+        const uint8_t* p;
+        const uint8_t* end;
+        uint64_t acc = 0;
+        int bits = 0;
+        uint32_t get(int n){
+            while (bits < n) {
+                uint64_t b = p < end ? *p++ : 0;
+                acc |= b << bits;
+                bits += 8;
+            }
+            uint32_t v = uint32_t(acc & (n == 32 ? 0xffffffffu : ((1u << n) - 1)));
+            acc >>= n;
+            bits -= n;
+            return v;
+        }
+    };
+    static int width(uint32_t v){
+        int n = 0;
+        while (v) { ++n; v >>= 1; }
+        return n;
+    }
+
+    size_t encode(const Data& d, uint32_t tick){
+        buf.clear();
+        Writer w{ buf };
+        w.put(tick, 32);
+        w.put(uint32_t(d.entities()), 16);
+        w.put(uint32_t(d.cmds.size()), 16);
+        w.put(d.command_frame, 1);
+        uint32_t prev = 0;
+        for (size_t i = 0; i < d.entities(); ++i) {
+            uint32_t delta = d.id[i] - prev;
+            prev = d.id[i];
+            int n = width(delta);
+            w.put(n, 5);
+            if (n) w.put(delta, n);
+            w.put(uint16_t(flat::clamp16(d.hp[i])), 16);
+            w.put(d.flags[i], 8);
+            w.put(uint16_t(q.posX(d.x[i])), 16);
+            w.put(uint16_t(q.posY(d.y[i])), 16);
+            w.put(uint16_t(q.vel(d.vx[i])), 16);
+            w.put(uint16_t(q.vel(d.vy[i])), 16);
+        }
+        for (auto& c : d.cmds) {
+            w.put(c.player_id, 32);
+            w.put(c.room_id, 32);
+            w.put(uint8_t(c.move_x), 8);
+            w.put(uint8_t(c.move_y), 8);
+            w.put(flat::packButtons(c.attack, c.skill1, c.skill2), 3);
+        }
+        w.flush();
+        return buf.size();
+    }
+    uint64_t decode(){
+        Reader r{ buf.data(), buf.data() + buf.size() };
+        uint64_t sum = r.get(32);
+        uint32_t ne = r.get(16);
+        uint32_t nc = r.get(16);
+        sum += r.get(1);
+        uint32_t id = 0;
+        for (uint32_t i = 0; i < ne; ++i) {
+            int n = r.get(5);
+            id += n ? r.get(n) : 0;
+            int16_t hp = int16_t(r.get(16));
+            uint32_t flags = r.get(8);
+            float x = q.unposX(int16_t(r.get(16)));
+            float y = q.unposY(int16_t(r.get(16)));
+            float vx = q.unvel(int16_t(r.get(16)));
+            float vy = q.unvel(int16_t(r.get(16)));
+            sum += id + hp + flags + uint64_t(x + y + vx + vy);
+        }
+        for (uint32_t i = 0; i < nc; ++i) {
+            sum += r.get(32);
+            r.get(32);
+            sum += int8_t(r.get(8)) + int8_t(r.get(8)) + r.get(3);
+        }
+        return sum;
+    }
+    bool decodeTo(Data& d){
+        Reader r{ buf.data(), buf.data() + buf.size() };
+        d = Data();
+        d.tick = r.get(32);
+        uint32_t ne = r.get(16);
+        uint32_t nc = r.get(16);
+        d.command_frame = r.get(1);
+        uint32_t id = 0;
+        for (uint32_t i = 0; i < ne; ++i) {
+            int n = r.get(5);
+            id += n ? r.get(n) : 0;
+            int16_t hp = int16_t(r.get(16));
+            uint32_t flags = r.get(8);
+            float x = q.unposX(int16_t(r.get(16)));
+            float y = q.unposY(int16_t(r.get(16)));
+            float vx = q.unvel(int16_t(r.get(16)));
+            float vy = q.unvel(int16_t(r.get(16)));
+            addEntity(d, id, hp, flags, x, y, vx, vy);
+        }
+        for (uint32_t i = 0; i < nc; ++i) {
+            Cmd c;
+            c.player_id = r.get(32);
+            c.room_id = r.get(32);
+            c.move_x = int8_t(r.get(8));
+            c.move_y = int8_t(r.get(8));
+            uint32_t b = r.get(3);
+            c.attack = b & flat::Attack;
+            c.skill1 = b & flat::Skill1;
+            c.skill2 = b & flat::Skill2;
+            d.cmds.push_back(c);
+        }
+        return r.p <= r.end;
+    }
+};
+
+// 阻止编译器把循环中不变的解码提到循环外面
+static inline void clobber(){
+    asm volatile("" : : : "memory");
+}
+
+static bool failed = false;
+
+// 解码一帧和原始数据比较, 编解码有错时计时没有意义
+template<class Codec>
+bool check(Codec& codec, const Data& d){
+    Data want = codec.lossy ? quantized(d) : d;
+    want.tick = 1;
+    Data got;
+    codec.encode(d, 1);
+    const char* field = codec.decodeTo(got) ? differ(got, want) : "frame";
+    if (field) {
+        errorlog("{} round trip of {} entities and {} commands: {} differs", codec.name, d.entities(), d.cmds.size(), field);
+        failed = true;
+        return false;
+    }
+    return true;
+}
+
+template<class Codec>
+void run(Codec& codec, const Data& d, size_t items){
+    if (!check(codec, d)) {
+        return;
+    }
+    const int iters = int(std::max<size_t>(20, 400000 / (items + 1)));
+    using clock = std::chrono::steady_clock;
+    uint32_t tick = 1;
+    // 预热, 让复用的缓冲区长到稳定的大小
+    for (int i = 0; i < 10; ++i) {
+        codec.encode(d, tick++);
+        codec.decode();
+    }
+
+    size_t bytes = 0;
+    uint64_t sum = 0;
+    uint64_t allocs = alloc_count;
+    auto t0 = clock::now();
+    for (int i = 0; i < iters; ++i) {
+        bytes = codec.encode(d, tick++);
+        clobber();
+    }
+    auto t1 = clock::now();
+    for (int i = 0; i < iters; ++i) {
+        sum += codec.decode();
+        clobber();
+    }
+    auto t2 = clock::now();
+    allocs = alloc_count - allocs;
+
+    double enc = std::chrono::duration<double, std::nano>(t1 - t0).count() / iters;
+    double dec = std::chrono::duration<double, std::nano>(t2 - t1).count() / iters;
+    size_t per = items ? items : 1;
+    infolog("{} items {} | encode {} ns/item | decode {} ns/item | {} bytes/item ({} bytes) | {} allocs/frame | {}",
+        codec.name, items, enc / per, dec / per, double(bytes) / per, bytes, double(allocs) / iters, sum ? "" : "(empty)");
+}
+
+template<class... Codecs>
+void runAll(const Data& d, size_t items, Codecs&... codecs){
+    (run(codecs, d, items), ...);
+}
+
+int main() {
+    FlatTable table;
+    FlatStruct packed;
+    Proto proto;
+    BitCodec bits;
+
+    infolog << "---- entity frames ----";
+    for (size_t n : { 0, 1, 10, 100, 500, 1000, 2000 }) {
+        Data d = makeData(n, 0, false);
+        runAll(d, n, table, packed, proto, bits);
+    }
+    infolog << "---- command frames ----";
+    for (size_t n : { 0, 1, 16, 64, 256 }) {
+        Data d = makeData(0, n, true);
+        runAll(d, n, table, packed, proto, bits);
+    }
+    if (failed) {
+        errorlog << "failed";
+        return 1;
+    }
+    infolog << "ok";
+    return 0;
+}
+
+// 编译运行
+// protoc --cpp_out=. -I./ ./frame.proto
+// flatc --cpp --filename-suffix _fb -o ../../src/flat -I ../../src/flat ../../src/flat/io.fbs ../../src/flat/pack.fbs
+// g++ -O2 -std=c++17 -o frame_bench frame_bench.cc frame.pb.cc -I../../src/comm -I../../src/flat -lflatbuffers -lprotobuf -lpthread
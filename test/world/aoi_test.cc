@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <log.h>
+#include "aoi.h"
+#include "world.h"
+
+// AOI 的进入和离开集合
+// 玩家停在原点, 视野半径 30. 一个 NPC 从 (-60, 0.5) 以每秒 30 向右穿过视野, 一个 NPC 停在 (10, 10) 一直可见,
+// 一个 NPC 停在 (100, 0) 一直不可见, 一个视野内的 NPC 在中途被销毁.
+// 每个tick检查可见集合和按距离算出来的一致, 越过半径的那个tick出现在进入或离开集合中, 其余tick不出现.
+
+using namespace world;
+
+static const float radius = 30.0f;
+
+static bool contains(const std::vector<uint32_t>& v, uint32_t id){
+    return std::binary_search(v.begin(), v.end(), id);
+}
+
+template<class V>
+static bool has(const V& v, uint32_t id){
+    return std::find(v.begin(), v.end(), id) != v.end();
+}
+
+int main(){
+    World w;
+    const entt::entity me = w.spawn(1, 0.0f, 0.0f);
+    const entt::entity mover = w.spawnNpc(-60.0f, 0.5f, 30.0f, 0.0f);
+    const entt::entity still = w.spawnNpc(10.0f, 10.0f, 0.0f, 0.0f);
+    const entt::entity far = w.spawnNpc(100.0f, 0.0f, 0.0f, 0.0f);
+    entt::entity doomed = w.spawnNpc(-5.0f, 5.0f, 0.0f, 0.0f);
+    const uint32_t doomed_id = entt::to_integral(doomed);
+    const std::vector<entt::entity> tracked{ me, mover, still, far };
+
+    Interest aoi(radius);
+    std::vector<bool> was(tracked.size(), false);
+    bool was_doomed = false;
+    uint32_t enters = 0, leaves = 0;
+    bool ok = true;
+    for (int t = 0; t < 120; ++t) {
+        if (t == 40) {
+            w.despawn(doomed);
+            doomed = entt::null;
+        }
+        w.tick();
+        aoi.update(w.spatial(), 0.0f, 0.0f, &w.arena());
+        const std::vector<uint32_t>& visible = aoi.visibleIds();
+        for (size_t i = 0; i < tracked.size(); ++i) {
+            const uint32_t id = entt::to_integral(tracked[i]);
+            const Position p = w.position(tracked[i]);
+            const bool in = p.x * p.x + p.y * p.y <= radius * radius;
+            const bool entered = has(aoi.enterIds(), id), left = has(aoi.leaveIds(), id);
+            if (contains(visible, id) != in || entered != (in && !was[i]) || left != (!in && was[i])) {
+                errorlog << "tick " << t << ": entity " << id << " at (" << p.x << ", " << p.y << ") visible "
+                         << contains(visible, id) << " entered " << entered << " left " << left;
+                ok = false;
+            }
+            if (tracked[i] == mover) {
+                enters += entered;
+                leaves += left;
+            }
+            was[i] = in;
+        }
+        const bool in = doomed != entt::null;
+        if (contains(visible, doomed_id) != in || has(aoi.leaveIds(), doomed_id) != (!in && was_doomed)) {
+            errorlog << "tick " << t << ": despawned entity " << doomed_id << " still tracked";
+            ok = false;
+        }
+        was_doomed = in;
+        // 可见集合从快照中取出的实体一个不少
+        FrameVector<io::PackedEntity> out(&w.arena());
+        w.gather(visible, out);
+        ok = ok && out.size() == visible.size();
+    }
+    infolog << "mover entered " << enters << " and left " << leaves << " times, " << aoi.visibleIds().size() << " visible at the end";
+    ok = ok && enters == 1 && leaves == 1 && !was[1] && was[2] && !was[3];
+    if (!ok) {
+        errorlog << "failed";
+        return 1;
+    }
+    infolog << "ok";
+    return 0;
+}
+
+// 编译运行
+// flatc --cpp --filename-suffix _fb -o ../../src/flat -I ../../src/flat ../../src/flat/io.fbs ../../src/flat/pack.fbs
+// g++ -O2 -std=c++20 -o aoi_test aoi_test.cc ../../src/world/world.cc ../../src/world/kinematics.cc ../../src/world/record.cc ../../src/world/checkpoint.cc -I../../src/comm -I../../src/world -I../../src/flat -I../../src/snapshot -I../../src/connect -lflatbuffers -lpthread
@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <vector>
+#include <log.h>
+#include "aoi.h"
+#include "delta.h"
+#include "world.h"
+
+// 稳定状态下的tick不调用全局分配器
+// 替换全局的 operator new 计数, 预热之后驱动 World 跑若干tick: 移动, 战斗, 迟到的输入,
+// 每个客户端的 AOI 查询和快照收集(收集到 FrameVector), 统计这段时间内的分配次数.
+// 多线程的一轮实体数超过 world.cc 中 parallelFor 的粒度(4096), 移动和快照量化真正切块分给工作线程.
+
+using namespace world;
+
+static std::atomic<uint64_t> global_allocs{ 0 };
+
+void* operator new(size_t n){
+    global_allocs.fetch_add(1, std::memory_order_relaxed);
+    void* p = std::malloc(n ? n : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void* operator new[](size_t n){
+    return operator new(n);
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+static const uint32_t players = 200;
+static const uint32_t npcs = 1800;
+static const uint32_t split_npcs = 3 * 4096;  // 多于 world.cc 中的 parallel_grain, 切成多块
+static const int warmup = 800;  // 网格的格子和可见集合要运行一段时间才达到容量的高水位
+static const int rounds = 300;
+
+static bool run(uint32_t threads, uint32_t npcs){
+    Config cfg;
+    cfg.threads = threads;
+    // 实体集中在地图中间 300x300 的范围内, 那里的格子比整个地图的平均密度高, 按两倍实体数预留
+    cfg.reserve = std::max<size_t>(cfg.reserve, 2 * (players + npcs));
+    cfg.min_x = cfg.min_y = -200.0f;
+    cfg.max_x = cfg.max_y = 200.0f;
+    World w(cfg);
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> pos(-150.0f, 150.0f);
+    std::uniform_real_distribution<float> vel(-3.0f, 3.0f);
+    for (uint32_t i = 0; i < players; ++i) {
+        w.spawn(i + 1, pos(rng), pos(rng));
+    }
+    for (uint32_t i = 0; i < npcs; ++i) {
+        w.spawnNpc(pos(rng), pos(rng), vel(rng), vel(rng));
+    }
+    std::vector<Interest> aoi(players, Interest(30.0f));
+
+    std::uniform_int_distribution<int> mv(-127, 127);
+    std::uniform_int_distribution<int> bt(0, 7);
+    uint64_t before = 0;
+    for (int t = 0; t < warmup + rounds; ++t) {
+        if (t == warmup) {
+            before = global_allocs.load();
+        }
+        const uint32_t now = w.currentTick();
+        w.input().produce([&](InputBuffer& in){
+            for (uint32_t p = 0; p < players; ++p) {
+                // 每隔几个tick有一个玩家的输入迟到两个tick
+                uint32_t tk = (p + t) % 16 == 0 && now > 2 ? now - 2 : 0;
+                in.push(p + 1, int8_t(mv(rng)), int8_t(mv(rng)), uint8_t(t % 2 ? bt(rng) : 0), tk, now);
+            }
+        });
+        w.tick();
+        FrameVector<io::PackedEntity> out(&w.arena());
+        for (uint32_t p = 0; p < players; ++p) {
+            Position at = w.position(w.findPlayer(p + 1));
+            aoi[p].update(w.spatial(), at.x, at.y, &w.arena());
+            out.clear();
+            w.gather(aoi[p].visibleIds(), out);
+        }
+    }
+    uint64_t allocs = global_allocs.load() - before;
+    const ArenaStats& s = w.arenaStats();
+    infolog << "threads " << threads << ", " << players + npcs << " entities: global allocations in " << rounds << " ticks: " << allocs
+            << ", arena per tick: " << s.allocations << " allocations, " << s.bytes << " bytes, peak "
+            << s.peak << ", upstream blocks " << s.upstream;
+    return allocs == 0;
+}
+
+int main(){
+    bool ok = run(0, npcs);
+    ok = run(2, split_npcs) && ok;
+    if (!ok) {
+        errorlog << "steady-state ticks still call the global allocator";
+        return 1;
+    }
+    infolog << "ok";
+    return 0;
+}
+
+// 编译运行
+// flatc --cpp --filename-suffix _fb -o ../../src/flat -I ../../src/flat ../../src/flat/io.fbs ../../src/flat/pack.fbs
+// g++ -O2 -std=c++20 -o arena_test arena_test.cc ../../src/world/world.cc ../../src/world/kinematics.cc ../../src/world/record.cc ../../src/world/checkpoint.cc -I../../src/comm -I../../src/world -I../../src/flat -I../../src/snapshot -I../../src/connect -lflatbuffers -lpthread
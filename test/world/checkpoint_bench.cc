@@ -0,0 +1,180 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <log.h>
+#include "world.h"
+
+// 检查点
+// 100000 个 NPC 和 200 个玩家的房间, 玩家每个tick随机移动和攻击:
+// 1. 保存再恢复到新的 World, 状态哈希相同; 之后两个房间用同样的输入继续, 每个tick的哈希都相同
+// 2. 每个tick都保存检查点时 world 线程只付出一次拷贝, 和后台写文件的耗时比较
+// 3. 从文件(只读映射)恢复的耗时
+// 4. 损坏的检查点恢复失败
+// 技能有冷却, 检查点中有冷却中的技能和未到期的定时器; 历史只恢复检查点这一帧, 输入确认的是上一个tick.
+
+using namespace world;
+using clock_type = std::chrono::steady_clock;
+
+static const size_t npcs = 100000;
+static const uint32_t players = 200;
+
+static double since(clock_type::time_point begin){
+    return std::chrono::duration<double, std::micro>(clock_type::now() - begin).count();
+}
+
+static Config config(){
+    Config cfg;
+    cfg.skill1_cooldown = 1.0f;
+    cfg.skill2_cooldown = 3.0f;
+    return cfg;
+}
+
+static void init(World& w){
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> pos(-1000.0f, 1000.0f);
+    std::uniform_real_distribution<float> vel(-3.0f, 3.0f);
+    for (size_t i = 0; i < npcs; ++i) {
+        w.spawnNpc(pos(rng), pos(rng), vel(rng), vel(rng));
+    }
+    for (uint32_t pid = 1; pid <= players; ++pid) {
+        w.spawn(pid, pos(rng) * 0.05f, pos(rng) * 0.05f);
+    }
+}
+
+// 两个房间要收到相同的输入, 输入由tick决定
+static void feed(World& w){
+    const uint32_t t = w.currentTick() + 1;
+    std::mt19937 rng(t);
+    w.input().produce([&](InputBuffer& in){
+        for (uint32_t pid = 1; pid <= players; ++pid) {
+            in.push(pid, int8_t(rng() % 255 - 127), int8_t(rng() % 255 - 127), uint8_t(rng() % 8), 0, t - 1);
+        }
+    });
+}
+
+static bool roundTrip(){
+    World a(config());
+    init(a);
+    for (uint32_t t = 0; t < 60; ++t) {
+        feed(a);
+        a.tick();
+    }
+    std::vector<uint8_t> image;
+    auto begin = clock_type::now();
+    a.saveCheckpoint(image);
+    const double save_us = since(begin);
+
+    World b(config());
+    // 恢复之前已有的实体被替换
+    b.spawnNpc(0.0f, 0.0f, 0.0f, 0.0f);
+    begin = clock_type::now();
+    bool ok = b.restore(image.data(), image.size());
+    const double restore_us = since(begin);
+    ok = ok && b.currentTick() == a.currentTick() && b.stateHash() == a.stateHash() && b.findPlayer(1) == a.findPlayer(1);
+    ok = ok && a.pendingTimers() != 0 && b.pendingTimers() == a.pendingTimers();
+    infolog << "checkpoint of " << npcs + players << " entities and " << a.pendingTimers() << " timers: " << image.size()
+            << " bytes, save " << save_us << " us, restore " << restore_us << " us";
+
+    uint32_t diverged = 0;
+    for (uint32_t t = 0; ok && t < 120; ++t) {
+        feed(a);
+        feed(b);
+        a.tick();
+        b.tick();
+        if (a.stateHash() != b.stateHash()) {
+            diverged = a.currentTick();
+            break;
+        }
+    }
+    infolog << "continued 120 ticks after restore, " << (diverged ? "diverged at tick " + std::to_string(diverged) : "identical");
+    return ok && diverged == 0;
+}
+
+static bool background(const std::string& path){
+    World w(config());
+    init(w);
+    double plain = 0;
+    for (uint32_t t = 0; t < 30; ++t) {
+        feed(w);
+        auto begin = clock_type::now();
+        w.tick();
+        plain += since(begin);
+    }
+
+    CheckpointWriter writer;
+    writer.start();
+    w.setCheckpoint(&writer, path, 1);
+    double saving = 0;
+    uint64_t copy_ns = 0;
+    for (uint32_t t = 0; t < 30; ++t) {
+        feed(w);
+        auto begin = clock_type::now();
+        w.tick();
+        saving += since(begin);
+        copy_ns += w.checkpointStats().copy_ns;
+    }
+    w.setCheckpoint(nullptr, path, 0);
+
+    // 单独测一次写文件的耗时
+    CheckpointImage img;
+    w.saveCheckpoint(img.bytes);
+    img.path = path;
+    img.busy.store(true);
+    const uint64_t before = writer.written();
+    auto begin = clock_type::now();
+    writer.submit(&img);
+    while (img.busy.load()) {
+        std::this_thread::yield();
+    }
+    const double write_us = since(begin);
+    writer.stop();
+
+    const CheckpointStats& s = w.checkpointStats();
+    infolog << "tick " << plain / 30 << " us without checkpoints, " << saving / 30 << " us saving every tick ("
+            << copy_ns / 30 / 1000.0 << " us copying); writing a checkpoint takes " << write_us << " us";
+    infolog << "checkpoints saved " << s.saved << ", skipped " << s.skipped << ", written " << writer.written()
+            << ", failed " << writer.failed();
+    return s.saved + s.skipped == 30 && s.saved > 0 && writer.written() == before + 1 && writer.failed() == 0;
+}
+
+static bool fromFile(const std::string& path){
+    World w(config());
+    auto begin = clock_type::now();
+    bool ok = CheckpointFile::exists(path) && w.restore(path);
+    const double us = since(begin);
+    infolog << "restored " << w.kinematics().size() << " entities at tick " << w.currentTick() << " from file in " << us << " us";
+    ok = ok && w.kinematics().size() == npcs + players && w.findPlayer(players) != entt::null;
+
+    // 坏的检查点不能恢复
+    World a(config());
+    init(a);
+    std::vector<uint8_t> image;
+    a.saveCheckpoint(image);
+    image[image.size() / 2] ^= 0x5a;
+    World b(config());
+    ok = ok && !b.restore(image.data(), image.size()) && b.kinematics().size() == 0;
+    ok = ok && !b.restore(image.data(), image.size() - 8);
+    return ok;
+}
+
+int main(){
+    const std::string path = "checkpoint_bench.ckpt";
+    bool ok = roundTrip();
+    ok = background(path) && ok;
+    ok = fromFile(path) && ok;
+    std::remove(path.c_str());
+    if (!ok) {
+        errorlog << "failed";
+        return 1;
+    }
+    infolog << "ok";
+    return 0;
+}
+
+// 编译运行
+// flatc --cpp --filename-suffix _fb -o ../../src/flat -I ../../src/flat ../../src/flat/io.fbs ../../src/flat/pack.fbs
+// g++ -O2 -std=c++20 -o checkpoint_bench checkpoint_bench.cc ../../src/world/world.cc ../../src/world/kinematics.cc ../../src/world/record.cc ../../src/world/checkpoint.cc -I../../src/comm -I../../src/world -I../../src/flat -I../../src/snapshot -I../../src/connect -lflatbuffers -lpthread
@@ -0,0 +1,124 @@
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include <log.h>
+#include "world.h"
+
+// 攻击和技能的碰撞检测
+// 2000 个玩家挤在 200x200 的场地里, 每两个tick每个人按下一次随机的攻击或技能,
+// 输出 combat 系统的平均耗时, 并和逐对检测(O(n^2))的命中数比较.
+
+using namespace world;
+
+static const size_t entities = 2000;
+static const float arena = 100.0f;
+static const int rounds = 200;
+
+struct Press{
+    uint32_t player_id;
+    int8_t mx, my;
+    uint8_t buttons;
+};
+
+static Config makeConfig(){
+    Config cfg;
+    cfg.spawn_hp = 1 << 30; // 不让实体死亡, 每个tick的目标数保持不变
+    cfg.history = 0;        // 逐对检测用的是当前位置
+    return cfg;
+}
+
+// 偶数tick按下, 奇数tick松开, 保证每次都是新按下的动作
+static void feed(World& w, std::mt19937& rng, std::vector<Press>& pressed){
+    std::uniform_int_distribution<int> mv(-127, 127);
+    std::uniform_int_distribution<int> bt(1, 7);
+    const bool down = w.currentTick() % 2 == 0;
+    pressed.clear();
+    w.input().produce([&](InputBuffer& in){
+        for (size_t i = 0; i < entities; ++i) {
+            Press p{ uint32_t(i + 1), int8_t(mv(rng)), int8_t(mv(rng)), uint8_t(down ? bt(rng) : 0) };
+            in.push(p.player_id, p.mx, p.my, p.buttons);
+            if (p.buttons) {
+                pressed.push_back(p);
+            }
+        }
+    });
+}
+
+// 逐对检测, 和 World 中的判定规则相同
+static size_t naive(const World& w, const std::vector<Press>& pressed){
+    const Config& cfg = w.config();
+    const Real attack_range = Real(cfg.attack_range);
+    const Real skill_range = Real(cfg.skill_range);
+    const Real radius = Real(cfg.body_radius);
+    // 直接用运动学数据中的 Real 坐标, 和 World 中的判定逐位相同
+    std::vector<Real> xs(entities), ys(entities);
+    for (size_t i = 0; i < entities; ++i) {
+        uint32_t slot = w.registry().get<Body>(w.findPlayer(uint32_t(i + 1))).slot;
+        xs[i] = w.kinematics().x()[slot];
+        ys[i] = w.kinematics().y()[slot];
+    }
+    size_t hits = 0;
+    for (const Press& p : pressed) {
+        const Real ax = xs[p.player_id - 1], ay = ys[p.player_id - 1];
+        std::vector<Shape> shapes;
+        if (p.buttons & flat::Attack) shapes.push_back(Shape::circle(ax, ay, attack_range));
+        if (p.buttons & flat::Skill1) shapes.push_back(Shape::circle(ax, ay, skill_range));
+        if (p.buttons & flat::Skill2) shapes.push_back(Shape::ahead(ax, ay, p.mx, p.my, skill_range));
+        for (const Shape& s : shapes) {
+            for (size_t j = 0; j < entities; ++j) {
+                RealSq d2;
+                if (j + 1 != p.player_id && s.overlaps(xs[j], ys[j], radius, d2)) {
+                    ++hits;
+                }
+            }
+        }
+    }
+    return hits;
+}
+
+int main(){
+    using clock = std::chrono::steady_clock;
+    World w(makeConfig());
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> pos(-arena, arena);
+    for (size_t i = 0; i < entities; ++i) {
+        w.spawn(uint32_t(i + 1), pos(rng), pos(rng));
+    }
+    // combat 在 pipeline 中的下标
+    size_t combat = 0;
+    while (w.systems()[combat].name != "combat") {
+        ++combat;
+    }
+
+    std::vector<Press> pressed;
+    uint64_t combat_ns = 0, naive_ns = 0, max_ns = 0;
+    size_t contacts = 0;
+    int checked = 0;
+    for (int r = 0; r < rounds; ++r) {
+        feed(w, rng, pressed);
+        w.tick();
+        uint64_t ns = w.stats().system_ns[combat];
+        combat_ns += ns;
+        max_ns = std::max(max_ns, ns);
+        contacts += w.contacts().size();
+
+        auto begin = clock::now();
+        size_t expect = naive(w, pressed);
+        naive_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - begin).count();
+        if (expect != w.contacts().size()) {
+            errorlog << "tick " << w.currentTick() << " contacts " << w.contacts().size() << " expect " << expect;
+            return 1;
+        }
+        ++checked;
+    }
+    infolog << "entities: " << entities << ", contacts per tick: " << contacts / rounds;
+    infolog << "combat avg: " << combat_ns / rounds / 1000.0 << " us, max: " << max_ns / 1000.0 << " us";
+    infolog << "naive avg:  " << naive_ns / rounds / 1000.0 << " us";
+    infolog << checked << " ticks match";
+    return 0;
+}
+
+// 编译运行
+// flatc --cpp --filename-suffix _fb -o ../../src/flat -I ../../src/flat ../../src/flat/io.fbs ../../src/flat/pack.fbs
+// g++ -O2 -std=c++20 -o collision_bench collision_bench.cc ../../src/world/world.cc ../../src/world/kinematics.cc ../../src/world/record.cc ../../src/world/checkpoint.cc -I../../src/comm -I../../src/world -I../../src/flat -I../../src/snapshot -I../../src/connect -lflatbuffers -lpthread
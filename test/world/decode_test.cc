@@ -0,0 +1,73 @@
+#include <cstdint>
+#include <vector>
+#include <flatbuffers/flatbuffers.h>
+#include <log.h>
+#include "decode.h"
+
+// 指令按会话绑定玩家
+// 会话 5 在房间 1 中发一个包: 自己的指令, player_id 填 0 的指令, 冒充玩家 6 的指令和发往别的房间的指令.
+// 冒充的指令被拒绝, 其余写入房间的输入队列时都记在玩家 5 上, 合并成一条.
+
+using namespace world;
+
+static const uint32_t session = 5;
+static const uint32_t room = 1;
+
+struct Cmd{
+    uint32_t player_id;
+    uint32_t room_id;
+    int8_t move_x;
+    bool attack;
+};
+
+static void build(flatbuffers::FlatBufferBuilder& fbb, const std::vector<Cmd>& cmds){
+    std::vector<flatbuffers::Offset<io::Command>> offsets;
+    for (const Cmd& c : cmds) {
+        offsets.push_back(io::CreateCommand(fbb, c.player_id, c.room_id, c.move_x, 0, c.attack));
+    }
+    fbb.Finish(io::CreateFrame(fbb, 10, io::DataType_Commands, 0, fbb.CreateVector(offsets), 3));
+}
+
+int main(){
+    conn::Decoder decoder;
+    InputQueue queue;
+    auto route = [&queue](uint32_t id) -> InputQueue* {
+        return id == room ? &queue : nullptr;
+    };
+
+    flatbuffers::FlatBufferBuilder fbb;
+    build(fbb, {
+        { session, room, 10, false },
+        { 0, room, 20, false },
+        { 6, room, -50, true },
+        { 6, room, -60, true },
+        { session, 2, 30, false },
+    });
+    conn::Decoded info;
+    bool ok = decoder.decode(fbb.GetBufferPointer(), fbb.GetSize(), session, route, &info);
+
+    const InputBuffer& in = queue.consume();
+    ok = ok && in.size() == 1 && in.player_id[0] == session && in.move_x[0] == 20 && in.buttons[0] == 0
+        && in.tick[0] == 10 && in.ack[0] == 3;
+    ok = ok && info.commands == 2 && decoder.decodedCommands() == 2 && decoder.rejectedCommands() == 2
+        && decoder.unroutedCommands() == 1 && decoder.mergedCommands() == 1;
+    infolog << "decoded " << decoder.decodedCommands() << ", rejected " << decoder.rejectedCommands()
+            << ", unrouted " << decoder.unroutedCommands() << ", merged " << decoder.mergedCommands();
+
+    // 只冒充别人的包不写入任何指令
+    fbb.Clear();
+    build(fbb, { { 6, room, -70, true } });
+    ok = decoder.decode(fbb.GetBufferPointer(), fbb.GetSize(), session, route, &info) && ok;
+    ok = ok && info.commands == 0 && queue.consume().size() == 0 && decoder.rejectedCommands() == 3;
+
+    if (!ok) {
+        errorlog << "failed";
+        return 1;
+    }
+    infolog << "ok";
+    return 0;
+}
+
+// 编译运行
+// flatc --cpp --filename-suffix _fb -o ../../src/flat -I ../../src/flat ../../src/flat/io.fbs ../../src/flat/pack.fbs
+// g++ -O2 -std=c++20 -o decode_test decode_test.cc -I../../src/comm -I../../src/world -I../../src/flat -I../../src/connect -lflatbuffers -lpthread
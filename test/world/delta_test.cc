@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <vector>
+#include <log.h>
+#include "delta.h"
+
+// 增量快照的往返
+// 服务器一侧的实体每个tick随机改动字段, 出生和消失; DeltaEncoder 编码之后经过一个会丢包的链路交给 DeltaDecoder,
+// 客户端的确认晚几个tick才回到服务器. 中途有一段连续丢包超过快照环的长度(基线过期, 退化为全量帧),
+// 有几个tick不发快照, 有的帧重复到达, 还有一次 reset() 强制全量帧. 夹杂伪造的 ack: 没发出过的tick, 很大的tick, 不在环里的tick.
+// 每次还原成功时客户端的状态和这个tick交给编码器的实体完全一致; 还原失败时状态不变.
+
+static const int rounds = 400;
+static const uint32_t lag = 3;
+static const size_t ring = 32;
+
+static bool same(const io::PackedEntity& a, const io::PackedEntity& b){
+    return a.entity_id() == b.entity_id() && a.hp() == b.hp() && a.status_flags() == b.status_flags()
+        && a.x() == b.x() && a.y() == b.y() && a.vx() == b.vx() && a.vy() == b.vy();
+}
+
+static bool same(const std::vector<io::PackedEntity>& a, const std::vector<io::PackedEntity>& b){
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](const io::PackedEntity& x, const io::PackedEntity& y){
+        return same(x, y);
+    });
+}
+
+// 丢包的tick: 每 5 个丢一个, 外加 100..139 连续丢
+static bool lost(uint32_t tick){
+    return tick % 5 == 0 || (tick >= 100 && tick < 100 + ring + 8);
+}
+
+// 不发快照的tick
+static bool skipped(uint32_t tick){
+    return tick % 23 == 0;
+}
+
+int main(){
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> coin(0, 9);
+    std::uniform_int_distribution<int> value(-3000, 3000);
+    auto random = [&](uint32_t id){
+        return io::PackedEntity(id, int16_t(value(rng) & 0x3ff), uint16_t(coin(rng)), int16_t(value(rng)), int16_t(value(rng)),
+            int16_t(value(rng)), int16_t(value(rng)));
+    };
+    std::vector<io::PackedEntity> cur;
+    uint32_t next_id = 1;
+    for (; next_id <= 200; ++next_id) {
+        cur.push_back(random(next_id * 3));
+    }
+
+    snap::DeltaEncoder<ring> encoder;
+    snap::DeltaDecoder<ring> decoder;
+    flatbuffers::FlatBufferBuilder fbb;
+    flat::Quantizer q;
+    std::vector<std::vector<io::PackedEntity>> sent(rounds + 1);
+    std::deque<std::pair<uint32_t, uint32_t>> acks;    // (到达服务器的tick, 确认的tick)
+    uint32_t applied = 0, rejected = 0, full = 0, deltas = 0, bogus = 0;
+    bool forced = false;
+    bool ok = true;
+    for (uint32_t tick = 1; tick <= uint32_t(rounds); ++tick) {
+        while (!acks.empty() && acks.front().first <= tick) {
+            encoder.ack(acks.front().second);
+            acks.pop_front();
+        }
+        // 伪造的 ack 一律被忽略, 不影响基线
+        const uint32_t base = encoder.ackTick();
+        bogus += !encoder.ack(tick + 1) + !encoder.ack(0x7fffffffu) + !encoder.ack(tick > 23 ? tick / 23 * 23 : 0);
+        if (encoder.ackTick() != base) {
+            errorlog << "tick " << tick << ": bogus ack moved the baseline from " << base << " to " << encoder.ackTick();
+            ok = false;
+        }
+        if (tick == 301) {
+            encoder.reset();
+        }
+
+        // 改动字段, 删除和新增实体, 保持 entity_id 升序
+        for (io::PackedEntity& e : cur) {
+            if (coin(rng) < 3) {
+                e = io::PackedEntity(e.entity_id(), e.hp(), e.status_flags(), int16_t(e.x() + value(rng) / 100),
+                    int16_t(e.y() + value(rng) / 100), e.vx(), coin(rng) == 0 ? int16_t(value(rng)) : e.vy());
+            }
+        }
+        if (coin(rng) < 4 && !cur.empty()) {
+            cur.erase(cur.begin() + rng() % cur.size());
+        }
+        if (coin(rng) < 4) {
+            cur.push_back(random(next_id++ * 3));
+        }
+        if (skipped(tick)) {
+            continue;
+        }
+
+        fbb.Clear();
+        fbb.Finish(encoder.encode(fbb, tick, q, cur.data(), cur.size()));
+        sent[tick] = cur;
+        const io::DeltaFrame* frame = flatbuffers::GetRoot<io::DeltaFrame>(fbb.GetBufferPointer());
+        frame->baseline() == 0 ? ++full : ++deltas;
+        if (tick == 301) {
+            forced = frame->baseline() == 0;
+        }
+        if (lost(tick)) {
+            continue;
+        }
+
+        const uint32_t before = decoder.ack();
+        if (decoder.apply(frame)) {
+            ++applied;
+            if (!same(decoder.state(), sent[tick])) {
+                errorlog << "tick " << tick << ": decoded " << decoder.state().size() << " entities against baseline "
+                         << frame->baseline() << ", sent " << sent[tick].size();
+                ok = false;
+            }
+            // 重复到达的帧是过时的, 被拒绝
+            if (tick % 17 == 0 && decoder.apply(frame)) {
+                errorlog << "tick " << tick << ": duplicate frame applied twice";
+                ok = false;
+            }
+        }else {
+            ++rejected;
+            if (decoder.ack() != before || (before != 0 && !same(decoder.state(), sent[before]))) {
+                errorlog << "tick " << tick << ": rejected frame changed the client state";
+                ok = false;
+            }
+        }
+        acks.emplace_back(tick + lag, decoder.ack());
+    }
+
+    infolog << applied << " frames applied, " << rejected << " rejected, " << full << " full and " << deltas
+            << " delta frames encoded, " << bogus << " bogus acks ignored, full frame after reset: " << forced;
+    // 连续丢包超过环的长度之后还能靠全量帧恢复, 最后一帧之前客户端一直跟得上
+    ok = ok && forced && full >= 3 && deltas > full && applied > uint32_t(rounds) / 2
+        && encoder.fullFrames() == full && bogus == 3u * uint32_t(rounds);
+    if (!ok) {
+        errorlog << "failed";
+        return 1;
+    }
+    infolog << "ok";
+    return 0;
+}
+
+// 编译运行
+// flatc --cpp --filename-suffix _fb -o ../../src/flat -I ../../src/flat ../../src/flat/io.fbs ../../src/flat/pack.fbs
+// g++ -O2 -std=c++20 -o delta_test delta_test.cc -I../../src/comm -I../../src/flat -I../../src/snapshot -lflatbuffers
@@ -0,0 +1,82 @@
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include <log.h>
+#include "fixed.h"
+
+// 定点数和浮点数的运算耗时对比
+// 每种运算在 n 个元素的数组上执行, 输出每个元素的平均耗时
+
+using namespace world;
+
+static const size_t n = 1 << 16;
+static const int rounds = 100;
+
+// 防止编译器把循环不变的计算提到循环外
+static inline void clobber(){
+    asm volatile("" ::: "memory");
+}
+
+template<class F>
+double timeit(F&& fn){
+    using clock = std::chrono::steady_clock;
+    fn();
+    auto begin = clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        fn();
+        clobber();
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - begin).count();
+    return double(ns) / rounds / n;
+}
+
+template<class T>
+struct Data{
+    std::vector<T> a, b, out;
+    std::vector<Vec2<T>> v, vout;
+};
+
+template<class T>
+Data<T> makeData(){
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(0.5f, 100.0f);
+    Data<T> d;
+    for (size_t i = 0; i < n; ++i) {
+        d.a.push_back(T(dist(rng)));
+        d.b.push_back(T(dist(rng)));
+        d.v.emplace_back(T(dist(rng)), T(dist(rng)));
+    }
+    d.out.resize(n);
+    d.vout.resize(n);
+    return d;
+}
+
+template<class T>
+void bench(const char* name){
+    using std::sqrt;
+    using std::sin;
+    using std::atan2;
+    Data<T> d = makeData<T>();
+    T* a = d.a.data();
+    T* b = d.b.data();
+    T* out = d.out.data();
+    infolog << name;
+    infolog << "    mul+add:   " << timeit([&](){ for (size_t i = 0; i < n; ++i) out[i] = a[i] * b[i] + out[i]; }) << " ns";
+    infolog << "    div:       " << timeit([&](){ for (size_t i = 0; i < n; ++i) out[i] = a[i] / b[i]; }) << " ns";
+    infolog << "    sqrt:      " << timeit([&](){ for (size_t i = 0; i < n; ++i) out[i] = sqrt(a[i]); }) << " ns";
+    infolog << "    sin:       " << timeit([&](){ for (size_t i = 0; i < n; ++i) out[i] = sin(a[i]); }) << " ns";
+    infolog << "    atan2:     " << timeit([&](){ for (size_t i = 0; i < n; ++i) out[i] = atan2(a[i], b[i]); }) << " ns";
+    infolog << "    normalize: " << timeit([&](){ for (size_t i = 0; i < n; ++i) d.vout[i] = d.v[i].normalized(); }) << " ns";
+}
+
+int main(){
+    bench<float>("float");
+    bench<Q16>("Q16.16");
+    bench<Q32>("Q32.32");
+    return 0;
+}
+
+// 编译运行
+// g++ -O2 -std=c++17 -o fixed_bench fixed_bench.cc -I../../src/comm -I../../src/world -lpthread
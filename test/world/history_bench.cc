@@ -0,0 +1,118 @@
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include <log.h>
+#include "world.h"
+
+// 历史快照的开销
+// 2000 个移动中的实体, 比较关闭和开启历史时 World::tick 的平均耗时, 以及单独一次 History::save 的耗时
+// 再检查 positionAt 回退到的位置和当时记录的位置是否相同
+
+using namespace world;
+
+static const size_t entities = 2000;
+static const size_t players = 200;
+static const int warmup = 100;
+static const int rounds = 1000;
+
+static void populate(World& w){
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> pos(-900.0f, 900.0f);
+    std::uniform_real_distribution<float> vel(-6.0f, 6.0f);
+    for (size_t i = 0; i < players; ++i) {
+        w.spawn(uint32_t(i + 1), pos(rng), pos(rng));
+    }
+    for (size_t i = players; i < entities; ++i) {
+        w.spawnNpc(pos(rng), pos(rng), vel(rng), vel(rng));
+    }
+}
+
+// 每个tick给一部分玩家新的输入
+static void feed(World& w, std::mt19937& rng){
+    std::uniform_int_distribution<int> mv(-127, 127);
+    const uint32_t ack = w.currentTick();
+    w.input().produce([&](InputBuffer& in){
+        for (size_t i = 0; i < players; i += 4) {
+            in.push(uint32_t(i + 1), int8_t(mv(rng)), int8_t(mv(rng)), 0, 0, ack);
+        }
+    });
+}
+
+static double tickNs(uint32_t history){
+    using clock = std::chrono::steady_clock;
+    Config cfg;
+    cfg.history = history;
+    World w(cfg);
+    populate(w);
+    std::mt19937 rng(7);
+    for (int i = 0; i < warmup; ++i) {
+        feed(w, rng);
+        w.tick();
+    }
+    auto begin = clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        feed(w, rng);
+        w.tick();
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - begin).count();
+    return double(ns) / rounds;
+}
+
+static double saveNs(){
+    using clock = std::chrono::steady_clock;
+    World w;
+    populate(w);
+    w.tick();
+    History hist(32);
+    uint32_t t = 1;
+    for (int i = 0; i < warmup; ++i) {
+        hist.save(t++, w.kinematics());
+    }
+    auto begin = clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        hist.save(t++, w.kinematics());
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - begin).count();
+    return double(ns) / rounds;
+}
+
+static bool checkRewind(){
+    World w;
+    populate(w);
+    std::mt19937 rng(9);
+    entt::entity e = w.findPlayer(1);
+    std::vector<Position> seen;
+    for (int i = 0; i < 20; ++i) {
+        feed(w, rng);
+        w.tick();
+        seen.push_back(w.position(e));
+    }
+    for (uint32_t t = w.history().oldestTick(); t <= w.currentTick(); ++t) {
+        Position p;
+        if (!w.positionAt(e, t, p) || p.x != seen[t - 1].x || p.y != seen[t - 1].y) {
+            errorlog << "rewind mismatch at tick " << t;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(){
+    double off = tickNs(0);
+    double on = tickNs(32);
+    double save = saveNs();
+    infolog << "entities: " << entities;
+    infolog << "tick without history: " << off << " ns";
+    infolog << "tick with history:    " << on << " ns";
+    infolog << "History::save:        " << save << " ns (" << save * 100.0 / off << "% of tick)";
+    if (!checkRewind()) {
+        return 1;
+    }
+    infolog << "rewind ok";
+    return 0;
+}
+
+// 编译运行
+// flatc --cpp --filename-suffix _fb -o ../../src/flat -I ../../src/flat ../../src/flat/io.fbs ../../src/flat/pack.fbs
+// g++ -O2 -std=c++20 -o history_bench history_bench.cc ../../src/world/world.cc ../../src/world/kinematics.cc ../../src/world/record.cc ../../src/world/checkpoint.cc -I../../src/comm -I../../src/world -I../../src/flat -I../../src/snapshot -I../../src/connect -lflatbuffers -lpthread
@@ -0,0 +1,176 @@
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include <flatbuffers/flatbuffers.h>
+#include <log.h>
+#include "decode.h"
+#include "limiter.h"
+#include "world.h"
+
+// 刷包的客户端对tick开销的影响
+// 200 个玩家每个tick各发一条输入作为基准; 然后每个玩家每个tick发 20 条, 其中一个玩家发 5000 条,
+// 输入按玩家合并之后 input 系统处理的条数和tick耗时应该和基准差不多.
+// 刷包的玩家给每条指令填不同的历史帧, 合并之后每个tick也只修改一个历史tick.
+// 再检查合并的结果(最后的移动, 按位或的按键, 最早的帧), 超出历史范围的帧被拒绝, 和令牌桶在一秒内放行的指令数.
+// 最后一个会话把一个包的 256 条指令填上 256 个不同的 player_id, 解码时按会话绑定的玩家合并, 每个tick仍然只有一条.
+
+using namespace world;
+
+static const uint32_t players = 200;
+static const int warmup = 50;
+static const int rounds = 300;
+
+static void populate(World& w){
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> pos(-900.0f, 900.0f);
+    for (uint32_t i = 0; i < players; ++i) {
+        w.spawn(i + 1, pos(rng), pos(rng));
+    }
+}
+
+// 返回平均每个tick的纳秒数, inputs 是 input 系统处理的条数
+// late 时刷包的玩家(第一个)的每条指令指定一个不同的历史帧
+static double run(uint32_t per_player, uint32_t abuser, bool late, size_t& inputs, TickStats* stats = nullptr){
+    using clock = std::chrono::steady_clock;
+    World w;
+    populate(w);
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> mv(-127, 127);
+    uint64_t ns = 0;
+    for (int t = 0; t < warmup + rounds; ++t) {
+        w.input().produce([&](InputBuffer& in){
+            for (uint32_t p = 0; p < players; ++p) {
+                uint32_t n = p == 0 ? abuser : per_player;
+                for (uint32_t k = 0; k < n; ++k) {
+                    const uint32_t tk = late && p == 0 && t > 20 ? w.currentTick() - k % 20 : 0;
+                    in.push(p + 1, int8_t(mv(rng)), int8_t(mv(rng)), uint8_t(k % 2), tk);
+                }
+            }
+            inputs = in.size();
+        });
+        // 只统计 world 的tick, 写入队列的开销在解码线程
+        auto begin = clock::now();
+        w.tick();
+        if (t >= warmup) {
+            ns += std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - begin).count();
+        }
+    }
+    if (stats) {
+        *stats = w.stats();
+    }
+    return double(ns) / rounds;
+}
+
+static bool checkMerge(){
+    InputBuffer in;
+    in.push(1, 10, 10, 0x1, 0, 5);
+    in.push(2, 3, 3, 0, 0, 0);
+    bool merged = in.push(1, -5, 7, 0x4, 0, 3);
+    // 指定了不同帧的输入也合并, 保留最早的帧
+    merged = in.push(1, 0, 0, 0x2, 9, 0) && merged;
+    merged = in.push(1, 1, 1, 0, 12, 0) && merged;
+    return merged && in.size() == 2 && in.move_x[0] == 1 && in.move_y[0] == 1
+        && in.buttons[0] == 0x7 && in.ack[0] == 5 && in.tick[0] == 9;
+}
+
+// 未来的帧和早于历史的帧被拒绝, 历史范围内的迟到输入修改历史
+static bool checkRange(){
+    World w;
+    w.spawn(1, 0.0f, 0.0f);
+    w.spawn(2, 10.0f, 0.0f);
+    w.spawn(3, 20.0f, 0.0f);
+    for (int t = 0; t < 60; ++t) {
+        w.tick();
+    }
+    const uint32_t now = w.currentTick() + 1;
+    const uint32_t history = w.config().history;
+    w.input().produce([&](InputBuffer& in){
+        in.push(1, 100, 0, 0, now + 5);
+        in.push(2, 100, 0, 0, now - history);
+        in.push(3, 100, 0, 0, now - history + 1);
+    });
+    w.tick();
+    const TickStats& s = w.stats();
+    Velocity v1 = w.velocity(w.findPlayer(1));
+    Velocity v3 = w.velocity(w.findPlayer(3));
+    return s.rejected_inputs == 2 && s.late_inputs == 1 && v1.vx == 0.0f && v3.vx > 0.0f;
+}
+
+// 会话 300 每个tick发一个 256 条指令的包, player_id 交替填 0 和房间里其他玩家或编造的 id
+static bool checkSpoof(){
+    const uint32_t session = 300;
+    World w;
+    for (uint32_t p = 1; p <= 128; ++p) {
+        w.spawn(p, float(p) * 10.0f, 0.0f);
+    }
+    w.spawn(session, 0.0f, 100.0f);
+    flatbuffers::FlatBufferBuilder fbb;
+    std::vector<flatbuffers::Offset<io::Command>> cmds;
+    for (uint32_t k = 0; k < conn::Decoder::MAX_COMMANDS; ++k) {
+        cmds.push_back(io::CreateCommand(fbb, k % 2 ? k + 1 : 0, 1, 100, 0, k % 2 == 1));
+    }
+    cmds.back() = io::CreateCommand(fbb, session, 1, 100, 0, false);
+    fbb.Finish(io::CreateFrame(fbb, 0, io::DataType_Commands, 0, fbb.CreateVector(cmds)));
+
+    conn::Decoder decoder;
+    InputQueue probe;
+    bool ok = true;
+    for (int t = 0; t < 20; ++t) {
+        ok = decoder.decode(fbb.GetBufferPointer(), fbb.GetSize(), session, [&probe](uint32_t){ return &probe; }) && ok;
+        ok = ok && probe.consume().size() == 1;
+        decoder.decode(fbb.GetBufferPointer(), fbb.GetSize(), session, [&w](uint32_t){ return &w.input(); });
+        w.tick();
+    }
+    for (uint32_t p = 1; p <= 128; ++p) {
+        const Velocity v = w.velocity(w.findPlayer(p));
+        ok = ok && v.vx == 0.0f && v.vy == 0.0f;
+    }
+    infolog << "spoofing: " << decoder.decodedCommands() << " commands decoded, " << decoder.mergedCommands() << " merged, "
+            << decoder.rejectedCommands() << " rejected in " << w.stats().ticks << " ticks";
+    return ok && w.velocity(w.findPlayer(session)).vx > 0.0f && decoder.decodedCommands() == 40 * 129
+        && decoder.mergedCommands() == 40 * 128 && decoder.rejectedCommands() == 40 * 127;
+}
+
+int main(){
+    size_t base_inputs = 0, flood_inputs = 0, late_inputs = 0;
+    TickStats late_stats;
+    double base = run(1, 1, false, base_inputs);
+    double flood = run(20, 5000, false, flood_inputs);
+    double late = run(1, 5000, true, late_inputs, &late_stats);
+    infolog << "baseline: " << base / 1000.0 << " us per tick, " << base_inputs << " inputs";
+    infolog << "flood:    " << flood / 1000.0 << " us per tick, " << flood_inputs << " inputs after merge";
+    infolog << "late:     " << late / 1000.0 << " us per tick, " << late_inputs << " inputs after merge, "
+            << late_stats.late_inputs << " late inputs in " << late_stats.ticks << " ticks";
+
+    conn::RateLimiter limiter;
+    uint32_t allowed = 0;
+    // 一个会话一秒内发 1000 个包, 每个包一条指令
+    for (uint32_t ms = 0; ms < 1000; ++ms) {
+        allowed += limiter.allow(7, 1000 + ms);
+    }
+    // 另一个会话每 10ms 发一个带 10 条指令的包, 按指令计算放行的条数
+    uint32_t commands = 0;
+    for (uint32_t ms = 0; ms < 1000; ms += 10) {
+        commands += limiter.allow(8, 1000 + ms) && limiter.allow(8, 1000 + ms, 9) ? 10 : 0;
+    }
+    // 指令数超过桶容量的包总是被丢弃
+    const conn::LimiterConfig& lc = limiter.config();
+    const bool huge = limiter.allow(9, 5000, conn::LimiterConfig().burst + 1);
+    infolog << "rate limiter: " << allowed << " of 1000 packets and " << commands << " of 1000 commands allowed in 1s (rate "
+            << lc.rate << ", burst " << lc.burst << ")";
+
+    bool ok = checkMerge() && checkRange() && checkSpoof() && flood_inputs == players && late_inputs == players
+        && late_stats.late_inputs <= late_stats.ticks && late < base * 20
+        && allowed <= lc.rate + lc.burst + 1 && commands <= lc.rate + lc.burst + 10 && !huge;
+    if (!ok) {
+        errorlog << "failed";
+        return 1;
+    }
+    infolog << "ok";
+    return 0;
+}
+
+// 编译运行
+// flatc --cpp --filename-suffix _fb -o ../../src/flat -I ../../src/flat ../../src/flat/io.fbs ../../src/flat/pack.fbs
+// g++ -O2 -std=c++20 -o input_flood input_flood.cc ../../src/world/world.cc ../../src/world/kinematics.cc ../../src/world/record.cc ../../src/world/checkpoint.cc -I../../src/comm -I../../src/world -I../../src/flat -I../../src/snapshot -I../../src/connect -lflatbuffers -lpthread
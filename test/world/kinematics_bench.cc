@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <entt/entt.hpp>
+#include <log.h>
+#include "components.h"
+#include "kinematics.h"
+
+// 运动积分的对比
+// 每个实体一个 Position/Velocity 组件的 EnTT view 循环, 和 World 中 SoA 存储上的 scalar/sse2/avx2/fma 内核
+// 输出每个实体的平均耗时, 并检查向量内核和标量内核的结果是否逐位相同
+
+static const world::kernel::Bounds bounds{ -1000.0f, -1000.0f, 1000.0f, 1000.0f };
+static const float dt = 1.0f / 30.0f;
+static const int rounds = 200;
+
+// 防止编译器把循环不变的计算提到循环外
+static inline void clobber(){
+    asm volatile("" ::: "memory");
+}
+
+struct Data{
+    std::vector<float> x, y, vx, vy;
+};
+
+Data makeData(size_t n){
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> pos(-1000.0f, 1000.0f);
+    std::uniform_real_distribution<float> vel(-200.0f, 200.0f);
+    Data d;
+    for (size_t i = 0; i < n; ++i) {
+        d.x.push_back(pos(rng));
+        d.y.push_back(pos(rng));
+        d.vx.push_back(vel(rng));
+        d.vy.push_back(vel(rng));
+    }
+    return d;
+}
+
+template<class F>
+double timeit(size_t n, F&& fn){
+    using clock = std::chrono::steady_clock;
+    fn();
+    auto begin = clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        fn();
+        clobber();
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - begin).count();
+    return n ? double(ns) / rounds / n : 0.0;
+}
+
+double benchView(const Data& d){
+    entt::registry reg;
+    for (size_t i = 0; i < d.x.size(); ++i) {
+        entt::entity e = reg.create();
+        reg.emplace<world::Position>(e, d.x[i], d.y[i]);
+        reg.emplace<world::Velocity>(e, d.vx[i], d.vy[i]);
+    }
+    return timeit(d.x.size(), [&](){
+        reg.view<world::Position, const world::Velocity>().each([](world::Position& p, const world::Velocity& v){
+            p.x = std::clamp(p.x + v.vx * dt, bounds.min_x, bounds.max_x);
+            p.y = std::clamp(p.y + v.vy * dt, bounds.min_y, bounds.max_y);
+        });
+    });
+}
+
+struct Result{
+    double ns;
+    world::FloatArray x, y;
+};
+
+Result benchKernel(const Data& d, world::kernel::Integrate integrate){
+    world::FloatArray x(d.x.begin(), d.x.end()), y(d.y.begin(), d.y.end());
+    world::FloatArray vx(d.vx.begin(), d.vx.end()), vy(d.vy.begin(), d.vy.end());
+    const size_t n = x.size();
+    Result res;
+    res.ns = timeit(n, [&](){
+        integrate(x.data(), y.data(), vx.data(), vy.data(), n, dt, bounds);
+    });
+    // 从相同的初始状态积分一步, 用于比较结果
+    res.x.assign(d.x.begin(), d.x.end());
+    res.y.assign(d.y.begin(), d.y.end());
+    integrate(res.x.data(), res.y.data(), vx.data(), vy.data(), n, dt, bounds);
+    return res;
+}
+
+bool same(const Result& a, const Result& b){
+    size_t bytes = a.x.size() * sizeof(float);
+    return std::memcmp(a.x.data(), b.x.data(), bytes) == 0 && std::memcmp(a.y.data(), b.y.data(), bytes) == 0;
+}
+
+int main(){
+    using namespace world::kernel;
+    __builtin_cpu_init();
+    const bool avx2 = __builtin_cpu_supports("avx2");
+    const bool fma = avx2 && __builtin_cpu_supports("fma");
+    infolog << "select(deterministic) = " << select(true).name << ", select(fast) = " << select(false).name;
+
+    for (size_t n : { 16, 100, 1000, 10000, 100000 }) {
+        Data d = makeData(n);
+        double view = benchView(d);
+        Result scalar = benchKernel(d, &integrateScalar);
+        Result sse2 = benchKernel(d, &integrateSse2);
+        infolog << "n = " << n;
+        infolog << "    entt view: " << view << " ns/entity";
+        infolog << "    scalar:    " << scalar.ns << " ns/entity";
+        infolog << "    sse2:      " << sse2.ns << " ns/entity, bit-identical = " << same(scalar, sse2);
+        if (avx2) {
+            Result r = benchKernel(d, &integrateAvx2);
+            infolog << "    avx2:      " << r.ns << " ns/entity, bit-identical = " << same(scalar, r);
+        }
+        if (fma) {
+            // fma 少一次舍入, 不要求逐位相同
+            Result r = benchKernel(d, &integrateFma);
+            infolog << "    avx2+fma:  " << r.ns << " ns/entity, bit-identical = " << same(scalar, r);
+        }
+    }
+    return 0;
+}
+
+// 编译运行
+// g++ -O2 -std=c++17 -o kinematics_bench kinematics_bench.cc ../../src/world/kinematics.cc -I../../src/comm -I../../src/world -lpthread
@@ -0,0 +1,149 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <log.h>
+#include "rooms.h"
+
+// 帧同步房间
+// 1. 直接驱动 LockstepRoom: 延后执行的指令落在 tick + delay, 指定了帧的指令落在那一帧, 迟到的放到当前帧;
+//    缺帧时重复上一次的输入, 玩家按 player_id 升序, 进出通过 PlayerEvent
+// 2. 作为 RoomManager 中的房间由工作线程驱动, 每个tick广播一帧给房间内的会话
+
+using namespace world;
+
+// 一帧中每个玩家的 (player_id, move_x)
+using Expect = std::vector<std::pair<uint32_t, int8_t>>;
+
+static bool same(const LockstepRoom& room, const Expect& expect){
+    const std::vector<io::PackedCommand>& frame = room.lastFrame();
+    bool ok = frame.size() == expect.size();
+    for (size_t i = 0; ok && i < frame.size(); ++i) {
+        ok = frame[i].player_id() == expect[i].first && frame[i].move_x() == expect[i].second;
+    }
+    if (!ok) {
+        errorlog << "tick " << room.currentTick() << " frame differs";
+        for (const io::PackedCommand& c : frame) {
+            errorlog << "  player " << c.player_id() << " move_x " << int(c.move_x());
+        }
+    }
+    return ok;
+}
+
+template<class F>
+static bool step(LockstepRoom& room, F&& f, const Expect& expect){
+    room.input().produce(f);
+    room.tick();
+    return same(room, expect);
+}
+
+static bool order(){
+    LockstepConfig cfg;
+    cfg.delay = 3;
+    cfg.window = 8;
+    LockstepRoom room(cfg);
+    uint32_t sent = 0;
+    room.setSender([&sent](const std::shared_ptr<enet::ENetData>& data){
+        sent += data != nullptr;
+    });
+
+    bool ok = true;
+    // tick 1: 乱序进入; 2 没有指定帧, 延后到 4; 1 指定了 2
+    ok = step(room, [](InputBuffer& in){
+        in.join(3, 0, 0);
+        in.join(1, 0, 0);
+        in.join(2, 0, 0);
+        in.push(2, 20, 0, 0);
+        in.push(1, 10, 0, 0, 2);
+    }, { { 1, 0 }, { 2, 0 }, { 3, 0 } }) && ok;
+    // tick 2: 3 延后到 5
+    ok = step(room, [](InputBuffer& in){
+        in.push(3, 30, 0, 0);
+    }, { { 1, 10 }, { 2, 0 }, { 3, 0 } }) && ok;
+    // tick 3: 没有输入, 全部重复上一次的
+    ok = step(room, [](InputBuffer&){}, { { 1, 10 }, { 2, 0 }, { 3, 0 } }) && ok;
+    // tick 4: 1 指定当前帧
+    ok = step(room, [](InputBuffer& in){
+        in.push(1, 11, 0, 0, 4);
+    }, { { 1, 11 }, { 2, 20 }, { 3, 0 } }) && ok;
+    // tick 5: 3 的指令迟到, 放到当前帧, 比 tick 2 时延后到这一帧的那条晚到, 以它为准
+    ok = step(room, [](InputBuffer& in){
+        in.push(3, 31, 0, 0, 3);
+    }, { { 1, 11 }, { 2, 20 }, { 3, 31 } }) && ok;
+    // tick 6: 不在房间中的玩家和超出窗口的指令丢弃, 1 离开
+    ok = step(room, [](InputBuffer& in){
+        in.leave(1);
+        in.push(9, 90, 0, 0);
+        in.push(2, 22, 0, 0, 6 + 8);
+    }, { { 2, 20 }, { 3, 31 } }) && ok;
+    // tick 7: 1 重新进入, 从零输入开始
+    ok = step(room, [](InputBuffer& in){
+        in.join(1, 0, 0);
+    }, { { 1, 0 }, { 2, 20 }, { 3, 31 } }) && ok;
+
+    const LockstepStats& s = room.stats();
+    infolog << "frames " << s.frames << ", late " << s.late << ", filled " << s.filled << ", dropped " << s.dropped;
+    return ok && sent == 7 && s.frames == 7 && s.late == 1 && s.dropped == 2 && s.filled == 16;
+}
+
+static bool scheduled(){
+    RoomManagerConfig mc;
+    mc.threads = 1;
+    RoomManager manager(mc);
+    LockstepConfig cfg;
+    cfg.tick_rate = 100;
+    std::atomic<uint32_t> frames{ 0 };
+    std::atomic<uint32_t> targets{ 0 };
+    std::shared_ptr<Room> room = manager.create(7, cfg, [&](LockstepRoom& r){
+        // 和 server::Server 一样, 由出口填上房间内的会话
+        r.setSender([&](const std::shared_ptr<enet::ENetData>& data){
+            std::vector<uint32_t> members;
+            manager.members(7, members);
+            data->setTargets(members);
+            targets.store(uint32_t(data->targets().size()));
+            ++frames;
+        });
+    });
+    bool ok = room && room->isLockstep() && room->lockstepRoom().config().room_id == 7;
+    // 同一个 id 不能再创建状态同步的房间
+    ok = ok && manager.create(7) == nullptr;
+    manager.attach(70, 7);
+    manager.attach(71, 7);
+    room->input().produce([](InputBuffer& in){
+        in.join(1, 0, 0);
+        in.join(2, 0, 0);
+    });
+    manager.start();
+    for (int i = 0; i < 20; ++i) {
+        room->input().produce([i](InputBuffer& in){
+            in.push(1, int8_t(i), 0, 0);
+            in.push(2, int8_t(-i), 0, 0);
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    manager.stop();
+
+    RoomStats s;
+    ok = ok && manager.stats(7, s);
+    const LockstepRoom& r = room->lockstepRoom();
+    infolog << "room manager drove " << r.currentTick() << " frames, " << frames.load() << " sent to " << targets.load() << " sessions";
+    return ok && r.currentTick() > 10 && s.ticks == r.currentTick() && frames.load() == r.currentTick()
+        && targets.load() == 2 && r.players() == 2 && r.lastFrame().size() == 2;
+}
+
+int main(){
+    bool ok = order();
+    ok = scheduled() && ok;
+    if (!ok) {
+        errorlog << "failed";
+        return 1;
+    }
+    infolog << "ok";
+    return 0;
+}
+
+// 编译运行
+// flatc --cpp --filename-suffix _fb -o ../../src/flat -I ../../src/flat ../../src/flat/io.fbs ../../src/flat/pack.fbs
+// g++ -O2 -std=c++20 -o lockstep_test lockstep_test.cc ../../src/world/lockstep.cc ../../src/world/rooms.cc ../../src/world/world.cc ../../src/world/kinematics.cc ../../src/world/record.cc ../../src/world/checkpoint.cc -I../../src/comm -I../../src/world -I../../src/flat -I../../src/snapshot -I../../src/connect -lflatbuffers -lpthread
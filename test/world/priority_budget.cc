@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include <log.h>
+#include "delta.h"
+#include "priority.h"
+#include "world.h"
+
+// 带宽预算下的实体优先级
+// 600 个实体挤在一个小区域里持续移动, 一个客户端的确认延迟 4 个tick. 比较不限制和限制每帧字节数时
+// 实体数据的大小(按 DeltaEncoder 的格式计算), 以及客户端看到的状态落后的tick数: 近处的实体应该更新得更及时,
+// 远处的也不能一直得不到更新.
+// 客户端从基线还原出来的状态就是交给 DeltaEncoder 的实体列表, 这里直接用它作为客户端的状态.
+
+using namespace world;
+
+static const size_t entities = 600;
+static const size_t players = 40;
+static const uint32_t lag = 4;
+static const int rounds = 600;
+
+struct Result{
+    size_t max_bytes = 0;
+    double avg_bytes = 0;
+    uint32_t max_stale = 0;      // 任意实体连续落后的最大tick数
+    double near_stale = 0;       // 离观察者 falloff 以内和以外的实体平均落后的tick数
+    double far_stale = 0;
+    uint64_t deferred = 0;
+};
+
+static void populate(World& w){
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> pos(-150.0f, 150.0f);
+    std::uniform_real_distribution<float> vel(-4.0f, 4.0f);
+    for (size_t i = 0; i < players; ++i) {
+        w.spawn(uint32_t(i + 1), pos(rng), pos(rng));
+    }
+    for (size_t i = players; i < entities; ++i) {
+        w.spawnNpc(pos(rng), pos(rng), vel(rng), vel(rng));
+    }
+}
+
+static uint32_t varint(uint32_t v){
+    uint32_t n = 1;
+    while (v >= 0x80) {
+        v >>= 7;
+        ++n;
+    }
+    return n;
+}
+
+// 相对基线编码 view 的实体数据字节数, 和 DeltaEncoder 的 spawns/despawns/changes 一致
+static size_t payload(const snap::Snapshot* base, const std::vector<io::PackedEntity>& view){
+    if (base == nullptr) {
+        return view.size() * sizeof(io::PackedEntity);
+    }
+    size_t bytes = 0, i = 0, j = 0;
+    uint32_t prev = 0;
+    const std::vector<io::PackedEntity>& b = base->entities;
+    while (i < b.size() || j < view.size()) {
+        if (j == view.size() || (i < b.size() && b[i].entity_id() < view[j].entity_id())) {
+            bytes += sizeof(uint32_t);
+            ++i;
+        }else if (i == b.size() || view[j].entity_id() < b[i].entity_id()) {
+            bytes += sizeof(io::PackedEntity);
+            ++j;
+        }else {
+            uint8_t mask = snap::detail::diff(b[i], view[j]);
+            if (mask) {
+                bytes += varint(view[j].entity_id() - prev) + 1 + 2 * __builtin_popcount(mask);
+                prev = view[j].entity_id();
+            }
+            ++i;
+            ++j;
+        }
+    }
+    return bytes;
+}
+
+static Result run(uint32_t budget){
+    World w;
+    populate(w);
+    const uint32_t eye = entt::to_integral(w.findPlayer(1));
+    snap::PriorityConfig pc;
+    pc.budget = budget;
+    snap::PriorityFilter filter(pc);
+    filter.watch(eye);
+    snap::DeltaEncoder<> encoder;
+    flatbuffers::FlatBufferBuilder fbb;
+    std::unordered_map<uint32_t, uint32_t> fresh;   // 客户端最后一次和服务器一致的tick
+    Result r;
+    size_t total_bytes = 0, near_n = 0, far_n = 0;
+    uint64_t near_sum = 0, far_sum = 0;
+    for (int t = 0; t < rounds; ++t) {
+        w.tick();
+        const uint32_t tick = w.currentTick();
+        if (tick > lag) {
+            encoder.ack(tick - lag);
+        }
+        const auto& cur = w.snapshot();
+        const std::vector<io::PackedEntity>& view = filter.select(encoder.baseline(), encoder.last(),
+            w.quantizer(), cur.data(), cur.size());
+        const size_t bytes = payload(encoder.baseline(), view);
+        fbb.Clear();
+        fbb.Finish(encoder.encode(fbb, tick, w.quantizer(), view.data(), view.size()));
+        r.max_bytes = std::max(r.max_bytes, bytes);
+        total_bytes += bytes;
+
+        const io::PackedEntity* me = nullptr;
+        for (const io::PackedEntity& e : cur) {
+            if (e.entity_id() == eye) {
+                me = &e;
+            }
+        }
+        size_t k = 0;
+        for (const io::PackedEntity& e : cur) {
+            while (k < view.size() && view[k].entity_id() < e.entity_id()) {
+                ++k;
+            }
+            const bool same = k < view.size() && view[k].entity_id() == e.entity_id() && snap::detail::diff(view[k], e) == 0;
+            auto it = fresh.try_emplace(e.entity_id(), tick).first;
+            if (same) {
+                it->second = tick;
+            }
+            const uint32_t stale = tick - it->second;
+            r.max_stale = std::max(r.max_stale, stale);
+            const float dx = float(e.x() - me->x()) / w.quantizer().pos_scale;
+            const float dy = float(e.y() - me->y()) / w.quantizer().pos_scale;
+            if (dx * dx + dy * dy < pc.falloff * pc.falloff) {
+                near_sum += stale;
+                ++near_n;
+            }else {
+                far_sum += stale;
+                ++far_n;
+            }
+        }
+    }
+    r.avg_bytes = double(total_bytes) / rounds;
+    r.near_stale = near_n ? double(near_sum) / near_n : 0;
+    r.far_stale = far_n ? double(far_sum) / far_n : 0;
+    r.deferred = filter.deferredCount();
+    return r;
+}
+
+static void report(const char* name, const Result& r){
+    infolog << name << ": avg " << r.avg_bytes << " bytes, max " << r.max_bytes << " bytes, stale near "
+            << r.near_stale << " far " << r.far_stale << " max " << r.max_stale << " ticks, "
+            << r.deferred << " deferred";
+}
+
+int main(){
+    const uint32_t budget = 1200;
+    Result unlimited = run(0);
+    Result limited = run(budget);
+    report("unlimited", unlimited);
+    report("budget", limited);
+    // 估算的 id 差值可能比实际的 varint 短, 留一点余量
+    bool ok = limited.max_bytes <= budget + budget / 10 && limited.max_stale < 100 && limited.near_stale < limited.far_stale;
+    if (!ok) {
+        errorlog << "failed";
+        return 1;
+    }
+    infolog << "ok";
+    return 0;
+}
+
+// 编译运行
+// flatc --cpp --filename-suffix _fb -o ../../src/flat -I ../../src/flat ../../src/flat/io.fbs ../../src/flat/pack.fbs
+// g++ -O2 -std=c++20 -o priority_budget priority_budget.cc ../../src/world/world.cc ../../src/world/kinematics.cc ../../src/world/record.cc ../../src/world/checkpoint.cc -I../../src/comm -I../../src/world -I../../src/flat -I../../src/snapshot -I../../src/connect -lflatbuffers -lpthread
@@ -0,0 +1,104 @@
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <log.h>
+#include "world.h"
+
+// 输入录制和回放
+// 2000 个 NPC 的房间, 玩家陆续进入和离开, 每个tick随机移动和攻击, 有一部分迟到的输入触发重新模拟.
+// 录制 1800 个tick(30Hz 一分钟), 再用同样的初始化回放:
+//   每个tick的状态哈希都相同, 回放的速度远高于实时
+//   修改了逻辑(速度衰减)的 World 回放时在第一个结果不同的tick停下
+
+using namespace world;
+
+static const size_t npcs = 2000;
+static const uint32_t players = 200;
+static const uint32_t rounds = 1800;
+
+static void init(World& w){
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> pos(-200.0f, 200.0f);
+    std::uniform_real_distribution<float> vel(-3.0f, 3.0f);
+    for (size_t i = 0; i < npcs; ++i) {
+        w.spawnNpc(pos(rng), pos(rng), vel(rng), vel(rng));
+    }
+}
+
+static bool record(const std::string& path, uint64_t& bytes){
+    World w;
+    init(w);
+    if (!w.record(path)) {
+        return false;
+    }
+    std::mt19937 rng(5);
+    std::vector<bool> joined(players + 1, false);
+    for (uint32_t t = 1; t <= rounds; ++t) {
+        w.input().produce([&](InputBuffer& in){
+            for (int k = 0; k < 2; ++k) {
+                const uint32_t pid = 1 + rng() % players;
+                if (!joined[pid]) {
+                    in.join(pid, float(rng() % 400) - 200.0f, float(rng() % 400) - 200.0f);
+                    joined[pid] = true;
+                }else if (rng() % 20 == 0) {
+                    in.leave(pid);
+                    joined[pid] = false;
+                }
+            }
+            for (uint32_t pid = 1; pid <= players; ++pid) {
+                if (!joined[pid] || rng() % 3 != 0) {
+                    continue;
+                }
+                // 偶尔有迟到两个tick的输入
+                const uint32_t tk = rng() % 16 == 0 && t > 3 ? t - 2 : 0;
+                in.push(pid, int8_t(rng() % 255 - 127), int8_t(rng() % 255 - 127), uint8_t(rng() % 8), tk, t > 2 ? t - 2 : 0);
+            }
+        });
+        w.tick();
+    }
+    bytes = w.recorder()->bytes();
+    return w.recorder()->ticks() == rounds;
+}
+
+int main(){
+    const std::string path = "replay_bench.rec";
+    uint64_t bytes = 0;
+    bool ok = record(path, bytes);
+    infolog << "recorded " << rounds << " ticks, " << bytes << " bytes";
+
+    InputReplay replay;
+    ok = ok && replay.open(path);
+    ReplayStats s;
+    {
+        World w;
+        init(w);
+        ok = ok && replay.run(w, s);
+    }
+    infolog << "replayed " << s.ticks << " ticks, " << s.commands << " commands, " << s.events << " joins and leaves in "
+            << s.seconds * 1000.0 << " ms, " << s.ticks / s.seconds / 30.0 << "x real time";
+    ok = ok && s.ticks == rounds && s.mismatch == 0;
+
+    // 逻辑改变之后回放的结果不同
+    Config changed;
+    changed.damping = 0.99f;
+    ReplayStats d;
+    {
+        World w(changed);
+        init(w);
+        ok = ok && !replay.run(w, d) && d.mismatch != 0;
+    }
+    infolog << "with damping changed the replay diverges at tick " << d.mismatch;
+    replay.close();
+    std::remove(path.c_str());
+    if (!ok) {
+        errorlog << "failed";
+        return 1;
+    }
+    infolog << "ok";
+    return 0;
+}
+
+// 编译运行
+// flatc --cpp --filename-suffix _fb -o ../../src/flat -I ../../src/flat ../../src/flat/io.fbs ../../src/flat/pack.fbs
+// g++ -O2 -std=c++20 -o replay_bench replay_bench.cc ../../src/world/world.cc ../../src/world/kinematics.cc ../../src/world/record.cc ../../src/world/checkpoint.cc -I../../src/comm -I../../src/world -I../../src/flat -I../../src/snapshot -I../../src/connect -lflatbuffers -lpthread
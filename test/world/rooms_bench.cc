@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+#include <log.h>
+#include "rooms.h"
+
+// 房间管理的调度延迟
+// 几千个小房间(每个几个玩家和一些NPC)共用固定数量的工作线程, 运行期间不断创建和删除房间,
+// 另一个线程按会话路由写入输入. 输出每个房间tick开始时相对截止时间的延迟. 房间数可以作为参数传进来.
+
+using namespace world;
+
+static uint32_t rooms = 2000;
+static const uint32_t players_per_room = 4;
+static const uint32_t npcs_per_room = 12;
+static const int seconds = 3;
+
+static Config roomConfig(){
+    Config cfg;
+    cfg.min_x = cfg.min_y = -50.0f;
+    cfg.max_x = cfg.max_y = 50.0f;
+    cfg.reserve = 32;
+    cfg.history = 8;
+    cfg.arena = 8 * 1024;
+    return cfg;
+}
+
+static void populate(World& w, std::mt19937& rng){
+    std::uniform_real_distribution<float> pos(-40.0f, 40.0f);
+    std::uniform_real_distribution<float> vel(-3.0f, 3.0f);
+    for (uint32_t p = 0; p < players_per_room; ++p) {
+        w.spawn(p + 1, pos(rng), pos(rng));
+    }
+    for (uint32_t i = 0; i < npcs_per_room; ++i) {
+        w.spawnNpc(pos(rng), pos(rng), vel(rng), vel(rng));
+    }
+}
+
+int main(int argc, char* argv[]){
+    if (argc > 1) {
+        rooms = uint32_t(std::strtoul(argv[1], nullptr, 10));
+    }
+    RoomManager manager;
+    std::mt19937 rng(42);
+    for (uint32_t r = 1; r <= rooms; ++r) {
+        manager.create(r, roomConfig(), [&](World& w){ populate(w, rng); });
+        for (uint32_t p = 0; p < players_per_room; ++p) {
+            manager.attach(r * players_per_room + p, r);
+        }
+    }
+    manager.start();
+    infolog << rooms << " rooms on " << manager.threads() << " threads";
+
+    // 模拟解码线程: 每个会话每秒 30 个输入
+    std::atomic<bool> feeding{ true };
+    std::thread feeder([&](){
+        std::mt19937 rng(7);
+        std::uniform_int_distribution<int> mv(-127, 127);
+        while (feeding.load()) {
+            auto begin = std::chrono::steady_clock::now();
+            for (uint32_t r = 1; r <= rooms; ++r) {
+                for (uint32_t p = 0; p < players_per_room; ++p) {
+                    std::shared_ptr<Room> room = manager.route(r * players_per_room + p);
+                    if (room) {
+                        room->input().produce([&](InputBuffer& in){
+                            in.push(p + 1, int8_t(mv(rng)), int8_t(mv(rng)), 0);
+                        });
+                    }
+                }
+            }
+            std::this_thread::sleep_until(begin + std::chrono::milliseconds(33));
+        }
+    });
+
+    // 运行期间每 100ms 换掉 10 个房间
+    uint32_t next_id = rooms + 1;
+    uint32_t victim = 1;
+    auto end = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    while (std::chrono::steady_clock::now() < end) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        for (int i = 0; i < 10; ++i) {
+            manager.destroy(victim++);
+            manager.create(next_id++, roomConfig(), [&](World& w){ populate(w, rng); });
+        }
+    }
+    feeding.store(false);
+    feeder.join();
+    manager.stop();
+
+    // 只统计运行了全程的房间
+    std::vector<double> avg;
+    std::vector<uint64_t> worst;
+    uint64_t ticks = 0, missed = 0, dropped = 0;
+    for (uint32_t r = victim; r <= rooms; ++r) {
+        RoomStats s;
+        if (!manager.stats(r, s)) {
+            continue;
+        }
+        avg.push_back(s.avg_late_ns);
+        worst.push_back(s.max_late_ns);
+        ticks += s.ticks;
+        missed += s.missed;
+        dropped += s.dropped;
+    }
+    std::sort(avg.begin(), avg.end());
+    std::sort(worst.begin(), worst.end());
+    const size_t n = avg.size();
+    if (n == 0) {
+        errorlog << "no room ran for the whole time";
+        return 1;
+    }
+    infolog << "rooms measured: " << n << ", ticks per room: " << ticks / n << " (expect " << seconds * 30 << ")";
+    infolog << "lateness avg p50: " << avg[n / 2] / 1000.0 << " us, p99: " << avg[n * 99 / 100] / 1000.0 << " us";
+    infolog << "lateness max p50: " << worst[n / 2] / 1000.0 << " us, p99: " << worst[n * 99 / 100] / 1000.0 << " us";
+    infolog << "missed: " << missed << ", dropped: " << dropped;
+    return 0;
+}
+
+// 编译运行
+// flatc --cpp --filename-suffix _fb -o ../../src/flat -I ../../src/flat ../../src/flat/io.fbs ../../src/flat/pack.fbs
+// g++ -O2 -std=c++20 -o rooms_bench rooms_bench.cc ../../src/world/rooms.cc ../../src/world/lockstep.cc ../../src/world/world.cc ../../src/world/kinematics.cc ../../src/world/record.cc ../../src/world/checkpoint.cc -I../../src/comm -I../../src/world -I../../src/flat -I../../src/snapshot -I../../src/connect -lflatbuffers -lpthread
+// ./rooms_bench [房间数]
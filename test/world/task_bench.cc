@@ -0,0 +1,164 @@
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include <log.h>
+#include "world.h"
+
+// 协程
+// 1. nextTick, ticks(n), until(pred) 恢复的tick
+// 2. 20000 个 NPC 来回巡逻: 向右走 40 个tick, 停 20 个tick, 向左走 40 个tick, 再停 20 个tick.
+//    状态机的写法每个 NPC 一个组件记录阶段和剩余tick数, 每个tick的系统遍历所有 NPC;
+//    协程的写法只在改变方向时恢复. 比较每个tick的耗时, 两种写法的最终位置相同.
+// 3. 一波一波地启动和结束协程, 稳定之后协程帧不再向系统申请内存.
+
+using namespace world;
+
+static const size_t npcs = 20000;
+static const uint32_t rounds = 600;
+
+static Task record(std::vector<uint32_t>& at, World& w, const bool& flag){
+    co_await nextTick();
+    at.push_back(w.currentTick());
+    co_await ticks(5);
+    at.push_back(w.currentTick());
+    co_await ticks(0);
+    at.push_back(w.currentTick());
+    co_await until([&flag](){ return flag; });
+    at.push_back(w.currentTick());
+}
+
+static bool checkResume(){
+    World w;
+    w.tick();
+    std::vector<uint32_t> at;
+    bool flag = false;
+    w.tasks().spawn(record(at, w, flag));
+    for (uint32_t t = 0; t < 20; ++t) {
+        if (w.currentTick() == 12) {
+            flag = true;
+        }
+        w.tick();
+    }
+    // 在 tick 1 之后启动: tick 2 恢复, 再过5个tick是 7, ticks(0) 不挂起, tick 12 之后条件成立, tick 13 开始时恢复
+    const std::vector<uint32_t> expect = { 2, 7, 7, 13 };
+    if (at != expect || w.tasks().size() != 0) {
+        errorlog << "resume ticks wrong";
+        return false;
+    }
+    return true;
+}
+
+// 状态机: 阶段 0 向右, 1 停, 2 向左, 3 停
+struct Patrol{
+    uint8_t phase;
+    uint32_t left;
+};
+static const uint32_t walk = 40;
+static const uint32_t rest = 20;
+
+static Task patrol(World& w, entt::entity e){
+    while (w.registry().valid(e)) {
+        w.setVelocity(e, 1.0f, 0.0f);
+        co_await ticks(walk);
+        w.setVelocity(e, 0.0f, 0.0f);
+        co_await ticks(rest);
+        w.setVelocity(e, -1.0f, 0.0f);
+        co_await ticks(walk);
+        w.setVelocity(e, 0.0f, 0.0f);
+        co_await ticks(rest);
+    }
+}
+
+static std::vector<entt::entity> populate(World& w){
+    std::vector<entt::entity> es;
+    for (size_t i = 0; i < npcs; ++i) {
+        es.push_back(w.spawnNpc(float(i % 1000) - 500.0f, float(i / 1000) * 10.0f - 500.0f, 0.0f, 0.0f));
+    }
+    return es;
+}
+
+static double run(bool coroutine, std::vector<Position>& out){
+    Config cfg;
+    cfg.reserve = npcs;
+    cfg.history = 0;
+    World w(cfg);
+    std::vector<entt::entity> es = populate(w);
+    if (coroutine) {
+        for (entt::entity e : es) {
+            w.tasks().spawn(patrol(w, e));
+        }
+    }else {
+        // 协程在tick开始时改变速度, 系统在运动之后, 所以提前一个tick切换
+        for (entt::entity e : es) {
+            w.registry().emplace<Patrol>(e, uint8_t(0), walk - 1);
+            w.setVelocity(e, 1.0f, 0.0f);
+        }
+        w.addSystem("patrol", [&w](float){
+            w.registry().view<Patrol>().each([&w](entt::entity e, Patrol& p){
+                if (--p.left != 0) {
+                    return;
+                }
+                p.phase = (p.phase + 1) & 3;
+                p.left = p.phase & 1 ? rest : walk;
+                w.setVelocity(e, p.phase == 0 ? 1.0f : p.phase == 2 ? -1.0f : 0.0f, 0.0f);
+            });
+        });
+    }
+    using clock = std::chrono::steady_clock;
+    auto begin = clock::now();
+    for (uint32_t t = 0; t < rounds; ++t) {
+        w.tick();
+    }
+    double us = std::chrono::duration<double, std::micro>(clock::now() - begin).count() / rounds;
+    for (entt::entity e : es) {
+        out.push_back(w.position(e));
+    }
+    return us;
+}
+
+static Task brief(){
+    co_await ticks(3);
+}
+
+static bool checkPool(){
+    World w;
+    const size_t wave = 1000;
+    uint64_t upstream = 0;
+    for (int i = 0; i < 10; ++i) {
+        for (size_t k = 0; k < wave; ++k) {
+            w.tasks().spawn(brief());
+        }
+        for (int t = 0; t < 4; ++t) {
+            w.tick();
+        }
+        if (i == 1) {
+            upstream = pool::BufferPool::instance().stats().upstream;
+        }
+    }
+    const uint64_t now = pool::BufferPool::instance().stats().upstream;
+    infolog << w.tasks().spawned() << " tasks in waves of " << wave << ", " << now - upstream << " frames allocated from the system after the second wave";
+    return w.tasks().size() == 0 && now == upstream;
+}
+
+int main(){
+    bool ok = checkResume();
+    std::vector<Position> a, b;
+    double fsm = run(false, a);
+    double co = run(true, b);
+    // 两种写法在同一个tick改变速度, 最终位置逐位相同
+    for (size_t i = 0; i < a.size(); ++i) {
+        ok = ok && a[i].x == b[i].x && a[i].y == b[i].y;
+    }
+    infolog << npcs << " patrolling npcs: state machine " << fsm << " us, coroutines " << co << " us per tick";
+    ok = ok && checkPool();
+    if (!ok) {
+        errorlog << "failed";
+        return 1;
+    }
+    infolog << "ok";
+    return 0;
+}
+
+// 编译运行
+// flatc --cpp --filename-suffix _fb -o ../../src/flat -I ../../src/flat ../../src/flat/io.fbs ../../src/flat/pack.fbs
+// g++ -O2 -std=c++20 -o task_bench task_bench.cc ../../src/world/world.cc ../../src/world/kinematics.cc ../../src/world/record.cc ../../src/world/checkpoint.cc -I../../src/comm -I../../src/world -I../../src/flat -I../../src/snapshot -I../../src/connect -lflatbuffers -lpthread
@@ -0,0 +1,173 @@
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <queue>
+#include <random>
+#include <vector>
+#include <log.h>
+#include "wheel.h"
+#include "world.h"
+
+// 时间轮
+// 1. 和按到期时间排序的 multimap 对照: 随机插入, 取消, 推进, 每个定时器到期的时间都相同.
+//    用很小的轮(2层, 每层4个槽)让级联和溢出链表都经常发生.
+// 2. 10 万个定时器, 每个tick插入和取消一批, 比较时间轮和二叉堆(取消用懒删除)每个tick的耗时.
+// 3. 玩家一直按住技能1, 技能按冷却时间间隔释放.
+
+using namespace world;
+
+struct Item{
+    uint64_t when = 0;
+    uint32_t id = 0;
+};
+
+static bool checkOrder(){
+    std::mt19937 rng(7);
+    timer::Wheel<Item, 2, 2> wheel;
+    std::multimap<uint64_t, uint32_t> ref;
+    std::vector<std::pair<timer::TimerId, std::multimap<uint64_t, uint32_t>::iterator>> live;
+    std::vector<Item> out;
+    uint32_t next_id = 0;
+    uint64_t now = 0;
+    for (int round = 0; round < 20000; ++round) {
+        const int op = rng() % 10;
+        if (op < 5) {
+            // 有的远远超过轮的范围(16)
+            const uint64_t delay = rng() % 3 == 0 ? rng() % 200 : rng() % 20;
+            const uint64_t when = std::max(now + delay, now + 1);
+            const uint32_t id = next_id++;
+            live.emplace_back(wheel.schedule(now + delay, Item{ when, id }), ref.emplace(when, id));
+        }else if (op < 7 && !live.empty()) {
+            size_t k = rng() % live.size();
+            if (wheel.cancel(live[k].first)) {
+                ref.erase(live[k].second);
+            }
+            live[k] = live.back();
+            live.pop_back();
+        }else {
+            now += rng() % 4;
+            out.clear();
+            wheel.advance(now, out);
+            for (const Item& it : out) {
+                auto r = ref.find(it.when);
+                while (r != ref.end() && r->first == it.when && r->second != it.id) {
+                    ++r;
+                }
+                if (it.when > now || r == ref.end() || r->first != it.when) {
+                    errorlog << "timer " << it.id << " fired at " << now << ", expected " << it.when;
+                    return false;
+                }
+                ref.erase(r);
+            }
+            if (!ref.empty() && ref.begin()->first <= now) {
+                errorlog << "timer " << ref.begin()->second << " missed at " << now;
+                return false;
+            }
+        }
+    }
+    return wheel.size() == ref.size();
+}
+
+static const size_t timers = 100000;
+static const int rounds = 2000;
+
+// 每个tick插入 per_tick 个 1~600 tick 之后到期的定时器, 取消其中一半; 返回每个tick的纳秒数
+static double benchWheel(size_t per_tick, size_t& fired){
+    std::mt19937 rng(1);
+    timer::Wheel<uint32_t> wheel;
+    std::vector<timer::TimerId> ids;
+    std::vector<uint32_t> out;
+    for (size_t i = 0; i < timers; ++i) {
+        wheel.schedule(1 + rng() % 600, uint32_t(i));
+    }
+    using clock = std::chrono::steady_clock;
+    auto begin = clock::now();
+    fired = 0;
+    for (int t = 1; t <= rounds; ++t) {
+        out.clear();
+        fired += wheel.advance(t, out);
+        ids.clear();
+        for (size_t i = 0; i < per_tick; ++i) {
+            ids.push_back(wheel.schedule(t + 1 + rng() % 600, uint32_t(i)));
+        }
+        for (size_t i = 0; i < per_tick; i += 2) {
+            wheel.cancel(ids[i]);
+        }
+    }
+    return std::chrono::duration<double, std::nano>(clock::now() - begin).count() / rounds;
+}
+
+static double benchHeap(size_t per_tick, size_t& fired){
+    std::mt19937 rng(1);
+    using Entry = std::pair<uint64_t, uint32_t>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+    std::vector<uint8_t> cancelled;
+    uint32_t next = 0;
+    for (size_t i = 0; i < timers; ++i) {
+        heap.emplace(1 + rng() % 600, next++);
+        cancelled.push_back(0);
+    }
+    using clock = std::chrono::steady_clock;
+    auto begin = clock::now();
+    fired = 0;
+    for (int t = 1; t <= rounds; ++t) {
+        while (!heap.empty() && heap.top().first <= uint64_t(t)) {
+            fired += !cancelled[heap.top().second];
+            heap.pop();
+        }
+        const uint32_t first = next;
+        for (size_t i = 0; i < per_tick; ++i) {
+            heap.emplace(t + 1 + rng() % 600, next++);
+            cancelled.push_back(0);
+        }
+        for (size_t i = 0; i < per_tick; i += 2) {
+            cancelled[first + i] = 1;
+        }
+    }
+    return std::chrono::duration<double, std::nano>(clock::now() - begin).count() / rounds;
+}
+
+// 按住技能1 100 个tick, 数释放的次数
+static bool checkCooldown(){
+    Config cfg;
+    cfg.skill1_cooldown = 1.0f;
+    World w(cfg);
+    w.spawn(1, 0.0f, 0.0f);
+    const uint32_t cd = static_cast<uint32_t>(cfg.skill1_cooldown * cfg.tick_rate);
+    uint32_t casts = 0;
+    bool was = false;
+    for (uint32_t t = 0; t < 100; ++t) {
+        w.input().produce([](InputBuffer& in){ in.push(1, 0, 0, flat::Skill1); });
+        w.tick();
+        const bool casting = w.registry().get<Status>(w.findPlayer(1)).flags & flat::Casting1;
+        casts += casting && !was;
+        was = casting;
+    }
+    infolog << "holding skill1 for 100 ticks: " << casts << " casts, cooldown " << cd << " ticks";
+    return casts == (100 + cd - 1) / cd;
+}
+
+int main(){
+    bool ok = checkOrder();
+    infolog << "order check " << (ok ? "passed" : "failed");
+    for (size_t per_tick : { size_t(100), size_t(1000) }) {
+        size_t wheel_fired = 0, heap_fired = 0;
+        double wheel_ns = benchWheel(per_tick, wheel_fired);
+        double heap_ns = benchHeap(per_tick, heap_fired);
+        infolog << timers << " timers, " << per_tick << " scheduled and " << per_tick / 2 << " cancelled per tick: wheel "
+                << wheel_ns / 1000.0 << " us, heap " << heap_ns / 1000.0 << " us per tick";
+        ok = ok && wheel_fired == heap_fired;
+    }
+    ok = ok && checkCooldown();
+    if (!ok) {
+        errorlog << "failed";
+        return 1;
+    }
+    infolog << "ok";
+    return 0;
+}
+
+// 编译运行
+// flatc --cpp --filename-suffix _fb -o ../../src/flat -I ../../src/flat ../../src/flat/io.fbs ../../src/flat/pack.fbs
+// g++ -O2 -std=c++20 -o timer_bench timer_bench.cc ../../src/world/world.cc ../../src/world/kinematics.cc ../../src/world/record.cc ../../src/world/checkpoint.cc -I../../src/comm -I../../src/world -I../../src/flat -I../../src/snapshot -I../../src/connect -lflatbuffers -lpthread